@@ -1,19 +1,20 @@
 #include <string>
 #include <SDL2/SDL.h>
 #include <cassert>
-#include <random>
 #include <ctime>
 #include <cstring>
+#include <cstdio>
 #include <string>
 #include <climits>
 #include <filesystem>
+#include <vector>
 
 #include "Chip-8.h"
-#include "fontset.h"
 #include "gfx.h"
 #include "config.h"
 #include "license.h"
 #include "sdl_file_chooser.h"
+#include "rom_file.h"
 
 #include "submodules/chip8asm/src/InputFile.h"
 #include "submodules/chip8asm/src/parser.h"
@@ -24,27 +25,12 @@ namespace std_fs = std::filesystem;
 #define _STR(x) #x
 #define STR(x) _STR(x)
 
-#define DEBUGGER_TEXTURE_W 300
+#define DEBUGGER_TEXTURE_W 620
 #define DEBUGGER_TEXTURE_H 420
-
-constexpr uint8_t keyMap[16]{
-    SDLK_x,
-    SDLK_1,
-    SDLK_2,
-    SDLK_3,
-    SDLK_q,
-    SDLK_w,
-    SDLK_e,
-    SDLK_a,
-    SDLK_s,
-    SDLK_d,
-    SDLK_y,
-    SDLK_c,
-    SDLK_4,
-    SDLK_r,
-    SDLK_f,
-    SDLK_v
-    };
+// The size of a byte in the memory heatmap, shown under the debugger
+#define MEMORY_HEATMAP_SCALE 3
+// How much the heat of a byte fades in a frame
+#define MEMORY_HEAT_DECAY 8
 
 constexpr uint8_t keyMapScancode[16]{
     SDL_SCANCODE_X,
@@ -65,72 +51,15 @@ constexpr uint8_t keyMapScancode[16]{
     SDL_SCANCODE_V
     };
 
-static void renderText(
-        SDL_Renderer* renderer, SDL_Texture** fontCache,
-        int* cursorRow, int* cursorCol,
-        const std::string& text,
-        const SDL_Color& color={255, 255, 255, 255})
-{
-    static constexpr int charWidthPx = 9;
-    static constexpr int charHeightPx = 16;
-
-    for (size_t i{}; i < text.length(); ++i)
-    {
-        const int character{text[i]};
-        switch (character)
-        {
-        case '\n':
-            ++*cursorRow;
-            *cursorCol = 0;
-            break;
-
-        case '\t':
-            *cursorCol += 4;
-            break;
-
-        case '\v':
-            *cursorRow += 4;
-            *cursorCol = 0;
-            break;
-
-        case '\r':
-            *cursorCol = 0;
-            break;
-
-        case ' ':
-            ++*cursorCol;
-            break;
-
-        default:
-            if (character >= '!' && character <= '~') // If printable character
-            {
-                SDL_Rect destRect{
-                    *cursorCol * charWidthPx + 5, *cursorRow * charHeightPx,
-                    charWidthPx, charHeightPx};
-                const int textureI{character - '!'};
-                SDL_SetTextureColorMod(fontCache[textureI], color.r, color.g, color.b);
-                SDL_SetTextureAlphaMod(fontCache[textureI], color.a);
-                if (SDL_RenderCopy(renderer, fontCache[textureI], nullptr, &destRect))
-                {
-                    Logger::err << "Failed to copy character texture: " << SDL_GetError() << Logger::End;
-                }
-                ++*cursorCol;
-            }
-            else // If unknown nonprintable character
-            {
-                ++*cursorCol;
-            }
-            break;
-        }
-    }
-}
-
+/*
+ * Returns an empty list on error, the user is told why.
+ */
 static ByteList assembleFile(const std::string& filePath)
 {
-    auto showFatalMessage{
+    auto showErrorMessage{
         [](const char* msg){
             SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Assembler Error", msg, nullptr);
-            Logger::fatal << msg << Logger::End;
+            AsyncLog::error(msg);
         }
     };
 
@@ -142,14 +71,14 @@ static ByteList assembleFile(const std::string& filePath)
         file.open(filePath);
         fileContent = file.getContent();
     }
-    catch (std::exception& e) { showFatalMessage(e.what()); }
+    catch (std::exception& e) { showErrorMessage(e.what()); return {}; }
 
     // ----- Call the preprocessor -----
     try
     {
         fileContent = Parser::preprocessFile(fileContent, filePath);
     }
-    catch (std::exception& e) { showFatalMessage(e.what()); }
+    catch (std::exception& e) { showErrorMessage(e.what()); return {}; }
 
     // ----- Parse the file -----
     Parser::tokenList_t tokenList;
@@ -158,8 +87,8 @@ static ByteList assembleFile(const std::string& filePath)
     {
         Parser::parseTokens(fileContent, filePath, &tokenList, &labelMap);
     }
-    catch (std::exception& e) { showFatalMessage(e.what()); }
-    Logger::dbg << "Found " << tokenList.size() << " tokens and " << labelMap.size() << " labels" << Logger::End;
+    catch (std::exception& e) { showErrorMessage(e.what()); return {}; }
+    AsyncLog::debug("Found ", tokenList.size(), " tokens and ", labelMap.size(), " labels");
 
     // ----- Generate the output -----
     ByteList output;
@@ -167,125 +96,234 @@ static ByteList assembleFile(const std::string& filePath)
     {
         output = generateBinary(tokenList, labelMap);
     }
-    catch (std::exception& e) { showFatalMessage(e.what()); }
-    Logger::log << "Assembled to " << output.size() << " bytes" << Logger::End;
+    catch (std::exception& e) { showErrorMessage(e.what()); return {}; }
+    AsyncLog::info("Assembled to ", output.size(), " bytes");
 
     if (output.empty())
     {
-        showFatalMessage("The assembler produced no output");
+        showErrorMessage("The assembler produced no output");
     }
 
     return output;
 }
 
-static void loadRom(const std::string& romFilename, int* romSize, uint8_t* memory, SDL_Window* window)
+Chip8::Chip8(const std::string& romFilename)
 {
-    Logger::log << "Opening file: " << romFilename << Logger::End;
-    FILE *romFile = fopen(romFilename.c_str(), "rb");
-    if (!romFile)
+    AsyncLog::info('\n', "----- setting up video -----");
+    Chip8::initVideo();
+
+    if (!m_core.setJitEnabled(true))
+        AsyncLog::info("JIT is not available, using the interpreter");
+
+    m_romProfiles.load(ROM_PROFILE_DATABASE_PATH);
+    if (!romFilename.empty())
     {
-        Logger::err << "Unable to open file: " << romFilename << Logger::End;
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "CHIP-8 Emulator", (std::string("Unable to open ROM: ")+romFilename).c_str(), window);
+        AsyncLog::info('\n', "----- loading file -----");
+        if (!Chip8::loadFile(romFilename))
+        {
+            m_hasExited = true;
+            return;
+        }
+    }
 
-        std::exit(2);
+    AsyncLog::info('\n', "----- starting emulation thread -----");
+    m_emulator.start();
+}
+
+bool Chip8::loadFile(const std::string& romFilename)
+{
+    std::vector<uint8_t> assembled;
+    RomFile romFile;
+    const uint8_t* data{};
+    size_t size{};
+    if (strToLower(std_fs::path{romFilename}.extension().string()).compare(".asm") == 0) // Assembly file, assemble it first
+    {
+        AsyncLog::info("Assembly file, assembling it");
+        auto output = assembleFile(romFilename);
+        if (output.empty())
+            return false;
+        assembled.assign(output.begin(), output.end());
+        data = assembled.data();
+        size = assembled.size();
+    }
+    else // Probably ROM, map it
+    {
+        AsyncLog::info("ROM file, mapping it");
+        if (!romFile.open(romFilename, Chip8Core::MAX_ROM_SIZE))
+        {
+            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, TITLE, romFile.getError().c_str(), m_window);
+            return false;
+        }
+        data = romFile.getData();
+        size = romFile.getSize();
     }
 
-    fseek(romFile, 0, SEEK_END);
-    *romSize = ftell(romFile);
-    fseek(romFile, 0, SEEK_SET);
-    Logger::log << "File size: " << std::dec << *romSize << " / 0x" << std::hex << *romSize << " bytes" << Logger::End;
+    // Reloading the same program (on reset) keeps the options the user has set since
+    const uint64_t hash = hashRom(data, size);
+    const bool isNewProgram = hash != m_romHash || m_romFilename.empty();
+    // Only replaces the profile of the current program if the new one is loaded,
+    // saving the profile writes it under `m_romHash`
+    RomProfile newProfile;
+    if (isNewProgram)
+    {
+        const RomProfile* profile = m_romProfiles.find(hash);
+        newProfile = profile ? *profile : RomProfile{};
+        if (profile)
+            AsyncLog::info("ROM hash: ", to_hex(hash, 16, false), ", using its profile \"", newProfile.name, "\"");
+        else
+            AsyncLog::info("ROM hash: ", to_hex(hash, 16, false), ", no profile");
+    }
 
-    fread(memory + 512, 8, *romSize, romFile);
-    auto copied = ftell(romFile);
-    Logger::log << "Copied: " << std::dec << copied << std::hex << " bytes" << Logger::End;
-    if (copied != *romSize)
+    // The mapping is only read here, `execute()` waits for the emulation thread
+    bool isLoaded{};
+    m_emulator.execute([&](Chip8Core& core){
+            isLoaded = core.loadRom(data, size);
+            if (isLoaded && isNewProgram)
+                newProfile.applyTo(core);
+            m_isCompatShiftYRegInsteadOfX = core.getCompatShiftYRegInsteadOfX();
+            m_isCompatIncIAfterRegFillLoad = core.getCompatIncIAfterRegFillLoad();
+    });
+    if (!isLoaded)
     {
-        Logger::err << "Unable to copy to buffer" << Logger::End;
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, TITLE, "Unable to copy file content to memory", window);
+        AsyncLog::error("Unable to copy to buffer");
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, TITLE, "The program doesn't fit in the memory", m_window);
+        return false;
+    }
 
-        std::exit(2);
+    if (isNewProgram)
+    {
+        m_romProfile = newProfile;
+        const bool shouldBeFullscreen = m_romProfile.displayMode == RomProfile::DisplayMode::Fullscreen;
+        if (m_romProfile.displayMode != RomProfile::DisplayMode::Any && shouldBeFullscreen != m_isFullscreen)
+            toggleFullscreen();
     }
+    m_romFilename = romFilename;
+    m_romHash = hash;
+    return true;
+}
 
-    fclose(romFile);
+bool Chip8::saveRomProfile()
+{
+    if (m_romFilename.empty())
+        return false;
+
+    m_romProfile.isCompatShiftYRegInsteadOfX = m_isCompatShiftYRegInsteadOfX;
+    m_romProfile.isCompatIncIAfterRegFillLoad = m_isCompatIncIAfterRegFillLoad;
+    if (m_romProfile.name.empty())
+        m_romProfile.name = std_fs::path{m_romFilename}.stem().string();
+    m_romProfiles.set(m_romHash, m_romProfile);
+    if (!m_romProfiles.save())
+        return false;
+
+    AsyncLog::info("Saved the profile of \"", m_romProfile.name, "\" to ", ROM_PROFILE_DATABASE_PATH);
+    return true;
 }
 
-Chip8::Chip8(const std::string& romFilename)
-    : m_sp{}
+bool Chip8::openStateSlot(bool isSaving)
 {
-    std::srand(std::time(nullptr)); // initialize rand()
-    std::rand(); // drop the first result
+    // Without a ROM file, the state belongs to the replayed movie
+    const std::string path = (m_romFilename.empty() ? m_replayPath : m_romFilename) + ".state";
+    // A slot opened for loading may have the size of an older format
+    if (m_stateSlot.isOpen() && m_stateSlot.getPath() == path
+            && (!isSaving || m_stateSlot.getSize() == Chip8Core::SAVE_STATE_SIZE))
+        return true;
+
+    return isSaving ? m_stateSlot.open(path, Chip8Core::SAVE_STATE_SIZE) : m_stateSlot.openExisting(path);
+}
 
-    Logger::log << '\n' << "----- setting up video -----" << Logger::End;
-    Chip8::initVideo();
+bool Chip8::saveState()
+{
+    if (!openStateSlot(true))
+        return false;
 
-    // Load the font set to the memory
-    Chip8::loadFontSet();
+    m_emulator.execute([this](Chip8Core& core){ core.saveState(m_stateSlot.getData()); });
+    m_stateSlot.flush();
+    AsyncLog::info("Saved state to ", m_stateSlot.getPath());
+    return true;
+}
 
-    Logger::log << '\n' << "----- loading file -----" << Logger::End;
-    Chip8::loadFile(romFilename);
+bool Chip8::loadState()
+{
+    if (!openStateSlot(false))
+        return false;
+    stopRecording();
+
+    bool isLoaded{};
+    m_emulator.execute([this, &isLoaded](Chip8Core& core){
+            isLoaded = core.loadState(m_stateSlot.getData(), m_stateSlot.getSize());
+            m_isCompatShiftYRegInsteadOfX = core.getCompatShiftYRegInsteadOfX();
+            m_isCompatIncIAfterRegFillLoad = core.getCompatIncIAfterRegFillLoad();
+    });
+    if (!isLoaded)
+        return false;
+
+    AsyncLog::info("Loaded state from ", m_stateSlot.getPath());
+    m_needsRedraw = true;
+    m_isDebugInfoOutdated = true;
+    return true;
 }
 
-void Chip8::loadFile(const std::string& romFilename)
+void Chip8::setRandomSeed(uint64_t seed)
 {
-    m_romFilename = romFilename;
-    if (strToLower(std_fs::path{romFilename}.extension().string()).compare(".asm") == 0) // Assembly file, assemble it first
-    {
-        Logger::log << "Assembly file, assembling it" << Logger::End;
-        auto data = assembleFile(romFilename);
-        //memcpy(m_memory, data.data(), std::min(data.size(), (size_t)0x1000));
-        size_t copiedBytes{};
-        for (; copiedBytes < std::min(data.size(), (size_t)0x1000); ++copiedBytes)
-        {
-            m_memory[512+copiedBytes] = data[copiedBytes];
-        }
-        Logger::log << "Copied " << copiedBytes << " bytes to memory" << Logger::End;
-    }
-    else // Probably ROM, just simply copy
-    {
-        Logger::log << "ROM file, copying it" << Logger::End;
-        loadRom(romFilename, &m_romSize, m_memory, m_window);
-    }
+    m_emulator.execute([seed](Chip8Core& core){ core.setRandomSeed(seed); });
+}
 
-    // Dump the memory
-    Logger::log << '\n' << "--- START OF MEMORY ---" << Logger::End;
-    for (int i{}; i < 0xfff + 1; ++i)
-    {
-        Logger::log << static_cast<int>(m_memory[i]) << ' ';
-        if (i == 0x200 - 1)
-            Logger::log << '\n' << "--- START OF PROGRAM ---" << '\n';
-        if (i == (m_romSize + 511))
-            Logger::log << '\n' << "--- END OF PROGRAM ---" << '\n';
-        if (i == 0xfff)
-            Logger::log << '\n' << "--- END OF MEMORY ---" << '\n';
-    }
-    Logger::log << Logger::End;
+void Chip8::startRecording(const std::string& path)
+{
+    stopRecording();
+
+    m_emulator.startRecording();
+    m_recordingPath = path;
+    AsyncLog::info("Recording movie to ", path);
+    updateWindowTitle();
 }
 
-void Chip8::loadFontSet()
+bool Chip8::stopRecording()
 {
-    Logger::log << '\n' << "--- FONT SET --- " << '\n';
-    for (int i{}; i < 80; ++i)
-        Logger::log << static_cast<int>(fontset[i]) << ' ';
-    Logger::log << '\n' << "--- END OF FONT SET ---" << Logger::End;
+    if (!isRecording())
+        return true;
+
+    const std::string path = m_recordingPath;
+    m_recordingPath.clear();
+    updateWindowTitle();
+
+    Movie movie;
+    if (!m_emulator.stopRecording(&movie) || !movie.save(path))
+        return false;
+    AsyncLog::info("Saved movie to ", path, " (", std::dec, movie.events.size(), " input changes)");
+    return true;
+}
 
-    // copy the font set to the memory
-    for (int i{}; i < 80; ++i)
-    {
-        m_memory[i] = fontset[i];
-    }
+bool Chip8::startReplay(const std::string& path)
+{
+    stopRecording();
+
+    Movie movie;
+    if (!movie.load(path) || !m_emulator.startReplay(std::move(movie)))
+        return false;
+    m_replayPath = path;
+    AsyncLog::info("Replaying movie ", path);
+
+    m_emulator.execute([this](Chip8Core& core){
+            m_isCompatShiftYRegInsteadOfX = core.getCompatShiftYRegInsteadOfX();
+            m_isCompatIncIAfterRegFillLoad = core.getCompatIncIAfterRegFillLoad();
+    });
+    m_needsRedraw = true;
+    m_isDebugInfoOutdated = true;
+    return true;
 }
 
 void Chip8::initVideo()
 {
-    Logger::log << "Initializing SDL" << Logger::End;
+    AsyncLog::info("Initializing SDL");
 
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO))
     {
-        Logger::err << "Unable to initialize SDL. " << SDL_GetError() << Logger::End;
+        AsyncLog::error("Unable to initialize SDL. ", SDL_GetError());
         std::exit(2);
     }
 
-    Logger::log << "Creating window" << Logger::End;
+    AsyncLog::info("Creating window");
     m_window = SDL_CreateWindow(
             TITLE " - Loading...",
             SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
@@ -293,72 +331,41 @@ void Chip8::initVideo()
             SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE);
     if (!m_window)
     {
-        Logger::err << "Unable to create window. " << SDL_GetError() << Logger::End;
+        AsyncLog::error("Unable to create window. ", SDL_GetError());
         std::exit(2);
     }
 
-    Logger::log << "Creating renderer" << Logger::End;
+    AsyncLog::info("Creating renderer");
     m_renderer = SDL_CreateRenderer(m_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
     if (!m_renderer)
     {
-        Logger::err << "Unable to create renderer. " << SDL_GetError() << Logger::End;
+        AsyncLog::error("Unable to create renderer. ", SDL_GetError());
         std::exit(2);
     }
 
-    m_contentTexture = SDL_CreateTexture(
-            m_renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
-            64, 32);
-    if (!m_contentTexture)
-    {
-        Logger::err << "Unable to create content texture. " << SDL_GetError() << Logger::End;
-        std::exit(2);
-    }
-
-    m_debuggerTexture = SDL_CreateTexture(
-            m_renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET, DEBUGGER_TEXTURE_W, DEBUGGER_TEXTURE_H);
-    if (!m_debuggerTexture)
-    {
-        Logger::err << "Unable to create debugger texture. " << SDL_GetError() << Logger::End;
-        std::exit(2);
-    }
+    initContentTexture();
+    initMemoryHeatmapTexture();
 
-    Logger::log << "Initializing SDL2_ttf" << Logger::End;
+    AsyncLog::info("Initializing SDL2_ttf");
     if (TTF_Init())
     {
-        Logger::err << "Unable to initialize SDL2_ttf: " << TTF_GetError() << Logger::End;
+        AsyncLog::error("Unable to initialize SDL2_ttf: ", TTF_GetError());
         std::exit(2);
     }
 
-    Logger::log << "Loading font" << Logger::End;
+    AsyncLog::info("Loading font");
     TTF_Font* font = TTF_OpenFont("Anonymous_Pro.ttf", 16);
     if (!font)
     {
-        Logger::err << "Unable to load font: " << TTF_GetError() << Logger::End;
+        AsyncLog::error("Unable to load font: ", TTF_GetError());
         SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, TITLE, "Unable to load font", m_window);
 
         std::exit(2);
     }
 
-    Logger::log << "Caching font..." << Logger::End;
-    for (int i{'!'}; i <= '~'; ++i)
-    {
-        char str[2]{(char)i};
-
-        SDL_Surface* charSurface{TTF_RenderText_Blended(font, (const char*)&str, {255, 255, 255, 255})};
-        if (!charSurface)
-        {
-            Logger::err << "Failed to render font: " << SDL_GetError() << Logger::End;
-            std::exit(2);
-        }
-        SDL_Texture* charTexture{SDL_CreateTextureFromSurface(m_renderer, charSurface)};
-        if (!charTexture)
-        {
-            Logger::err << "Failed to convert font surface to texture: " << SDL_GetError() << Logger::End;
-            std::exit(2);
-        }
-        SDL_FreeSurface(charSurface);
-        m_fontCache[i - '!'] = charTexture;
-    }
+    AsyncLog::info("Building font atlas");
+    if (!m_textRenderer.init(m_renderer, font))
+        std::exit(2);
     TTF_CloseFont(font);
     TTF_Quit();
 
@@ -369,6 +376,101 @@ void Chip8::initVideo()
     SDL_SetWindowMinimumSize(m_window, 64 * 2, 32 * 2);
 }
 
+void Chip8::initContentTexture()
+{
+    // Use a 32-bit format the renderer supports, so SDL doesn't have to convert the texture when uploading it
+    m_contentPixelFormat = SDL_PIXELFORMAT_ARGB8888;
+    SDL_RendererInfo rendererInfo;
+    if (SDL_GetRendererInfo(m_renderer, &rendererInfo) == 0)
+    {
+        for (uint32_t i{}; i < rendererInfo.num_texture_formats; ++i)
+        {
+            const uint32_t format = rendererInfo.texture_formats[i];
+            if (!SDL_ISPIXELFORMAT_FOURCC(format) && SDL_BYTESPERPIXEL(format) == 4)
+            {
+                m_contentPixelFormat = format;
+                break;
+            }
+        }
+    }
+    AsyncLog::info("Content texture format: ", SDL_GetPixelFormatName(m_contentPixelFormat), ", conversion kernel: ", Gfx::getExpandKernelName());
+
+    m_contentTexture = SDL_CreateTexture(
+            m_renderer, m_contentPixelFormat, SDL_TEXTUREACCESS_STREAMING,
+            64, 32);
+    if (!m_contentTexture)
+    {
+        AsyncLog::error("Unable to create content texture. ", SDL_GetError());
+        std::exit(2);
+    }
+    m_contentPixels.resize(64 * 32);
+
+    SDL_PixelFormat* format = SDL_AllocFormat(m_contentPixelFormat);
+    if (!format)
+    {
+        AsyncLog::error("Unable to allocate pixel format. ", SDL_GetError());
+        std::exit(2);
+    }
+    m_fgTexel = SDL_MapRGBA(format, FG_COLOR_R, FG_COLOR_G, FG_COLOR_B, 255);
+    m_bgTexel = SDL_MapRGBA(format, BG_COLOR_R, BG_COLOR_G, BG_COLOR_B, 255);
+    SDL_FreeFormat(format);
+}
+
+void Chip8::initMemoryHeatmapTexture()
+{
+    // Small enough that it doesn't matter if SDL has to convert it
+    m_memoryHeatmapTexture = SDL_CreateTexture(
+            m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+            64, 64);
+    if (!m_memoryHeatmapTexture)
+    {
+        AsyncLog::error("Unable to create memory heatmap texture. ", SDL_GetError());
+        std::exit(2);
+    }
+    // Nothing accessed yet
+    m_memoryHeatmapPixels.assign(64 * 64, 0xff1e1e1e);
+    SDL_UpdateTexture(m_memoryHeatmapTexture, nullptr, m_memoryHeatmapPixels.data(), 64 * sizeof(uint32_t));
+}
+
+void Chip8::updateMemoryHeatmap()
+{
+    const MemoryAccessMap& accesses = m_frame.memoryAccess;
+
+    bool hasChanged{};
+    for (int address{}; address <= 0xfff; ++address)
+    {
+        uint8_t& heat = m_memoryHeat[address];
+        heat = accesses.isRecent(address) ? 255 : std::max(heat - MEMORY_HEAT_DECAY, 0);
+
+        // Like the registers: read is green, written is red, executed is blue
+        const uint32_t level = 128 + heat * 127 / 255;
+        uint32_t texel = 0xff000000;
+        if (accesses.isWritten(address))
+            texel |= level << 16;
+        if (accesses.isRead(address))
+            texel |= level << 8;
+        if (accesses.isExecuted(address))
+            texel |= level;
+        if (texel == 0xff000000) // Never accessed
+            texel = 0xff1e1e1e;
+
+        if (texel != m_memoryHeatmapPixels[address])
+        {
+            m_memoryHeatmapPixels[address] = texel;
+            hasChanged = true;
+        }
+    }
+    if (!hasChanged)
+        return;
+
+    if (SDL_UpdateTexture(m_memoryHeatmapTexture, nullptr, m_memoryHeatmapPixels.data(), 64 * sizeof(uint32_t)))
+    {
+        AsyncLog::error("Error: Failed to update memory heatmap texture: ", SDL_GetError());
+        return;
+    }
+    m_needsRedraw = true;
+}
+
 std::string Chip8::saveScreenshot() const
 {
     auto generateFilename{[](){ // -> char*
@@ -380,31 +482,22 @@ std::string Chip8::saveScreenshot() const
         return buffer;
     }};
 
-    uint8_t* pixelData{};
-    int pitch{};
-    if (SDL_LockTexture(m_contentTexture, nullptr, (void**)&pixelData, &pitch))
-    {
-        Logger::err << "Error: Failed to lock content texture to save screenshot: " << SDL_GetError() << Logger::End;
-        return "";
-    }
-
-    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixelData, 64, 32, 24, pitch, SDL_PIXELFORMAT_RGB24);
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(
+            (void*)m_contentPixels.data(), 64, 32, 32, 64 * sizeof(uint32_t), m_contentPixelFormat);
     if (!surface)
     {
-        Logger::err << "Failed to create surface for screenshot: " << SDL_GetError() << Logger::End;
-        SDL_UnlockTexture(m_contentTexture);
+        AsyncLog::error("Failed to create surface for screenshot: ", SDL_GetError());
         return "";
     }
 
     std::string filename = generateFilename();
-    Logger::log << "Saving screenshot as \"" << filename << "\"" << Logger::End;
+    AsyncLog::info("Saving screenshot as \"", filename, "\"");
     if (SDL_SaveBMP(surface, filename.c_str()))
     {
-        Logger::err << "Failed to save screenshot: " << SDL_GetError() << Logger::End;
+        AsyncLog::error("Failed to save screenshot: ", SDL_GetError());
     }
 
     SDL_FreeSurface(surface);
-    SDL_UnlockTexture(m_contentTexture);
 
     return filename;
 }
@@ -414,13 +507,21 @@ void Chip8::deinit()
     if (m_hasDeinitCalled)
         return;
 
+    stopRecording();
+
     SDL_SetWindowTitle(m_window, TITLE " - Exiting...");
     updateRenderer();
 
-    Logger::log << '\n' << "----- deinit -----" << Logger::End;
+    AsyncLog::info('\n', "----- deinit -----");
+
+    m_emulator.stop();
 
+    m_textRenderer.deinit();
     SDL_DestroyTexture(m_contentTexture);
-    SDL_DestroyTexture(m_debuggerTexture);
+    SDL_DestroyTexture(m_memoryHeatmapTexture);
+    m_debuggerPanel.deinit();
+    m_infoMessagePanel.deinit();
+    m_overlayPanel.deinit();
     SDL_DestroyRenderer(m_renderer);
     SDL_DestroyWindow(m_window);
 
@@ -436,62 +537,95 @@ Chip8::~Chip8()
 
 void Chip8::renderFrameBuffer()
 {
-    uint8_t* pixelData{};
-    int pitch{};
-    if (SDL_LockTexture(m_contentTexture, nullptr, (void**)&pixelData, &pitch))
-    {
-        Logger::err << "Error: Failed to lock content texture: " << SDL_GetError() << Logger::End;
+    if (!m_dirtyRows)
         return;
-    }
 
-    for (int x{}; x < 64; ++x)
+    // Upload every run of changed rows with a single call
+    int y{};
+    while (y < 32)
     {
-        for (int y{}; y < 32; ++y)
+        if (!(m_dirtyRows & (1u << y)))
+        {
+            ++y;
+            continue;
+        }
+
+        const int firstRow = y;
+        while (y < 32 && (m_dirtyRows & (1u << y)))
+            ++y;
+        const int rowCount = y - firstRow;
+
+        uint32_t* pixels = m_contentPixels.data() + firstRow * 64;
+        Gfx::expandBitRows(m_frame.rows + firstRow, rowCount, 64, pixels, 64, m_fgTexel, m_bgTexel);
+
+        const SDL_Rect rect{0, firstRow, 64, rowCount};
+        if (SDL_UpdateTexture(m_contentTexture, &rect, pixels, 64 * sizeof(uint32_t)))
         {
-            if (m_frameBuffer.get(x, y))
-                Gfx::drawPoint(pixelData, pitch, x, y, SDL_Color{FG_COLOR_R, FG_COLOR_G, FG_COLOR_B, 255});
-            else
-                Gfx::drawPoint(pixelData, pitch, x, y, SDL_Color{BG_COLOR_R, BG_COLOR_G, BG_COLOR_B, 255});
+            AsyncLog::error("Error: Failed to update content texture: ", SDL_GetError());
+            return;
         }
     }
-    SDL_UnlockTexture(m_contentTexture);
-    m_renderFlag = false;
+    std::memcpy(m_shownRows, m_frame.rows, sizeof(m_shownRows));
+    m_dirtyRows = 0;
 }
 
-void Chip8::fetchOpcode()
+void Chip8::updateKeyStates()
 {
-    // Catch the access out of the valid memory address range (0x00 - 0xfff)
-    assert(m_pc <= 0xffe);
-
-    if (m_pc > 0xffe)
+    auto keyState{SDL_GetKeyboardState(nullptr)};
+    uint16_t keyStates{};
+    for (int i{}; i < 16; ++i)
     {
-        panic("PC out of range");
+        if (keyState[keyMapScancode[i]])
+            keyStates |= 1 << i;
     }
+    m_emulator.setKeyStates(keyStates);
+}
 
-    // We swap the upper and lower bits.
-    // The opcode is 16 bits long, so we have to
-    // shift the left part of the opcode and add the right part.
-    m_opcode = (m_memory[m_pc] << 8) | m_memory[m_pc + 1];
-
-#if VERBOSE_LOG
-    Logger::log << std::hex;
-    Logger::log << "PC: 0x" << m_pc << Logger::End;
-    Logger::log << "Current opcode: 0x" << m_opcode << Logger::End;
-#endif
-
-    m_pc += 2;
+void Chip8::renderTextBatchToPanel(
+        UiPanel& panel, uint64_t contentHash,
+        int width/*=0*/, int height/*=0*/, const SDL_Color& bgColor/*={0, 0, 0, 0}*/)
+{
+    int batchWidth, batchHeight;
+    m_textRenderer.getBatchSize(&batchWidth, &batchHeight);
+
+    const bool isTargetSet = panel.beginRender(m_renderer,
+            width ? width : batchWidth, height ? height : batchHeight, bgColor);
+    // If the panel can't be rendered to, the text goes to the screen, so the batch doesn't stay there
+    m_textRenderer.flush(m_renderer);
+    if (isTargetSet)
+        panel.endRender(m_renderer, contentHash);
 }
 
 void Chip8::updateInfoMessage()
 {
-    if (m_infoMessageTimeRemaining <= 0)
+    if (m_infoMessageTimeRemaining <= 0 || m_infoMessage == InfoMessageValue::None)
         return;
 
+    // The message only changes when a new one is set, it is not rebuilt while it fades out
+    uint64_t contentHash = hashBytes(&m_infoMessage, sizeof(m_infoMessage));
+    contentHash = hashBytes(m_infoMessageExtra.data(), m_infoMessageExtra.size(), contentHash);
+    const bool compatOptions[]{m_isCompatShiftYRegInsteadOfX, m_isCompatIncIAfterRegFillLoad};
+    contentHash = hashBytes(compatOptions, sizeof(compatOptions), contentHash);
+
+    if (m_infoMessagePanel.needsRender(contentHash))
+        renderInfoMessagePanel(contentHash);
+
+    const uint8_t alpha = 255 * std::min(m_infoMessageTimeRemaining, 1.0f);
+    m_infoMessagePanel.copyTo(m_renderer, 0, 0, alpha);
+
+    m_infoMessageTimeRemaining -= 1.0f / FRAMES_PER_SECOND;
+    // Redraw once more to remove the message
+    if (m_infoMessageTimeRemaining <= 0)
+        m_needsRedraw = true;
+}
+
+void Chip8::renderInfoMessagePanel(uint64_t contentHash)
+{
     std::string messageStr;
     switch (m_infoMessage)
     {
     case InfoMessageValue::None:
-        return;
+        break;
     case InfoMessageValue::Pause:
         messageStr = "Paused.";
         break;
@@ -522,22 +656,64 @@ void Chip8::updateInfoMessage()
         break;
 
     case InfoMessageValue::ToggleCompatShiftYRegInsteadOfX:
-        messageStr = "Toggled shift Y register instead of X to "+std::string(m_compat_shiftYRegInsteadOfX ? "TRUE" : "FALSE");
+        messageStr = "Toggled shift Y register instead of X to "+std::string(m_isCompatShiftYRegInsteadOfX ? "TRUE" : "FALSE");
         break;
 
     case InfoMessageValue::ToggleCompatIncIAfterRegFillLoad:
-        messageStr = "Toggled increment I after full register fill/load to "+std::string(m_compat_incIAfterRegFillLoad ? "TRUE" : "FALSE");
+        messageStr = "Toggled increment I after full register fill/load to "+std::string(m_isCompatIncIAfterRegFillLoad ? "TRUE" : "FALSE");
         break;
-    }
 
-    {
-        int cursorRow{};
-        int cursorCol{};
-        uint8_t alpha = 255 * std::min(m_infoMessageTimeRemaining, 1.0f);
-        renderText(m_renderer, m_fontCache, &cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, alpha});
+    case InfoMessageValue::SaveState:
+        messageStr = "Saved state.";
+        break;
+    case InfoMessageValue::SaveStateFailed:
+        messageStr = "Unable to save state.";
+        break;
+    case InfoMessageValue::LoadState:
+        messageStr = "Loaded state.";
+        break;
+    case InfoMessageValue::LoadStateFailed:
+        messageStr = "No saved state to load.";
+        break;
+    case InfoMessageValue::ExportProfile:
+        assert(m_infoMessageExtra.length());
+        messageStr = "Saved profile to \"" + m_infoMessageExtra + "\".";
+        break;
+    case InfoMessageValue::ExportProfileFailed:
+        messageStr = "Enable the debug mode to profile.";
+        break;
+    case InfoMessageValue::ExportMemoryMap:
+        assert(m_infoMessageExtra.length());
+        messageStr = "Saved memory map to \"" + m_infoMessageExtra + "\".";
+        break;
+    case InfoMessageValue::ExportMemoryMapFailed:
+        messageStr = "Enable the debug mode to record the memory accesses.";
+        break;
+    case InfoMessageValue::EnableTracing:
+        messageStr = "Tracing enabled.";
+        break;
+    case InfoMessageValue::DisableTracing:
+        messageStr = "Tracing disabled.";
+        break;
+    case InfoMessageValue::SaveTrace:
+        assert(m_infoMessageExtra.length());
+        messageStr = "Saved trace to \"" + m_infoMessageExtra + "\".";
+        break;
+    case InfoMessageValue::SaveTraceFailed:
+        messageStr = "Nothing traced to save.";
+        break;
+    case InfoMessageValue::SaveRomProfile:
+        messageStr = "Saved the options of the ROM, they are applied when it is loaded.";
+        break;
+    case InfoMessageValue::SaveRomProfileFailed:
+        messageStr = "Failed to save the options of the ROM.";
+        break;
     }
 
-    m_infoMessageTimeRemaining -= m_frameDelay / 1000.0f;
+    int cursorRow{};
+    int cursorCol{};
+    m_textRenderer.addText(&cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
+    renderTextBatchToPanel(m_infoMessagePanel, contentHash);
 }
 
 void Chip8::updateOverlay()
@@ -545,6 +721,15 @@ void Chip8::updateOverlay()
     if (!m_shouldShowKeyboardHelp)
         return;
 
+    // The content of the overlay never changes, so it is only rendered once
+    if (m_overlayPanel.needsRender(0))
+        renderOverlayPanel();
+
+    m_overlayPanel.copyTo(m_renderer, 0, 2 * TextRenderer::charHeightPx);
+}
+
+void Chip8::renderOverlayPanel()
+{
     std::string messageStr =
         std::string("------- Keybindings -------")
         + "\nPause:                         " + SDL_GetKeyName(SHORTCUT_KEYCODE_PAUSE)
@@ -559,13 +744,21 @@ void Chip8::updateOverlay()
         + "\nDecrement speed:               " + SDL_GetKeyName(SHORTCUT_KEYCODE_DEC_SPEED)
         + "\nReset state:                   " + SDL_GetKeyName(SHORTCUT_KEYCODE_RESET)
         + "\nTake screenshot:               " + SDL_GetKeyName(SHORTCUT_KEYCODE_SCREENSHOT)
+        + "\nSave state:                    " + SDL_GetKeyName(SHORTCUT_KEYCODE_SAVE_STATE)
+        + "\nLoad state:                    " + SDL_GetKeyName(SHORTCUT_KEYCODE_LOAD_STATE)
+        + "\nRewind (hold):                 " + SDL_GetKeyName(SHORTCUT_KEYCODE_REWIND)
+        + "\nExport profile (debug mode):   " + SDL_GetKeyName(SHORTCUT_KEYCODE_EXPORT_PROFILE)
+        + "\nExport memory map\n    (debug mode):              " + SDL_GetKeyName(SHORTCUT_KEYCODE_EXPORT_MEMORY_MAP)
+        + "\nToggle tracing:                " + SDL_GetKeyName(SHORTCUT_KEYCODE_TOGGLE_TRACING)
+        + "\nSave trace:                    " + SDL_GetKeyName(SHORTCUT_KEYCODE_SAVE_TRACE)
         + "\nCompat: Shift Y Register\n    instead X:                  " + SDL_GetKeyName(SHORTCUT_KEYCODE_TOGGLE_COMPAT_SHIFTYREG)
         + "\nCompat: Increment I after\n    full register fill/load:    " + SDL_GetKeyName(SHORTCUT_KEYCODE_TOGGLE_COMPAT_INCI)
+        + "\nSave the compat options\n    of the ROM:                 " + SDL_GetKeyName(SHORTCUT_KEYCODE_SAVE_ROM_PROFILE)
         ;
 
-    int cursorRow{2};
+    int cursorRow{};
     int cursorCol{};
-    renderText(m_renderer, m_fontCache, &cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
+    m_textRenderer.addText(&cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
 
     SDL_version version{};
     SDL_GetVersion(&version);
@@ -647,7 +840,7 @@ void Chip8::updateOverlay()
     +std::to_string(version.patch)
 
     ;
-    renderText(m_renderer, m_fontCache, &cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
+    m_textRenderer.addText(&cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
 
     cursorRow += 3;
     cursorCol = 0;
@@ -656,21 +849,30 @@ void Chip8::updateOverlay()
         "License at: https://github.com/timre13/Chip-8_emulator/blob/master/LICENSE.txt\n"
         "Source code at: https://github.com/timre13/Chip-8_emulator\n"
         ;
-    renderText(m_renderer, m_fontCache, &cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
+    m_textRenderer.addText(&cursorRow, &cursorCol, messageStr, {MESSAGE_COLOR_R, MESSAGE_COLOR_G, MESSAGE_COLOR_B, 255});
+
+    renderTextBatchToPanel(m_overlayPanel, 0);
 }
 
 void Chip8::panic(const std::string& message)
 {
-    Logger::err << "PANIC: " << message << Logger::End;
-    Logger::log << '\n' << dumpStateToStr() << Logger::End;
+    AsyncLog::error("PANIC: ", message);
+    AsyncLog::info('\n', dumpStateToStr());
+    // Keep the movie, it reproduces the panic
+    stopRecording();
+    // And the instructions that led to it
+    const std::string tracePath = m_isTracing ? saveTrace() : "";
 
     auto _renderText{[this](const std::string& text){
         int cursorRow{};
         int cursorCol{};
-        renderText(m_renderer, m_fontCache, &cursorRow, &cursorCol, text, {PANIC_FG_COLOR_R, PANIC_FG_COLOR_G, PANIC_FG_COLOR_B, 255});
+        m_textRenderer.addText(&cursorRow, &cursorCol, text, {PANIC_FG_COLOR_R, PANIC_FG_COLOR_G, PANIC_FG_COLOR_B, 255});
+        m_textRenderer.flush(m_renderer);
     }};
     std::string textToRender =
-        "Fatal error: " + message + "\nThis is probably caused by an invalid/damaged ROM.\n\n\n" + dumpStateToStr(false) +
+        "Fatal error: " + message + "\nThis is probably caused by an invalid/damaged ROM.\n"
+        + (tracePath.empty() ? "" : "The last instructions were saved to \"" + tracePath + "\".\n")
+        + "\n\n" + dumpStateToStr(false) +
         "\n\nMore information in the terminal.\nPress escape to exit.";
 
     SDL_SetWindowFullscreen(m_window, 0);
@@ -691,12 +893,14 @@ void Chip8::panic(const std::string& message)
         SDL_Delay(100);
     }
 
+    // The dump above may still be queued
+    AsyncLog::flush();
     std::abort();
 }
 
 void Chip8::whenWindowResized(int width, int height)
 {
-    Logger::log << "Window resized" << Logger::End;
+    AsyncLog::info("Window resized");
 
     m_windowWidth = width;
     m_windowHeight = height;
@@ -710,7 +914,19 @@ void Chip8::whenWindowResized(int width, int height)
 
     m_scale = std::min(horizontalScale, verticalScale);
 
-    renderFrameBuffer();
+    m_needsRedraw = true;
+}
+
+void Chip8::whenRenderTargetsReset()
+{
+    AsyncLog::info("Render targets reset");
+
+    m_debuggerPanel.invalidate();
+    m_infoMessagePanel.invalidate();
+    m_overlayPanel.invalidate();
+
+    m_isDebugInfoOutdated = true;
+    m_needsRedraw = true;
 }
 
 void Chip8::copyTexturesToRenderer()
@@ -724,8 +940,11 @@ void Chip8::copyTexturesToRenderer()
     }
     if (m_isDebugMode)
     {
-        SDL_Rect dstRect{m_windowWidth - DEBUGGER_TEXTURE_W, 0, DEBUGGER_TEXTURE_W, DEBUGGER_TEXTURE_H};
-        SDL_RenderCopy(m_renderer, m_debuggerTexture, nullptr, &dstRect);
+        m_debuggerPanel.copyTo(m_renderer, m_windowWidth - DEBUGGER_TEXTURE_W, 0);
+
+        SDL_Rect dstRect{m_windowWidth - DEBUGGER_TEXTURE_W, DEBUGGER_TEXTURE_H,
+            64 * MEMORY_HEATMAP_SCALE, 64 * MEMORY_HEATMAP_SCALE};
+        SDL_RenderCopy(m_renderer, m_memoryHeatmapTexture, nullptr, &dstRect);
     }
 
 }
@@ -736,13 +955,28 @@ void Chip8::toggleFullscreen()
     SDL_SetWindowFullscreen(m_window, m_isFullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
     SDL_ShowCursor(!m_isFullscreen);
 
-    // Render the frame buffer with the new scaling
-    renderFrameBuffer();
+    // Redraw with the new scaling
+    m_needsRedraw = true;
 }
 
 void Chip8::toggleDebugMode()
 {
     m_isDebugMode = !m_isDebugMode;
+    // The JIT doesn't track the register accesses shown by the debugger
+    const bool isJitEnabled = !m_isDebugMode;
+    // The profile and the memory accesses are recorded from when the debug mode is enabled
+    Profiler* profiler = m_isDebugMode ? &m_profiler : nullptr;
+    MemoryAccessMap* memoryAccessMap = m_isDebugMode ? &m_memoryAccessMap : nullptr;
+    m_emulator.execute([isJitEnabled, profiler, memoryAccessMap](Chip8Core& core){
+            core.setJitEnabled(isJitEnabled);
+            if (profiler)
+                profiler->reset();
+            core.setProfiler(profiler);
+            if (memoryAccessMap)
+                memoryAccessMap->reset();
+            core.setMemoryAccessMap(memoryAccessMap);
+    });
+    std::memset(m_memoryHeat, 0, sizeof(m_memoryHeat));
 
     int w, h;
     SDL_GetWindowSize(m_window, &w, &h);
@@ -753,63 +987,20 @@ void Chip8::toggleDebugMode()
 
 void Chip8::toggleCompatShiftYRegInsteadOfX()
 {
-    m_compat_shiftYRegInsteadOfX = !m_compat_shiftYRegInsteadOfX;
+    stopRecording();
+    m_emulator.execute([this](Chip8Core& core){
+            core.toggleCompatShiftYRegInsteadOfX();
+            m_isCompatShiftYRegInsteadOfX = core.getCompatShiftYRegInsteadOfX();
+    });
 }
 
 void Chip8::toggleCompatIncIAfterRegFillLoad()
 {
-    m_compat_incIAfterRegFillLoad = !m_compat_incIAfterRegFillLoad;
-}
-
-std::string Chip8::dumpStateToStr(bool dumpAll/*=true*/)
-{
-    std::stringstream output;
-
-    if (dumpAll)
-    {
-        output << "Memory:\n";
-        output << std::hex;
-        for (int i{}; i < 0x1000; ++i)
-        {
-            output << std::setw(2) << std::setfill('0') << +m_memory[i] << ' ';
-            if (i % 32 == 31)
-                output << '\n';
-        }
-
-        output << "\nFramebuffer:\n";
-        for (int i{}; i < 64 * 32; ++i)
-        {
-            output << +m_frameBuffer.get(i) << ' ';
-            if (i % 64 == 63)
-                output << '\n';
-        }
-        output << '\n';
-    }
-
-    output <<   "PC=" << std::setw(4) << std::setfill('0') << +m_pc
-           << ", Op=" << std::setw(4) << std::setfill('0') << +m_opcode
-           << ", SP=" << std::setw(1) << std::setfill('0') << +m_sp
-           << ", I="  << std::setw(4) << std::setfill('0') << +m_indexReg
-           << ", DT=" << std::setw(2) << std::setfill('0') << +m_delayTimer
-           << ", ST=" << std::setw(2) << std::setfill('0') << +m_soundTimer
-           << '\n';
-    for (int i{}; i < 16; ++i)
-    {
-        output << i << '=' << std::setw(2) << std::setfill('0') << +m_registers.get(i, true);
-        if (i != 15)
-            output << ", ";
-    }
-
-    output << "\n\nStack:\n";
-    for (int i{15}; i > -1; --i)
-    {
-        output << std::setw(4) << std::setfill('0') << m_stack[i];
-        if (i + 1 == m_sp)
-            output << " <-"; // Mark the stack pointer
-        output << '\n';
-    }
-
-    return output.str();
+    stopRecording();
+    m_emulator.execute([this](Chip8Core& core){
+            core.toggleCompatIncIAfterRegFillLoad();
+            m_isCompatIncIAfterRegFillLoad = core.getCompatIncIAfterRegFillLoad();
+    });
 }
 
 void Chip8::renderDebugInfoIfInDebugMode()
@@ -817,41 +1008,45 @@ void Chip8::renderDebugInfoIfInDebugMode()
     if (!m_isDebugMode)
         return;
 
-    if (SDL_SetRenderTarget(m_renderer, m_debuggerTexture))
-    {
-        Logger::err << "Failed to set render target: " << SDL_GetError() << Logger::End;
-        return;
-    }
-    SDL_SetRenderDrawColor(m_renderer, 50, 50, 50, 255);
-    SDL_RenderClear(m_renderer);
+    // Faster changes can't be followed by the eye anyway,
+    // and rendering them could take longer than emulating them
+    if (m_debuggerPanel.needsRender(m_debugInfoHash, 1000 / DEBUGGER_MAX_REFRESH_RATE))
+        renderDebuggerPanel();
+
+    // Keep redrawing until the changes held back by the limit are shown
+    m_isDebugInfoOutdated = !m_debuggerPanel.hasContent(m_debugInfoHash);
+}
 
+void Chip8::renderDebuggerPanel()
+{
     int cursorRow{};
     int cursorCol{};
     auto _renderText{[this, &cursorRow, &cursorCol]
             (const std::string& text, const SDL_Color& color={255, 255, 255, 255}){
-        renderText(m_renderer, m_fontCache, &cursorRow, &cursorCol, text, color);
+        m_textRenderer.addText(&cursorRow, &cursorCol, text, color);
     }};
 
-    _renderText("Opcode: " + to_hex(m_opcode) + "\n\n");
-    _renderText("PC: " + to_hex(m_pc) + "\n\n");
-    _renderText("I: " + to_hex(m_indexReg) + "\n\n");
-    _renderText("SP: " + to_hex(m_sp) + "\n\n");
+    _renderText("Opcode: " + to_hex(m_frame.opcode) + "\n\n");
+    _renderText("PC: " + to_hex(m_frame.pc) + "\n\n");
+    _renderText("I: " + to_hex(m_frame.indexReg) + "\n\n");
+    _renderText("SP: " + to_hex(m_frame.sp) + "\n\n");
 
     _renderText("Stack:\n");
     for (int i{15}; i >= 0; --i)
-        _renderText(to_hex(m_stack[i]) + "\n");
+        _renderText(to_hex(m_frame.stack[i]) + "\n");
 
     constexpr int indent = 17;
 
     cursorRow = 0;
     cursorCol = indent;
     _renderText("Registers:\n");
+    const Registers& registers = m_frame.registers;
     for (int i{}; i < 16; ++i)
     {
         cursorCol = indent;
 
-        const bool isRead{m_registers.getIsRegisterRead(i)};
-        const bool isWritten{m_registers.getIsRegisterWritten(i)};
+        const bool isRead{registers.getIsRegisterRead(i)};
+        const bool isWritten{registers.getIsRegisterWritten(i)};
 
         SDL_Color textColor{255, 255, 255, 255};
         if (isRead && isWritten)
@@ -861,480 +1056,254 @@ void Chip8::renderDebugInfoIfInDebugMode()
         else if (isWritten)
             textColor = {255, 0, 0, 255};
 
-        _renderText(to_hex(i, 1) + ": " + to_hex(m_registers.get(i, true)) + "\n", textColor);
+        _renderText(to_hex(i, 1) + ": " + to_hex(registers.peek(i)) + "\n", textColor);
     }
     _renderText("\n");
 
     cursorCol = indent;
-    _renderText("DT: " + to_hex(m_delayTimer) + "\n");
+    _renderText("DT: " + to_hex(m_frame.delayTimer) + "\n");
     cursorCol = indent;
-    _renderText("ST: " + to_hex(m_soundTimer) + "\n\n");
+    _renderText("ST: " + to_hex(m_frame.soundTimer) + "\n\n");
 
-    if (m_isReadingKey)
+    if (m_frame.isReadingKey)
     {
         cursorCol = indent;
         _renderText("Reading keys");
     }
 
-    if (SDL_SetRenderTarget(m_renderer, nullptr))
-    {
-        Logger::err << "Failed to reset render target: " << SDL_GetError() << Logger::End;
-    }
-}
+    if (m_frame.isProfiling)
+        renderProfile(indent * 2);
 
-void Chip8::updateWindowTitle()
-{
-    if (m_isPaused)
-        SDL_SetWindowTitle(m_window, TITLE " - [PAUSED]");
-    else
-        SDL_SetWindowTitle(m_window, (TITLE " - Speed: " + std::to_string(m_emulSpeedPerc) + "%").c_str());
+    renderTextBatchToPanel(m_debuggerPanel, m_debugInfoHash,
+            DEBUGGER_TEXTURE_W, DEBUGGER_TEXTURE_H, {50, 50, 50, 255});
 }
 
-void Chip8::reset(bool reloadFile/*=true*/)
+void Chip8::renderProfile(int column)
 {
-    Logger::log << "RESET!" << Logger::End;
-
-    m_pc = 0x200;
-    m_sp = 0;
-    m_opcode = 0;
-    m_indexReg = 0;
-    m_delayTimer = 0;
-    m_soundTimer = 0;
-    m_isReadingKey = false;
-    m_timerDecrementCountdown = 16.67;
-    m_renderFlag = true;
-
-    for (int i{}; i < 16; ++i)
-        m_stack[i] = 0;
-
-    for (int i{}; i < 16; ++i)
-        m_registers.set(i, 0, true);
-    m_registers.clearReadWrittenFlags();
+    int cursorRow{};
+    int cursorCol{column};
+    auto _renderLine{[this, &cursorRow, &cursorCol, column](const std::string& text, const SDL_Color& color={255, 255, 255, 255}){
+        cursorCol = column;
+        m_textRenderer.addText(&cursorRow, &cursorCol, text + "\n", color);
+    }};
+    auto _formatPerc{[](double value, double total){
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%5.1f%%", total ? value / total * 100 : 0.0);
+        return std::string{buffer};
+    }};
 
-    std::memset(m_memory, 0, 0x1000);
-    m_frameBuffer.clear();
+    const ProfileSummary& profile = m_frame.profile;
+    _renderLine("Profile: " + std::to_string(profile.instructionCount) + " instr.\n");
 
-    loadFontSet();
-    if (reloadFile)
-        loadFile(m_romFilename);
+    _renderLine("Instruction         Count   Time", {200, 200, 200, 255});
+    for (int i{}; i < profile.classCount; ++i)
+    {
+        const ProfileSummary::ClassEntry& entry = profile.classes[i];
+        std::string name = getOpClassName(entry.opClass);
+        name.resize(18, ' ');
+        _renderLine(name + ' ' + _formatPerc(entry.count, profile.instructionCount)
+                + ' ' + _formatPerc(entry.hostMs, profile.hostMs));
+    }
 
-    renderDebugInfoIfInDebugMode();
-    renderFrameBuffer();
+    _renderLine("\nHot loops       Iterations", {200, 200, 200, 255});
+    for (int i{}; i < profile.loopCount; ++i)
+    {
+        const ProfileSummary::LoopEntry& loop = profile.loops[i];
+        _renderLine(to_hex(loop.start, 3) + '-' + to_hex(loop.end, 3) + "  " + std::to_string(loop.iterations));
+    }
 }
 
-void Chip8::emulateCycle()
+std::string Chip8::exportProfile()
 {
-    fetchOpcode();
-
-    m_timerDecrementCountdown -= m_frameDelay;
+    if (!m_isDebugMode)
+        return "";
 
-    auto logOpcode{[](const std::string &str){
-#if VERBOSE_LOG
-        Logger::log << str << Logger::End;
-#else
-        (void)str;
-#endif
-    }};
+    std::string json;
+    m_emulator.execute([&json](Chip8Core& core){
+            if (core.getProfiler())
+                json = core.getProfiler()->toJson();
+    });
+    if (json.empty())
+        return "";
 
-    Logger::log << std::hex;
+    char filename[64]{};
+    const auto epochTime = time(nullptr);
+    strftime(filename, sizeof(filename), "profile-%y%m%d%H%M%S.json", localtime(&epochTime));
 
-    switch (m_opcode & 0xf000)
+    std::ofstream file{filename};
+    file << json;
+    if (!file)
     {
-        case 0x0000:
-            switch (m_opcode & 0x0fff)
-            {
-                case 0x0000:
-                    logOpcode("NOP");
-                    break;
-
-                case 0x00e0: // CLS
-                    logOpcode("CLS");
-                    m_frameBuffer.clear();
-                    m_renderFlag = true;
-                    break;
-
-                case 0x00ee: // RET
-                    logOpcode("RET");
-                    m_pc = m_stack[m_sp - 1];
-                    m_stack[m_sp - 1] = 0;
-                    --m_sp;
-                    break;
-
-                default:
-                    panic("Invalid opcode.");
-            }
-            break;
-
-        case 0x1000: // JMP
-            logOpcode("JMP");
-            m_pc = m_opcode & 0x0fff;
-            break;
-
-        case 0x2000: // CALL
-            logOpcode("CALL");
-            ++m_sp;
-            m_stack[m_sp-1] = m_pc;
-            m_pc = (m_opcode & 0x0fff);
-            break;
-
-        case 0x3000: // SE
-            logOpcode("SE");
-            if (m_registers.get((m_opcode & 0x0f00) >> 8) == (m_opcode & 0x00ff))
-                m_pc += 2;
-            break;
-
-        case 0x4000: // SNE
-            logOpcode("SNE");
-            if (m_registers.get((m_opcode & 0x0f00) >> 8) != (m_opcode & 0x00ff))
-                m_pc += 2;
-            break;
+        AsyncLog::error("Failed to save profile to \"", filename, "\"");
+        return "";
+    }
+    AsyncLog::info("Saved profile to \"", filename, "\"");
+    return filename;
+}
 
-        case 0x5000: // SE Vx, Vy
-            logOpcode("SE Vx, Vy");
-            if (m_registers.get((m_opcode & 0x0f00) >> 8) == m_registers.get((m_opcode & 0x00f0) >> 4))
-                m_pc += 2;
-            break;
+std::string Chip8::exportMemoryMap()
+{
+    if (!m_isDebugMode)
+        return "";
 
-        case 0x6000: // LD Vx, byte
-            logOpcode("LD Vx, byte");
-            m_registers.set((m_opcode & 0x0f00) >> 8, m_opcode & 0x00ff);
-            break;
+    char filename[64]{};
+    const auto epochTime = time(nullptr);
+    strftime(filename, sizeof(filename), "memory-%y%m%d%H%M%S.txt", localtime(&epochTime));
 
-        case 0x7000: // ADD Vx, byte
-            logOpcode("ADD Vx, byte");
-            m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) + (m_opcode & 0x00ff));
-            break;
+    bool isSaved{};
+    m_emulator.execute([&isSaved, &filename](Chip8Core& core){
+            if (core.getMemoryAccessMap())
+                isSaved = core.getMemoryAccessMap()->saveToFile(filename);
+    });
+    if (!isSaved)
+        return "";
+    AsyncLog::info("Saved memory map to \"", filename, "\"");
+    return filename;
+}
 
-        case 0x8000:
-            switch (m_opcode & 0x000f)
-            {
-                case 0: // LD Vx, Vy
-                    logOpcode("LD Vx, Vy");
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x00f0) >> 4));
-                    break;
-
-                case 1: // OR Vx, Vy
-                    logOpcode("OR Vx, Vy");
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) | m_registers.get((m_opcode & 0x00f0) >> 4));
-                    break;
-
-                case 2: // AND Vx, Vy
-                    logOpcode("AND Vx, Vy");
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) & m_registers.get((m_opcode & 0x00f0) >> 4));
-                    break;
-
-                case 3: // XOR Vx, Vy
-                    logOpcode("XOR Vx, Vy");
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) ^ m_registers.get((m_opcode & 0x00f0) >> 4));
-                    break;
-
-                case 4: // ADD Vx, Vy
-                    logOpcode("ADD Vx, Vy");
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) + m_registers.get((m_opcode & 0x00f0) >> 4));
-
-                    if (m_registers.get((m_opcode & 0x00f0) >> 4) > (0xff - m_registers.get((m_opcode & 0x0f00) >> 8)))
-                        m_registers.set(0xf, 1);
-                    else
-                        m_registers.set(0xf, 0);
-                    break;
-
-                case 5: // SUB Vx, Vy
-                    logOpcode("SUB Vx, Vy");
-                    m_registers.set(0xf, !(m_registers.get((m_opcode & 0x0f00) >> 8) < m_registers.get((m_opcode & 0x00f0) >> 4)));
-
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) - m_registers.get((m_opcode & 0x00f0) >> 4));
-                    break;
-
-                case 6: // SHR Vx {, Vy}
-                    logOpcode("SHR Vx {, Vy}");
-                    // Mark whether overflow occurs.
-                    m_registers.set(0xf, m_registers.get((m_opcode & 0x0f00) >> 8) & 1);
-
-                    if (m_compat_shiftYRegInsteadOfX)
-                    {
-                        m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x00f0) >> 4) >> 1);
-                    }
-                    else
-                    {
-                        m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) >> 1);
-                    }
-                    break;
-
-                case 7: // SUBN Vx, Vy
-                    logOpcode("SUBN Vx, Vy");
-                    m_registers.set(0xf, !(m_registers.get((m_opcode & 0x0f00) >> 8) > m_registers.get((m_opcode & 0x00f0) >> 4)));
-
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x00f0) >> 4) - m_registers.get((m_opcode & 0x0f00) >> 8));
-                    break;
-
-                case 0xe: // SHL Vx {, Vy}
-                    logOpcode("SDL Vx, {, Vy}");
-                    // Mark whether overflow occurs.
-                    m_registers.set(0xf, (m_registers.get((m_opcode & 0x0f00) >> 8) >> 7));
-
-                    if (m_compat_shiftYRegInsteadOfX)
-                    {
-                        m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x00f0) >> 4) << 1);
-                    }
-                    else
-                    {
-                        m_registers.set((m_opcode & 0x0f00) >> 8, m_registers.get((m_opcode & 0x0f00) >> 8) << 1);
-                    }
-                    break;
-
-                default:
-                    panic("Invalid opcode.");
-            }
-            break;
+void Chip8::setTracing(bool value)
+{
+    if (value && !m_traceBuffer)
+        m_traceBuffer = std::make_unique<TraceBuffer>(TRACE_BUFFER_SIZE);
+
+    m_isTracing = value;
+    TraceBuffer* traceBuffer = m_traceBuffer.get();
+    m_emulator.execute([value, traceBuffer](Chip8Core& core){
+            if (value)
+                traceBuffer->clear();
+            core.setTraceBuffer(value ? traceBuffer : nullptr);
+    });
+    AsyncLog::info((value ? "Tracing enabled" : "Tracing disabled"));
+}
 
-        case 0x9000: // SNE Vx, Vy
-            logOpcode("SNE Vx, Vy");
-            if (m_registers.get((m_opcode & 0x0f00) >> 8) !=
-                m_registers.get((m_opcode & 0x00f0) >> 4))
-                m_pc += 2;
-            break;
+std::string Chip8::saveTrace()
+{
+    if (!m_traceBuffer)
+        return "";
 
-        case 0xa000: // LD I, addr
-            logOpcode("LD I, addr");
-            m_indexReg  = (m_opcode & 0x0fff);
-            break;
+    char filename[64]{};
+    const auto epochTime = time(nullptr);
+    strftime(filename, sizeof(filename), "trace-%y%m%d%H%M%S.c8t", localtime(&epochTime));
 
-        case 0xb000: // JP V0, addr
-            logOpcode("JP V0, addr");
-            m_pc = (m_registers.get(0) + (m_opcode & 0x0fff));
-            break;
+    bool isSaved{};
+    TraceBuffer* traceBuffer = m_traceBuffer.get();
+    m_emulator.execute([&isSaved, &filename, traceBuffer](Chip8Core&){
+            isSaved = traceBuffer->getCount() && traceBuffer->save(filename);
+    });
+    if (!isSaved)
+        return "";
+    AsyncLog::info("Saved trace to \"", filename, "\"");
+    return filename;
+}
 
-        case 0xc000: // RND Vx, byte
-            logOpcode("RND Vx, byte");
-            m_registers.set((m_opcode & 0x0f00) >> 8, (m_opcode & 0x00ff) & static_cast<uint8_t>(std::rand()));
-            break;
+uint64_t Chip8::hashDebugInfo() const
+{
+    uint64_t hash = hashBytes(&m_frame.registers, sizeof(m_frame.registers));
+    hash = hashBytes(m_frame.stack, sizeof(m_frame.stack), hash);
+    const uint64_t profileValues[]{m_frame.isProfiling, m_frame.profile.instructionCount};
+    hash = hashBytes(profileValues, sizeof(profileValues), hash);
+    const uint16_t values[]{
+        m_frame.sp, m_frame.pc, m_frame.opcode, m_frame.indexReg,
+        m_frame.delayTimer, m_frame.soundTimer, m_frame.isReadingKey};
+    return hashBytes(values, sizeof(values), hash);
+}
 
-        case 0xd000: // DRW Vx, Vy, nibble
-        {
-            logOpcode("DRW Vx, Vy, nibble");
+void Chip8::updateWindowTitle()
+{
+    if (m_isRewinding)
+        SDL_SetWindowTitle(m_window, (TITLE " - Rewinding, " + std::to_string(m_frame.rewindFrameCount) + " frames left").c_str());
+    else if (m_isPaused)
+        SDL_SetWindowTitle(m_window, TITLE " - [PAUSED]");
+    else if (m_isTitleWaitingForKey)
+        SDL_SetWindowTitle(m_window, TITLE " - waiting for keypress");
+    else if (m_isTitleReplaying)
+        SDL_SetWindowTitle(m_window, (TITLE " - Replaying - Speed: " + std::to_string(m_emulSpeedPerc) + "%").c_str());
+    else if (isRecording())
+        SDL_SetWindowTitle(m_window, (TITLE " - Recording - Speed: " + std::to_string(m_emulSpeedPerc) + "%").c_str());
+    else
+        SDL_SetWindowTitle(m_window, (TITLE " - Speed: " + std::to_string(m_emulSpeedPerc) + "%").c_str());
+}
 
-            // Sprite coordinates are wrapped
-            const int spritex = (m_registers.get((m_opcode & 0x0f00) >> 8)) % 64;
-            const int spritey = (m_registers.get((m_opcode & 0x00f0) >> 4)) % 32;
+void Chip8::reset(bool reloadFile/*=true*/)
+{
+    stopRecording();
+    if (!m_replayPath.empty())
+    {
+        if (reloadFile && startReplay(m_replayPath))
+            return;
+        m_emulator.stopReplay();
+        m_replayPath.clear();
+    }
 
-            const int height = m_opcode & 0x000f;
+    m_emulator.execute([](Chip8Core& core){
+            core.reset();
+            // The profile of the previous run would be mixed with the new one
+            if (core.getProfiler())
+                core.getProfiler()->reset();
+            if (core.getMemoryAccessMap())
+                core.getMemoryAccessMap()->reset();
+            if (core.getTraceBuffer())
+                core.getTraceBuffer()->clear();
+    });
+    if (reloadFile && !m_romFilename.empty())
+        loadFile(m_romFilename);
+    // Don't rewind into the previous run
+    m_emulator.clearRewindHistory();
 
-            if (m_indexReg + height >= 0xfff)
-                panic("Invalid sprite address/height");
+    m_needsRedraw = true;
+    m_isDebugInfoOutdated = true;
+}
 
-            m_registers.set(0xf, 0);
+std::string Chip8::dumpStateToStr(bool dumpAll/*=true*/)
+{
+    std::string output;
+    m_emulator.execute([&](Chip8Core& core){ output = core.dumpStateToStr(dumpAll); });
+    return output;
+}
 
-            for (int cy{}; cy < height; ++cy)
-            {
-                const uint8_t line = m_memory[m_indexReg + cy];
-
-                for (int cx{}; cx < 8; ++cx)
-                {
-                    const int x = (spritex+cx);
-                    const int y = (spritey+cy) % 32;
-                    const uint8_t pixel = line & (0x80 >> cx);
-
-                    // Note: Sprite pixels out-of-bounds are clipped
-                    if (x >= 0 && x < 64 && y >= 0 && y < 32 && pixel)
-                    {
-                        if (m_frameBuffer.get(x, y))
-                            m_registers.set(0xf, 1);
-
-                        m_frameBuffer.set(x, y, m_frameBuffer.get(x, y) ^ 1);
-                    }
-                }
-            }
+void Chip8::update()
+{
+    updateKeyStates();
 
-            m_renderFlag = true;
+    const bool isNewFrame = m_emulator.updateFrame();
+    if (isNewFrame)
+    {
+        m_frame = m_emulator.getFrame();
+        m_debugInfoHash = hashDebugInfo();
+        m_isDebugInfoOutdated = !m_debuggerPanel.hasContent(m_debugInfoHash);
+        if (m_frame.isTrackingMemory)
+            updateMemoryHeatmap();
 
-            break;
+        for (int y{}; y < 32; ++y)
+        {
+            if (m_frame.rows[y] != m_shownRows[y])
+                m_dirtyRows |= 1u << y;
         }
-
-        case 0xe000:
-            switch (m_opcode & 0x00ff)
-            {
-                case 0x9e: // SKP Vx
-                {
-                    logOpcode("SKP Vx");
-
-                    m_isReadingKey = true;
-
-                    auto keyState{SDL_GetKeyboardState(nullptr)};
-
-#if VERBOSE_LOG
-                    Logger::log << "KEY: " << keyState[keyMap[m_registers.get((m_opcode & 0x0f00) >> 8)]] << Logger::End;
-#endif
-
-                    if (keyState[keyMapScancode[m_registers.get((m_opcode & 0x0f00) >> 8)]])
-                        m_pc += 2;
-                    break;
-                }
-
-                case 0xa1: // SKNP Vx
-                {
-                    logOpcode("SKNP Vx");
-
-                    m_isReadingKey = true;
-
-                    auto keyState{SDL_GetKeyboardState(nullptr)};
-
-#if VERBOSE_LOG
-                    Logger::log << "KEY: " << keyState[keyMap[m_registers.get((m_opcode & 0x0f00) >> 8)]] << Logger::End;
-#endif
-
-                    if (!(keyState[keyMapScancode[m_registers.get((m_opcode & 0x0f00) >> 8)]]))
-                        m_pc += 2;
-                    break;
-                }
-
-                default:
-                    panic("Invalid opcode");
-            }
-        break;
-
-        case 0xf000:
-            switch (m_opcode & 0x00ff)
-            {
-                case 0x07: // LD Vx, DT
-                    logOpcode("LD Vx, DT");
-                    m_registers.set((m_opcode & 0x0f00) >> 8, m_delayTimer);
-                    break;
-
-                case 0x0a: // LD Vx, K
-                {
-                    logOpcode("LD Vx, K");
-
-                    SDL_SetWindowTitle(m_window, TITLE " - waiting for keypress");
-
-                    uint16_t pressedKey{};
-                    bool hasValidKeyPressed{};
-                    do
-                    {
-                        updateRenderer();
-
-                        SDL_Event event;
-                        SDL_PollEvent(&event);
-
-                        if (event.type == SDL_KEYDOWN)
-                        {
-                            for (uint16_t i{}; i < 16; ++i)
-                            {
-                                if (event.key.keysym.sym == SHORTCUT_KEYCODE_QUIT)
-                                {
-                                    m_hasExited = true;
-                                    hasValidKeyPressed = true;
-                                    break;
-                                }
-
-                                auto value{keyMap[i]};
-
-                                if (value == event.key.keysym.sym)
-                                {
-                                    hasValidKeyPressed = true;
-                                    pressedKey = i;
-                                    break;
-                                }
-                            }
-                        }
-
-                        SDL_Delay(10);
-                    }
-                    while (!hasValidKeyPressed); // Loop until a valid keypress
-
-                    // Reset the title
-                    updateWindowTitle();
-
-                    m_registers.set((m_opcode & 0x0f00) >> 8, pressedKey);
-
-#if VERBOSE_LOG
-                    Logger::log << "Loaded key: " << static_cast<int>(pressedKey) << Logger::End;
-#endif
-
-                    break;
-                }
-
-                case 0x15: // LD DT, Vx
-                    logOpcode("LD DT, Vx");
-                    m_delayTimer = m_registers.get((m_opcode & 0x0f00) >> 8);
-                    break;
-
-                case 0x18: // LD ST, Vx
-                    logOpcode("LD ST, Vx");
-                    m_soundTimer = m_registers.get((m_opcode & 0x0f00) >> 8);
-                    break;
-
-                case 0x1e: // ADD I, Vx
-                    logOpcode("ADD I, Vx");
-                    m_indexReg += m_registers.get((m_opcode & 0x0f00) >> 8);
-                    break;
-
-                case 0x29: // LD F, Vx
-                    logOpcode("FD, F, Vx");
-                    m_indexReg = m_registers.get((m_opcode & 0x0f00) >> 8) * 5;
-#if VERBOSE_LOG
-                    Logger::log << "FONT LOADED: " << m_registers.get((m_opcode & 0x0f00) >> 8) << Logger::End;
-#endif
-                    break;
-
-                case 0x33: // LD B, Vx
-                {
-                    logOpcode("LD B, Vx");
-                    uint8_t number{m_registers.get((m_opcode & 0x0f00) >> 8)};
-                    m_memory[m_indexReg] = (number / 100);
-                    m_memory[m_indexReg+1] = ((number / 10) % 10);
-                    m_memory[m_indexReg+2] = (number % 10);
-                    break;
-                }
-
-                case 0x55: // LD [I], Vx
-                {
-                    logOpcode("LD [I], Vx");
-                    uint8_t x{static_cast<uint8_t>((m_opcode & 0x0f00) >> 8)};
-
-                    for (uint8_t i{}; i <= x; ++i)
-                        m_memory[m_indexReg + i] = m_registers.get(i);
-
-                    if (m_compat_incIAfterRegFillLoad)
-                        m_indexReg += (x + 1);
-                    break;
-                }
-
-                case 0x65: // LD Vx, [I]
-                {
-                    logOpcode("LD Vx, [I]");
-                    uint8_t x{static_cast<uint8_t>((m_opcode & 0x0f00) >> 8)};
-
-                    for (uint8_t i{}; i <= x; ++i)
-                        m_registers.set(i, m_memory[m_indexReg + i]);
-
-                    if (m_compat_incIAfterRegFillLoad)
-                        m_indexReg += (x + 1);
-                    break;
-                }
-
-                default:
-                    panic("Invalid opcode.");
-            }
-        break;
-
-        default:
-            panic("Invalid opcode.");
     }
 
-    if (m_timerDecrementCountdown <= 0)
+    if (m_frame.hasPanicked)
     {
-        if (m_delayTimer > 0)
-            --m_delayTimer;
+        // The machine can be accessed directly after this
+        m_emulator.stop();
+        panic(m_core.getPanicMessage());
+    }
 
-        if (m_soundTimer > 0)
-        {
-            --m_soundTimer;
-            m_beeper.startBeeping();
-            m_remainingBeepFrames = BEEP_DURATION;
-        }
+    if (m_frame.isWaitingForKey != m_isTitleWaitingForKey || m_frame.isReplaying != m_isTitleReplaying)
+    {
+        m_isTitleWaitingForKey = m_frame.isWaitingForKey;
+        m_isTitleReplaying = m_frame.isReplaying;
+        updateWindowTitle();
+    }
+    else if (m_isRewinding && isNewFrame)
+    {
+        // Show the remaining frames
+        updateWindowTitle();
+    }
 
-        // reset the timer
-        m_timerDecrementCountdown = 16.67;
+    if (m_frame.soundTimer > 0 && !m_isRewinding)
+    {
+        m_beeper.startBeeping();
+        m_remainingBeepFrames = BEEP_DURATION;
     }
 
     if (m_remainingBeepFrames > 0)
@@ -10,114 +10,22 @@
 #include <stdint.h>
 #include <cassert>
 #include <bitset>
+#include <vector>
+#include <memory>
 
 #include "config.h"
+#include "chip8core.h"
+#include "emulator_thread.h"
+#include "text_renderer.h"
+#include "ui_panel.h"
+#include "state_slot.h"
+#include "rom_profile.h"
 #include "to_hex.h"
 #include "sound.h"
-#include "submodules/chip8asm/src/Logger.h"
+#include "async_log.h"
 
 #define TITLE "CHIP-8 Emulator"
 
-class Registers final
-{
-private:
-    uint8_t m_registers[16]{};
-
-    bool m_isRegisterWritten[16]{};
-    bool m_isRegisterRead[16]{};
-
-public:
-    uint8_t get(int index, bool isInternal=false)
-    {
-        assert(index >= 0);
-        assert(index < 16);
-
-        if (!isInternal)
-            m_isRegisterRead[index] = true;
-
-        return m_registers[index];
-    }
-
-    void set(int index, uint8_t value, bool isInternal=false)
-    {
-        assert(index >= 0);
-        assert(index < 16);
-
-        if (!isInternal)
-            m_isRegisterWritten[index] = true;
-
-        m_registers[index] = value;
-    }
-
-    void clearReadWrittenFlags()
-    {
-        // Clear m_isRegisterWritten
-        memset(m_isRegisterWritten, false, sizeof(m_isRegisterWritten));
-        // Clear m_isRegisterRead
-        memset(m_isRegisterRead, false, sizeof(m_isRegisterRead));
-    }
-
-    inline bool getIsRegisterWritten(int index) const
-    {
-        return m_isRegisterWritten[index];
-    }
-
-    inline bool getIsRegisterRead(int index) const
-    {
-        return m_isRegisterRead[index];
-    }
-};
-
-class Framebuffer final
-{
-public:
-    int m_frameBuffer[64 * 32]{};
-
-    Framebuffer()
-    {
-    }
-
-    void set(int x, int y, int val)
-    {
-        assert(x >= 0 && x < 64);
-        assert(y >= 0 && y < 32);
-        m_frameBuffer[y*64+x] = val;
-    }
-
-    int get(int x, int y) const
-    {
-        assert(x >= 0 && x < 64);
-        assert(y >= 0 && y < 32);
-        return m_frameBuffer[y*64+x];
-    }
-
-    int get(int index) const
-    {
-        assert(index >= 0 && index < 64*32);
-        return m_frameBuffer[index];
-    }
-
-    void clear()
-    {
-        for (int i{}; i < 64*32; ++i)
-        {
-            m_frameBuffer[i] = 0;
-        }
-    }
-
-    void print()
-    {
-        Logger::log << "--- frame buffer ---\n";
-        for (int i{}; i < 64 * 32; ++i)
-        {
-            Logger::log << m_frameBuffer[i];
-            if ((i + 1) % 64 == 0)
-                Logger::log << '\n';
-        }
-        Logger::log << "--------------------" << Logger::End;
-    }
-};
-
 class Chip8 final
 {
 public:
@@ -135,34 +43,45 @@ public:
         DumpState,
         ToggleCompatShiftYRegInsteadOfX,
         ToggleCompatIncIAfterRegFillLoad,
+        SaveState,
+        SaveStateFailed,
+        LoadState,
+        LoadStateFailed,
+        ExportProfile,
+        ExportProfileFailed,
+        ExportMemoryMap,
+        ExportMemoryMapFailed,
+        EnableTracing,
+        DisableTracing,
+        SaveTrace,
+        SaveTraceFailed,
+        SaveRomProfile,
+        SaveRomProfileFailed,
     };
 
 private:
-    // stack
-    uint16_t m_stack[16]{};
-    // stack pointer (4 bits)
-    uint8_t m_sp: 4; // It will be init-ed in ctor
-    // registers
-    Registers m_registers;
-    // memory - 0x00 - 0xfff
-    uint8_t m_memory[0xfff+1]{};
-    // program counter - the programs start at 0x200
-    uint16_t m_pc = 0x200;
-    // current opcode
-    uint16_t m_opcode = 0;
-    // index register
-    uint16_t m_indexReg = 0;
-    // delay timer
-    uint8_t m_delayTimer = 0;
-    // sound timer
-    uint8_t m_soundTimer = 0;
-    // framebuffer - stores which pixels are turned on
-    // We don't fill it with zeros, because the original implementation doesn't do so
-    Framebuffer m_frameBuffer;
+    // Attached to the machine in debug mode, outlive the emulation thread
+    Profiler m_profiler;
+    MemoryAccessMap m_memoryAccessMap;
+    // Attached to the machine while tracing, allocated when tracing is first enabled
+    std::unique_ptr<TraceBuffer> m_traceBuffer;
+    // Only accessed through `m_emulator` while the emulation thread runs
+    Chip8Core m_core;
+    EmulatorThread m_emulator{m_core};
+    // The latest frame received from the emulation thread
+    FrameSnapshot m_frame;
+    // The rows shown in the content texture
+    uint64_t m_shownRows[32]{};
+    // Bit N is set if row N of `m_frame` differs from the content texture
+    uint32_t m_dirtyRows = 0xffffffff;
 
     std::string m_romFilename;
-    // rom file size in bytes
-    int m_romSize;
+    // The settings of the known ROMs
+    RomProfileDatabase m_romProfiles;
+    // The hash of the loaded program, see `hashRom()`
+    uint64_t m_romHash{};
+    // The profile of the loaded program, the default one if it is unknown
+    RomProfile m_romProfile;
 
     SDL_Window* m_window{};
     int m_windowWidth{};
@@ -171,34 +90,58 @@ private:
 
     // A texture where we render the game
     SDL_Texture* m_contentTexture{};
-    // The texture of the debugger window
-    SDL_Texture* m_debuggerTexture{};
+    // The pixel format of the content texture, one that the renderer supports natively
+    uint32_t m_contentPixelFormat{};
+    // The texels of the content texture, kept for screenshots
+    std::vector<uint32_t> m_contentPixels;
+    // The foreground and background colors in the format of the content texture
+    uint32_t m_fgTexel{};
+    uint32_t m_bgTexel{};
+
+    // The memory shown in debug mode, a pixel for every byte, 64 bytes a row
+    SDL_Texture* m_memoryHeatmapTexture{};
+    std::vector<uint32_t> m_memoryHeatmapPixels;
+    // How recently a byte was accessed, 255 in the frame of the access, fades to 0
+    uint8_t m_memoryHeat[0xfff+1]{};
+
+    UiPanel m_debuggerPanel;
+    UiPanel m_infoMessagePanel;
+    UiPanel m_overlayPanel;
+
+    // The save state file of the current ROM
+    StateSlot m_stateSlot;
+
+    // Where the recorded movie is saved, empty if not recording
+    std::string m_recordingPath;
+    // The movie being replayed, empty if not replaying
+    std::string m_replayPath;
 
     Beeper m_beeper;
     int m_remainingBeepFrames{};
 
-    // Every character from code 21 to code 126 prerendered
-    SDL_Texture* m_fontCache['~' - '!' + 1]{};
+    TextRenderer m_textRenderer;
 
     int m_scale = 1;
     bool m_isFullscreen{};
     bool m_isDebugMode{};
     bool m_isPaused{};
-    bool m_isReadingKey{};
-
-    // Helps to decrement the sound and delay timers at 60 FPS
-    // This is decremented after every frame and if 0, the timers decremented.
-    double m_timerDecrementCountdown = 16.67;
+    bool m_isSteppingMode{};
+    bool m_isRewinding{};
+    bool m_isTracing{};
+    // The compatibility options, as set on the emulation thread
+    bool m_isCompatShiftYRegInsteadOfX{};
+    bool m_isCompatIncIAfterRegFillLoad{};
+    // Whether the title currently says that we are waiting for a keypress
+    bool m_isTitleWaitingForKey{};
+    // Whether the title currently says that a movie is replayed
+    bool m_isTitleReplaying{};
 
     bool m_hasDeinitCalled{};
 
     // Whether the program should exit
     bool m_hasExited{};
-    // Marks whether we need to redraw the framebuffer
-    bool m_renderFlag = true;
 
     int m_emulSpeedPerc{};
-    int m_frameDelay{};
 
     InfoMessageValue m_infoMessage{};
     std::string m_infoMessageExtra;
@@ -206,31 +149,53 @@ private:
 
     bool m_shouldShowKeyboardHelp{};
 
+    // Whether the window needs to be redrawn, even if the game screen didn't change
+    bool m_needsRedraw = true;
+    // The hash of what the debugger shows about `m_frame`
+    uint64_t m_debugInfoHash{};
+    // Whether the debugger panel doesn't show the latest state
+    bool m_isDebugInfoOutdated = true;
+
     /*
-     * The `8xy6` opcode is right-shift, the `8xyE` is left-shift.
-     * Register 0xF is set to the shifted-out bit of register X.
-     *
-     * If this is true,
-     *      register X is set to register Y shifted,
-     * if false,
-     *      register X is set to register X shifted.
-     *
-     * The old implementations used the Y register.
+     * Hashes the values of `m_frame` that the debugger shows.
      */
-    bool m_compat_shiftYRegInsteadOfX = true;
+    uint64_t hashDebugInfo() const;
 
+    void initVideo();
     /*
-     * The `Fx55` and `Fx66` opcodes loop through the registers and write them to / read from the memory.
-     * This variable marks if the index register needs to be incremented while doing the operations.
-     * In the original implementation this does happen.
+     * Opens the save state slot of the current ROM if it is not open yet.
+     * The slot is only created or resized if `isSaving` is true.
      */
-    bool m_compat_incIAfterRegFillLoad = true;
+    bool openStateSlot(bool isSaving);
+    void initContentTexture();
+    void initMemoryHeatmapTexture();
 
+    /*
+     * Renders the batch of the text renderer into `panel`.
+     * If `width` or `height` is 0, the size of the batch is used.
+     */
+    void renderTextBatchToPanel(
+            UiPanel& panel, uint64_t contentHash,
+            int width=0, int height=0, const SDL_Color& bgColor={0, 0, 0, 0});
+    void renderDebuggerPanel();
+    /*
+     * Adds the profile summary of `m_frame` to the text batch, starting at `column`.
+     */
+    void renderProfile(int column);
+    /*
+     * Fades the heat of the bytes, heats up the ones accessed in the frame of `m_frame`
+     * and uploads the changed heatmap.
+     */
+    void updateMemoryHeatmap();
+    void renderInfoMessagePanel(uint64_t contentHash);
+    void renderOverlayPanel();
 
-    void loadFontSet();
-    void initVideo();
+    /*
+     * Forwards the state of the keyboard to the keypad of the machine.
+     */
+    void updateKeyStates();
 
-    void fetchOpcode();
+    inline void updateEmulatorPause() { m_emulator.setPaused(m_isPaused || m_isSteppingMode); }
 
     /*
      * Should be called when a serious error happens.
@@ -239,32 +204,91 @@ private:
     [[noreturn]] void panic(const std::string& message);
 
 public:
+    /*
+     * If `romFilename` is empty, no ROM is loaded, a movie should be replayed instead.
+     * If the ROM can't be loaded, `hasExited()` returns true.
+     */
     Chip8(const std::string& romFilename);
 
     void reset(bool reloadFile=true);
-    void loadFile(const std::string& romFilename);
+    /*
+     * Loads a ROM or assembles an assembly file and loads the program.
+     * When a different program is loaded, its profile is applied from the ROM profile database.
+     * Returns false on error, the user is told why.
+     */
+    bool loadFile(const std::string& romFilename);
+    /*
+     * Stores the current quirk options as the profile of the loaded program in the ROM profile database,
+     * so they are applied when it is loaded the next time.
+     * Returns false if no program is loaded or on error.
+     */
+    bool saveRomProfile();
 
-    void emulateCycle();
+    /*
+     * Forwards the input and picks up the latest frame from the emulation thread.
+     * Handles the panic, the window title and the beeper.
+     * Should be called `FRAMES_PER_SECOND` times a second.
+     */
+    void update();
     void renderFrameBuffer();
 
     inline void setSpeedPerc(int value)
     {
-        m_frameDelay = 1000.0 / 500 / (value / 100.0);
+        m_emulator.setSpeedPerc(value);
         m_emulSpeedPerc = value;
         updateWindowTitle();
     }
 
     void copyTexturesToRenderer();
-    inline void updateRenderer() { SDL_RenderPresent(m_renderer); }
+    inline void updateRenderer()
+    {
+        SDL_RenderPresent(m_renderer);
+        m_needsRedraw = false;
+    }
+
+    /*
+     * Returns true if the game screen, the debugger or an overlay
+     * has changed since the last `updateRenderer()`.
+     */
+    inline bool needsRedraw() const
+    {
+        return m_needsRedraw || m_dirtyRows || m_infoMessageTimeRemaining > 0
+            || (m_isDebugMode && m_isDebugInfoOutdated);
+    }
+    inline void requestRedraw() { m_needsRedraw = true; }
 
     void updateWindowTitle();
 
-    inline void togglePause() { m_isPaused = !m_isPaused; updateWindowTitle(); }
-    inline void pause() { m_isPaused = true; updateWindowTitle(); }
-    inline void unpause() { m_isPaused = false; updateWindowTitle(); }
+    inline void togglePause() { m_isPaused = !m_isPaused; updateEmulatorPause(); updateWindowTitle(); }
+    inline void pause() { m_isPaused = true; updateEmulatorPause(); updateWindowTitle(); }
+    inline void unpause() { m_isPaused = false; updateEmulatorPause(); updateWindowTitle(); }
     inline bool isPaused() const { return m_isPaused; }
 
+    /*
+     * In stepping mode, only the instructions requested with `step()` are executed.
+     */
+    inline void setSteppingMode(bool value) { m_isSteppingMode = value; updateEmulatorPause(); }
+    inline bool isSteppingMode() const { return m_isSteppingMode; }
+    inline void step() { if (m_isSteppingMode && !m_isPaused) m_emulator.step(); }
+
+    /*
+     * While rewinding, the machine steps back a frame every frame.
+     */
+    inline void setRewinding(bool value)
+    {
+        if (value == m_isRewinding)
+            return;
+        m_isRewinding = value;
+        m_emulator.setRewinding(value);
+        updateWindowTitle();
+    }
+    inline bool isRewinding() const { return m_isRewinding; }
+
     void whenWindowResized(int width, int height);
+    /*
+     * Should be called when the renderer lost the content of the render targets.
+     */
+    void whenRenderTargetsReset();
 
     void toggleFullscreen();
     void toggleDebugMode();
@@ -277,10 +301,7 @@ public:
     inline uint32_t getWindowID() const { return SDL_GetWindowID(m_window); }
 
     inline bool hasExited() const { return m_hasExited; }
-    inline bool getRenderFlag() const { return m_renderer; }
-
-    inline void clearLastRegisterOperationFlags() { m_registers.clearReadWrittenFlags(); }
-    inline void clearIsReadingKeyStateFlag() { m_isReadingKey = false; }
+    inline bool getRenderFlag() const { return m_dirtyRows; }
 
     /*
      * If `dumpAll` is true, the memory and the screenbuffer are dumped, too.
@@ -288,16 +309,76 @@ public:
     std::string dumpStateToStr(bool dumpAll=true);
 
     std::string saveScreenshot() const;
+    /*
+     * Writes the profile collected since the debug mode was enabled to a JSON file.
+     * Returns the name of the file, an empty string if not in debug mode or on error.
+     */
+    std::string exportProfile();
+    /*
+     * Writes the memory accesses recorded since the debug mode was enabled to a text file,
+     * see `MemoryAccessMap::saveToFile()`.
+     * Returns the name of the file, an empty string if not in debug mode or on error.
+     */
+    std::string exportMemoryMap();
+
+    /*
+     * While tracing, the last `TRACE_BUFFER_SIZE` executed instructions are kept,
+     * so they can be saved with `saveTrace()`. They are saved on panic, too.
+     * Enabling it clears the earlier trace.
+     */
+    void setTracing(bool value);
+    inline bool isTracing() const { return m_isTracing; }
+    /*
+     * Writes the traced instructions to a file, it can be read with `chip8trace`.
+     * Returns the name of the file, an empty string if nothing was traced or on error.
+     */
+    std::string saveTrace();
+
+    /*
+     * Saves the state of the machine to the slot file of the ROM.
+     * Returns false on error.
+     */
+    bool saveState();
+    /*
+     * Restores the state saved by `saveState()`.
+     * Returns false if there is no valid state in the slot.
+     */
+    bool loadState();
+
+    /*
+     * Sets the seed of the random number generator of the machine, so the runs can be reproduced.
+     */
+    void setRandomSeed(uint64_t seed);
+
+    /*
+     * Starts recording the input to a movie, it is saved to `path` when the recording stops.
+     * The recording stops on reset, on loading a state, on changing a compatibility option and on exit,
+     * since the movie couldn't reproduce the run after these.
+     */
+    void startRecording(const std::string& path);
+    /*
+     * Saves the movie if recording.
+     * Returns false on error.
+     */
+    bool stopRecording();
+    inline bool isRecording() const { return !m_recordingPath.empty(); }
+
+    /*
+     * Replays a movie recorded with `startRecording()`. Resetting restarts the replay.
+     * Returns false if the movie can't be loaded.
+     */
+    bool startReplay(const std::string& path);
 
     inline void setInfoMessage(InfoMessageValue message, const std::string& extra="")
     {
         m_infoMessage = message;
         m_infoMessageExtra = extra;
         m_infoMessageTimeRemaining = MESSAGE_SHOW_TIME_S;
+        m_needsRedraw = true;
     }
     void updateInfoMessage();
 
-    inline void toggleKeyboardHelp() { m_shouldShowKeyboardHelp = !m_shouldShowKeyboardHelp; }
+    inline void toggleKeyboardHelp() { m_shouldShowKeyboardHelp = !m_shouldShowKeyboardHelp; m_needsRedraw = true; }
     void updateOverlay();
 
     void deinit();
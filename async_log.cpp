@@ -0,0 +1,240 @@
+#include "async_log.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <cstdlib>
+#include <memory>
+
+namespace AsyncLog
+{
+
+namespace
+{
+
+/*
+ * A bounded queue that any thread can push to without locking, and one thread pops from.
+ * Every cell has a sequence number that tells whose turn it is (Dmitry Vyukov's bounded queue).
+ * The messages are stored in the cells, so nothing is allocated for them.
+ */
+class EntryQueue final
+{
+public:
+    static constexpr size_t CAPACITY = 1024;
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Level level;
+        const EntryType* type;
+        alignas(std::max_align_t) unsigned char storage[ARGS_STORAGE_SIZE];
+    };
+
+private:
+    Cell m_cells[CAPACITY];
+    alignas(64) std::atomic<size_t> m_pushPos{};
+    // Only used by the consumer
+    alignas(64) size_t m_popPos{};
+
+public:
+    EntryQueue()
+    {
+        for (size_t i{}; i < CAPACITY; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /*
+     * Stores a message in a free cell.
+     * Returns false if the queue is full.
+     */
+    bool push(Level level, const EntryType& type, void* args)
+    {
+        size_t pos = m_pushPos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = m_cells[pos % CAPACITY];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == pos)
+            {
+                // The cell is free, claim it
+                if (m_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.level = level;
+                    cell.type = &type;
+                    type.construct(cell.storage, args);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (sequence < pos)
+            {
+                // The consumer hasn't freed the cell yet
+                return false;
+            }
+            else
+            {
+                // Another thread took the cell
+                pos = m_pushPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*
+     * Returns the oldest message, nullptr if the queue is empty.
+     * It stays in the queue until `pop()`.
+     */
+    const Cell* front() const
+    {
+        const Cell& cell = m_cells[m_popPos % CAPACITY];
+        if (cell.sequence.load(std::memory_order_acquire) != m_popPos + 1)
+            return nullptr;
+        return &cell;
+    }
+
+    /*
+     * Frees the cell of the oldest message, `front()` has to return it.
+     */
+    void pop()
+    {
+        Cell& cell = m_cells[m_popPos % CAPACITY];
+        cell.type->destroy(cell.storage);
+        cell.sequence.store(m_popPos + CAPACITY, std::memory_order_release);
+        ++m_popPos;
+    }
+};
+
+EntryQueue g_queue;
+std::thread g_thread;
+std::atomic<bool> g_isRunning{};
+std::atomic<bool> g_shouldStop{};
+// To know when everything queued so far was written
+std::atomic<uint64_t> g_pushedCount{};
+std::atomic<uint64_t> g_writtenCount{};
+std::atomic<uint64_t> g_droppedCount{};
+// The threads in `submit()` that may push, `stop()` waits for them
+std::atomic<int> g_submittingCount{};
+// The Logger is not thread-safe, while the background thread is not running any thread may write
+std::mutex g_writeMutex;
+
+void writeEntry(Level level, const EntryType& type, const void* storage)
+{
+    std::ostringstream output;
+    type.format(storage, output);
+
+    std::lock_guard<std::mutex> lock{g_writeMutex};
+    if (level == Level::Error)
+        Logger::err << output.str() << Logger::End;
+    else
+        Logger::log << output.str() << Logger::End;
+}
+
+/*
+ * Writes the queued messages, returns false if there were none.
+ * Only called by one thread at a time.
+ */
+bool drainQueue()
+{
+    bool hasWritten{};
+    while (const EntryQueue::Cell* cell = g_queue.front())
+    {
+        writeEntry(cell->level, *cell->type, cell->storage);
+        g_queue.pop();
+        g_writtenCount.fetch_add(1, std::memory_order_release);
+        hasWritten = true;
+    }
+
+    if (const uint64_t dropped = g_droppedCount.exchange(0, std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock{g_writeMutex};
+        Logger::err << "The log queue was full, " << dropped << " messages were dropped" << Logger::End;
+    }
+    return hasWritten;
+}
+
+void threadMain()
+{
+    while (!g_shouldStop.load(std::memory_order_acquire))
+    {
+        // Nothing urgent, the messages can wait a little
+        if (!drainQueue())
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    drainQueue();
+}
+
+} // namespace
+
+void submit(Level level, const EntryType& type, void* args)
+{
+    // Counted before checking the thread, so `stop()` knows about this message
+    g_submittingCount.fetch_add(1);
+    if (!g_isRunning.load())
+    {
+        g_submittingCount.fetch_sub(1, std::memory_order_release);
+        alignas(std::max_align_t) unsigned char storage[ARGS_STORAGE_SIZE];
+        type.construct(storage, args);
+        writeEntry(level, type, storage);
+        type.destroy(storage);
+        return;
+    }
+
+    while (!g_queue.push(level, type, args))
+    {
+        if (level != Level::Error)
+        {
+            g_droppedCount.fetch_add(1, std::memory_order_relaxed);
+            g_submittingCount.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        std::this_thread::yield();
+    }
+    g_pushedCount.fetch_add(1, std::memory_order_release);
+    g_submittingCount.fetch_sub(1, std::memory_order_release);
+}
+
+void start()
+{
+    if (g_isRunning.load())
+        return;
+
+    static bool isStopRegistered{};
+    if (!isStopRegistered)
+    {
+        std::atexit(stop);
+        isStopRegistered = true;
+    }
+
+    g_shouldStop.store(false);
+    g_thread = std::thread{threadMain};
+    g_isRunning.store(true, std::memory_order_release);
+}
+
+void stop()
+{
+    if (!g_isRunning.load())
+        return;
+
+    g_isRunning.store(false);
+    g_shouldStop.store(true, std::memory_order_release);
+    g_thread.join();
+    // The threads that saw the background thread running may still be pushing
+    while (g_submittingCount.load()
+            || g_writtenCount.load(std::memory_order_acquire) < g_pushedCount.load(std::memory_order_acquire))
+    {
+        if (!drainQueue())
+            std::this_thread::yield();
+    }
+}
+
+void flush()
+{
+    const uint64_t pushedCount = g_pushedCount.load(std::memory_order_acquire);
+    while (g_isRunning.load(std::memory_order_acquire)
+            && g_writtenCount.load(std::memory_order_acquire) < pushedCount)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+} // namespace AsyncLog
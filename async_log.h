@@ -0,0 +1,163 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <memory>
+#include <new>
+#include <cstddef>
+
+#include "config.h"
+
+/*
+ * Logging that doesn't make the calling thread wait for the terminal.
+ *
+ * The arguments of a message are copied into a preallocated cell of a queue and formatted
+ * (streamed with `<<`) and written to the `Logger` on a background thread, started with `start()`.
+ * Until it is started (for example in the headless tools), the messages are written right away,
+ * one thread at a time.
+ * A message is formatted on its own, so manipulators like `std::hex` only affect the rest of it.
+ * Queuing a message doesn't allocate, unless its arguments don't fit in a cell
+ * or it has non-literal strings too long to be stored in a `std::string` without allocating.
+ *
+ * The messages below `LOG_MIN_LEVEL` (see config.h) are compiled out, their arguments are not copied.
+ * The arguments are still evaluated by the functions, except by `ASYNC_LOG_TRACE()`.
+ */
+namespace AsyncLog
+{
+
+enum class Level
+{
+    Trace = LOG_LEVEL_TRACE,
+    Debug = LOG_LEVEL_DEBUG,
+    Info = LOG_LEVEL_INFO,
+    Error = LOG_LEVEL_ERROR,
+};
+
+/*
+ * The type an argument is stored as until it is formatted.
+ * The strings are copied, a pointer could be invalid by the time the message is written.
+ * Only the constant character arrays are kept as pointers, they are expected to be string literals.
+ */
+template<typename T>
+struct StoredArg
+{
+    using type = std::decay_t<T>;
+};
+template<typename T>
+struct StoredArg<T*>
+{
+    using type = std::conditional_t<std::is_same_v<std::remove_cv_t<T>, char>, std::string, T*>;
+};
+template<size_t N>
+struct StoredArg<const char[N]>
+{
+    using type = const char*;
+};
+template<size_t N>
+struct StoredArg<char[N]>
+{
+    using type = std::string;
+};
+template<typename T>
+using StoredArgT = typename std::conditional_t<std::is_array_v<std::remove_reference_t<T>>,
+      StoredArg<std::remove_reference_t<T>>, StoredArg<std::decay_t<T>>>::type;
+
+// The stored arguments of a message are kept in its queue cell if they fit in this many bytes
+constexpr size_t ARGS_STORAGE_SIZE = 192;
+
+/*
+ * How the stored arguments of a kind of message are handled in the storage of a queue cell.
+ */
+struct EntryType
+{
+    // Stores the arguments passed to `write()` (a tuple of references) in `storage`
+    void (*construct)(void* storage, void* args);
+    void (*format)(const void* storage, std::ostream& output);
+    void (*destroy)(void* storage);
+};
+
+template<typename... Args>
+struct EntryTypeOf
+{
+    using Tuple = std::tuple<StoredArgT<Args>...>;
+    static constexpr bool isInline = sizeof(Tuple) <= ARGS_STORAGE_SIZE && alignof(Tuple) <= alignof(std::max_align_t);
+    // Too large for a cell (like the memory dump), the cell holds a pointer to it
+    using Stored = std::conditional_t<isInline, Tuple, std::unique_ptr<Tuple>>;
+    using Refs = std::tuple<Args&&...>;
+
+    static void construct(void* storage, void* args)
+    {
+        std::apply([storage](auto&&... values){
+            if constexpr (isInline)
+                new (storage) Stored{std::forward<decltype(values)>(values)...};
+            else
+                new (storage) Stored{std::make_unique<Tuple>(std::forward<decltype(values)>(values)...)};
+        }, std::move(*static_cast<Refs*>(args)));
+    }
+
+    static void format(const void* storage, std::ostream& output)
+    {
+        const Tuple* tuple;
+        if constexpr (isInline)
+            tuple = static_cast<const Tuple*>(storage);
+        else
+            tuple = static_cast<const Stored*>(storage)->get();
+        std::apply([&output](const auto&... values){ (output << ... << values); }, *tuple);
+    }
+
+    static void destroy(void* storage) { static_cast<Stored*>(storage)->~Stored(); }
+
+    static constexpr EntryType type{construct, format, destroy};
+};
+
+/*
+ * Stores the arguments in a queue cell, or writes the message right away if the background thread is not running.
+ * If the queue is full, the error messages wait for space, the others are dropped.
+ */
+void submit(Level level, const EntryType& type, void* args);
+
+constexpr bool isEnabled(Level level) { return (int)level >= LOG_MIN_LEVEL; }
+
+template<Level level, typename... Args>
+inline void write(Args&&... args)
+{
+    if constexpr (isEnabled(level))
+    {
+        typename EntryTypeOf<Args...>::Refs refs{std::forward<Args>(args)...};
+        submit(level, EntryTypeOf<Args...>::type, &refs);
+    }
+}
+
+template<typename... Args>
+inline void debug(Args&&... args) { write<Level::Debug>(std::forward<Args>(args)...); }
+template<typename... Args>
+inline void info(Args&&... args) { write<Level::Info>(std::forward<Args>(args)...); }
+template<typename... Args>
+inline void error(Args&&... args) { write<Level::Error>(std::forward<Args>(args)...); }
+
+/*
+ * Starts the background thread. It is stopped at exit, so the queued messages are not lost.
+ */
+void start();
+/*
+ * Writes the queued messages and stops the background thread, the later messages are written right away.
+ */
+void stop();
+/*
+ * Waits until the messages queued so far are written, for example before `std::abort()`.
+ */
+void flush();
+
+} // namespace AsyncLog
+
+/*
+ * Every executed instruction and similar, too slow to be enabled normally.
+ * A macro, so the arguments are not evaluated on the hot paths if tracing is compiled out.
+ */
+#define ASYNC_LOG_TRACE(...) \
+    do { if constexpr (AsyncLog::isEnabled(AsyncLog::Level::Trace)) AsyncLog::write<AsyncLog::Level::Trace>(__VA_ARGS__); } while (0)
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,241 @@
+#include "chip8api.h"
+#include "chip8core.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <new>
+
+struct Chip8Instance
+{
+    Chip8Core core;
+    // The last loaded program, for `chip8_reset()`
+    std::vector<uint8_t> rom;
+    uint64_t seed{};
+    // The part of a cycle left over from the earlier frames, in 1/FRAMES_PER_SECOND cycles
+    uint64_t frameCycleRemainder{};
+
+    void* frameOutput{};
+    int frameFormat{};
+};
+
+namespace
+{
+
+std::once_flag g_loggerSetupFlag;
+
+/*
+ * Writes the changed rows of the framebuffer to the frame output of the instance.
+ */
+void writeFrameOutput(Chip8Instance* instance)
+{
+    Chip8Core& core = instance->core;
+    const uint32_t dirtyRows = core.getDirtyRows();
+    if (!instance->frameOutput || !dirtyRows)
+        return;
+
+    const Framebuffer& frameBuffer = core.getFrameBuffer();
+    for (uint32_t bits{dirtyRows}; bits; bits &= bits - 1)
+    {
+        const int y = __builtin_ctz(bits);
+        const uint64_t row = frameBuffer.getRow(y);
+        if (instance->frameFormat == CHIP8_FRAME_FORMAT_ROWS)
+        {
+            static_cast<uint64_t*>(instance->frameOutput)[y] = row;
+        }
+        else
+        {
+            uint8_t* dest = static_cast<uint8_t*>(instance->frameOutput) + y * CHIP8_SCREEN_WIDTH;
+            for (int x{}; x < CHIP8_SCREEN_WIDTH; ++x)
+                dest[x] = (row >> (63 - x)) & 1;
+        }
+    }
+    core.clearDirtyRows();
+}
+
+} // namespace
+
+extern "C" {
+
+Chip8Instance* chip8_create(void)
+{
+    // The machine logs every reset and the whole memory when a program is loaded,
+    // that is only useful for the emulator.
+    // The messages go through AsyncLog, which writes them one thread at a time.
+    std::call_once(g_loggerSetupFlag, [](){ Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet); });
+
+    Chip8Instance* instance = new (std::nothrow) Chip8Instance{};
+    if (!instance)
+        return nullptr;
+    instance->core.setRandomSeed(instance->seed);
+    instance->core.setJitEnabled(true);
+    return instance;
+}
+
+void chip8_destroy(Chip8Instance* instance)
+{
+    delete instance;
+}
+
+int chip8_load_rom(Chip8Instance* instance, const uint8_t* data, size_t size)
+{
+    if (size > Chip8Core::MAX_ROM_SIZE)
+        return -1;
+
+    instance->rom.assign(data, data + size);
+    chip8_reset(instance);
+    return 0;
+}
+
+void chip8_reset(Chip8Instance* instance)
+{
+    instance->core.reset();
+    instance->core.loadRom(instance->rom.data(), instance->rom.size());
+    instance->core.setRandomSeed(instance->seed);
+    instance->frameCycleRemainder = 0;
+    writeFrameOutput(instance);
+}
+
+void chip8_set_seed(Chip8Instance* instance, uint64_t seed)
+{
+    instance->seed = seed;
+    instance->core.setRandomSeed(seed);
+}
+
+void chip8_set_keys(Chip8Instance* instance, uint16_t keys)
+{
+    instance->core.setKeyStates(keys);
+}
+
+void chip8_set_instructions_per_second(Chip8Instance* instance, int value)
+{
+    if (value <= 0)
+        return;
+    instance->core.setInstructionsPerSecond(value);
+    instance->frameCycleRemainder = 0;
+}
+
+void chip8_set_quirks(Chip8Instance* instance, int shiftYRegInsteadOfX, int incIAfterRegFillLoad)
+{
+    instance->core.setCompatShiftYRegInsteadOfX(shiftYRegInsteadOfX);
+    instance->core.setCompatIncIAfterRegFillLoad(incIAfterRegFillLoad);
+}
+
+int chip8_set_jit_enabled(Chip8Instance* instance, int enabled)
+{
+    return instance->core.setJitEnabled(enabled) ? 0 : -1;
+}
+
+int chip8_set_frame_output(Chip8Instance* instance, void* dest, int format)
+{
+    if (format != CHIP8_FRAME_FORMAT_ROWS && format != CHIP8_FRAME_FORMAT_BYTES)
+        return -1;
+
+    instance->frameOutput = dest;
+    instance->frameFormat = format;
+    instance->core.markAllRowsDirty();
+    writeFrameOutput(instance);
+    return 0;
+}
+
+uint64_t chip8_step_frames(Chip8Instance* instance, int frames)
+{
+    Chip8Core& core = instance->core;
+
+    // Like the emulator thread, but the fractions of cycles are counted exactly
+    instance->frameCycleRemainder += (uint64_t)core.getInstructionsPerSecond() * std::max(frames, 0);
+    uint64_t cycles = instance->frameCycleRemainder / FRAMES_PER_SECOND;
+    instance->frameCycleRemainder %= FRAMES_PER_SECOND;
+
+    uint64_t executed{};
+    while (cycles && !core.hasPanicked())
+    {
+        const int ran = core.run(std::min<uint64_t>(cycles, 1000000));
+        if (ran == 0)
+            break;
+        cycles -= ran;
+        executed += ran;
+    }
+
+    writeFrameOutput(instance);
+    return executed;
+}
+
+void chip8_step_batch(Chip8Instance* const* instances, size_t count, const uint16_t* keys, int frames)
+{
+    for (size_t i{}; i < count; ++i)
+    {
+        if (keys)
+            instances[i]->core.setKeyStates(keys[i]);
+        chip8_step_frames(instances[i], frames);
+    }
+}
+
+const uint64_t* chip8_get_frame_rows(const Chip8Instance* instance)
+{
+    return instance->core.getFrameBuffer().m_rows;
+}
+
+const uint8_t* chip8_get_memory(const Chip8Instance* instance)
+{
+    return instance->core.getMemory();
+}
+
+uint8_t chip8_get_register(const Chip8Instance* instance, int index)
+{
+    return instance->core.getRegisters().peek(index & 0xf);
+}
+
+uint16_t chip8_get_pc(const Chip8Instance* instance)
+{
+    return instance->core.getPC();
+}
+
+uint8_t chip8_get_sound_timer(const Chip8Instance* instance)
+{
+    return instance->core.getSoundTimer();
+}
+
+uint64_t chip8_get_cycle_count(const Chip8Instance* instance)
+{
+    return instance->core.getCycleCount();
+}
+
+int chip8_is_waiting_for_key(const Chip8Instance* instance)
+{
+    return instance->core.isWaitingForKey();
+}
+
+int chip8_has_panicked(const Chip8Instance* instance)
+{
+    return instance->core.hasPanicked();
+}
+
+const char* chip8_get_panic_message(const Chip8Instance* instance)
+{
+    return instance->core.getPanicMessage().c_str();
+}
+
+size_t chip8_get_state_size(void)
+{
+    return Chip8Core::SAVE_STATE_SIZE;
+}
+
+void chip8_save_state(const Chip8Instance* instance, uint8_t* dest)
+{
+    instance->core.saveState(dest);
+}
+
+int chip8_load_state(Chip8Instance* instance, const uint8_t* data, size_t size)
+{
+    if (!instance->core.loadState(data, size))
+        return -1;
+
+    // The cycles of a frame are counted from the loaded state
+    instance->frameCycleRemainder = 0;
+    writeFrameOutput(instance);
+    return 0;
+}
+
+} // extern "C"
@@ -0,0 +1,142 @@
+#ifndef CHIP8API_H
+#define CHIP8API_H
+
+/*
+ * C API of the emulated machine, built as the `chip8` shared library.
+ *
+ * An instance is a separate machine without a window or sound. The frames are
+ * stepped with `chip8_step_frames()`, or for many instances with `chip8_step_batch()`.
+ * The framebuffer can be read without copying with `chip8_get_frame_rows()`, or the
+ * instance can write it to a buffer of the caller after every step,
+ * see `chip8_set_frame_output()`.
+ *
+ * The instances are independent, different instances can be used from different threads.
+ * An instance must not be used from two threads at the same time.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(_WIN32)
+#   ifdef CHIP8_API_BUILD
+#       define CHIP8_API __declspec(dllexport)
+#   else
+#       define CHIP8_API __declspec(dllimport)
+#   endif
+#else
+#   define CHIP8_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP8_SCREEN_WIDTH 64
+#define CHIP8_SCREEN_HEIGHT 32
+
+/*
+ * Formats of the frame output.
+ */
+enum Chip8FrameFormat
+{
+    // 32 uint64_t rows, the leftmost pixel is the most significant bit (256 bytes)
+    CHIP8_FRAME_FORMAT_ROWS = 0,
+    // One byte for every pixel, 0 or 1, row by row (`CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT` bytes)
+    CHIP8_FRAME_FORMAT_BYTES = 1,
+};
+
+typedef struct Chip8Instance Chip8Instance;
+
+/*
+ * Creates a machine with the random seed 0 and the JIT enabled (if available).
+ * Returns NULL if out of memory.
+ */
+CHIP8_API Chip8Instance* chip8_create(void);
+CHIP8_API void chip8_destroy(Chip8Instance* instance);
+
+/*
+ * Resets the machine and loads a program to 0x200.
+ * The program is copied, it is loaded again by `chip8_reset()`.
+ * Returns 0 on success, -1 if the program doesn't fit in the memory.
+ */
+CHIP8_API int chip8_load_rom(Chip8Instance* instance, const uint8_t* data, size_t size);
+/*
+ * Resets the machine and loads the last program again.
+ * The random number generator is seeded again with the last seed.
+ */
+CHIP8_API void chip8_reset(Chip8Instance* instance);
+
+CHIP8_API void chip8_set_seed(Chip8Instance* instance, uint64_t seed);
+/*
+ * Bit N is key N. If `Fx0A` is waiting, the lowest newly pressed key finishes the wait.
+ */
+CHIP8_API void chip8_set_keys(Chip8Instance* instance, uint16_t keys);
+/*
+ * How many instructions are executed in a second, 500 by default. A frame is 1/60 s.
+ */
+CHIP8_API void chip8_set_instructions_per_second(Chip8Instance* instance, int value);
+/*
+ * The shift and `Fx55`/`Fx66` quirks, both are enabled by default.
+ */
+CHIP8_API void chip8_set_quirks(Chip8Instance* instance, int shiftYRegInsteadOfX, int incIAfterRegFillLoad);
+/*
+ * Returns 0 on success, -1 if the JIT is not available.
+ */
+CHIP8_API int chip8_set_jit_enabled(Chip8Instance* instance, int enabled);
+
+/*
+ * Sets the buffer the framebuffer is written to after every step, NULL disables it.
+ * Only the changed rows are written, the whole frame is written right away,
+ * and after loading a program or a state. The buffer has to be valid until it is replaced.
+ * Returns 0 on success, -1 if the format is invalid.
+ */
+CHIP8_API int chip8_set_frame_output(Chip8Instance* instance, void* dest, int format);
+
+/*
+ * Runs the machine for `frames` frames of emulated time.
+ * Returns the number of executed cycles, it stops early if the machine panics.
+ */
+CHIP8_API uint64_t chip8_step_frames(Chip8Instance* instance, int frames);
+/*
+ * Sets the keys of `instances[i]` to `keys[i]` (if `keys` is not NULL),
+ * then runs each of them for `frames` frames.
+ * Frame outputs set with `chip8_set_frame_output()` can point into one contiguous buffer,
+ * then the observations of the whole batch are there after the call.
+ */
+CHIP8_API void chip8_step_batch(Chip8Instance* const* instances, size_t count, const uint16_t* keys, int frames);
+
+/*
+ * The framebuffer of the machine, 32 uint64_t rows in the format of `CHIP8_FRAME_FORMAT_ROWS`.
+ * The pointer stays valid, the rows are updated in place.
+ */
+CHIP8_API const uint64_t* chip8_get_frame_rows(const Chip8Instance* instance);
+/*
+ * The 4096 bytes of memory, updated in place.
+ */
+CHIP8_API const uint8_t* chip8_get_memory(const Chip8Instance* instance);
+CHIP8_API uint8_t chip8_get_register(const Chip8Instance* instance, int index);
+CHIP8_API uint16_t chip8_get_pc(const Chip8Instance* instance);
+CHIP8_API uint8_t chip8_get_sound_timer(const Chip8Instance* instance);
+CHIP8_API uint64_t chip8_get_cycle_count(const Chip8Instance* instance);
+CHIP8_API int chip8_is_waiting_for_key(const Chip8Instance* instance);
+CHIP8_API int chip8_has_panicked(const Chip8Instance* instance);
+/*
+ * Empty if the machine hasn't panicked.
+ */
+CHIP8_API const char* chip8_get_panic_message(const Chip8Instance* instance);
+
+/*
+ * The size of the states written by `chip8_save_state()`.
+ */
+CHIP8_API size_t chip8_get_state_size(void);
+CHIP8_API void chip8_save_state(const Chip8Instance* instance, uint8_t* dest);
+/*
+ * Returns 0 on success, -1 if the state is invalid (the machine is left untouched).
+ */
+CHIP8_API int chip8_load_state(Chip8Instance* instance, const uint8_t* data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHIP8API_H
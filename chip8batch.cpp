@@ -0,0 +1,333 @@
+/*
+ * Headless batch runner.
+ *
+ * Usage: chip8batch [options] <ROM file or directory>...
+ *
+ * Runs every ROM (the `.ch8` files of the directories, recursively) with every
+ * combination of quirks given, on all the cores. Each run gets its own machine,
+ * so the runs are independent and reproducible.
+ *
+ * Options:
+ *      --cycles <count>    How many cycles a ROM runs for, 1000000 by default
+ *      --seed <number>     Seed of the random number generator, 0 by default
+ *      --quirks <list>     Comma separated quirk sets to run every ROM with, each one of
+ *                          `none`, `shift`, `inci`, `shift+inci` (the default) or `all` for all of them
+ *      --movie <file>      Also replays a movie to its end, it has its own ROM, quirks and seed
+ *      --threads <count>   The number of worker threads, one for every hardware thread by default
+ *      --interpret         Don't use the JIT
+ *
+ * A tab separated line is printed for every run, in the order of the arguments.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <memory>
+#include <cstring>
+
+#include "chip8core.h"
+#include "movie.h"
+#include "work_stealing_pool.h"
+#include "to_hex.h"
+#include "async_log.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+// The runs are split into pieces of this many cycles
+#define RUN_CHUNK_CYCLES 1000000
+
+namespace
+{
+
+struct RunSpec
+{
+    std::string path;
+    bool isMovie{};
+    bool isCompatShiftYReg{};
+    bool isCompatIncI{};
+};
+
+struct RunResult
+{
+    // Empty if the run was successful
+    std::string error;
+    uint64_t cycleCount{};
+    uint16_t pc{};
+    uint32_t frameBufferHash{};
+    bool hasPanicked{};
+    std::string panicMessage;
+};
+
+struct Options
+{
+    uint64_t cycles = 1000000;
+    uint64_t seed{};
+    size_t threadCount{};
+    bool useInterpreter{};
+};
+
+std::string getQuirkName(const RunSpec& spec)
+{
+    if (spec.isMovie)
+        return "movie";
+    if (spec.isCompatShiftYReg && spec.isCompatIncI)
+        return "shift+inci";
+    if (spec.isCompatShiftYReg)
+        return "shift";
+    if (spec.isCompatIncI)
+        return "inci";
+    return "none";
+}
+
+/*
+ * Parses a decimal, hexadecimal (`0x`) or octal number.
+ * Returns false on error.
+ */
+bool parseNumber(const std::string& text, unsigned long long& value)
+{
+    try
+    {
+        size_t end;
+        value = std::stoull(text, &end, 0);
+        return end == text.size();
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+/*
+ * Parses the argument of `--quirks` into (shift, inci) pairs.
+ * Returns false on error.
+ */
+bool parseQuirks(const std::string& list, std::vector<std::pair<bool, bool>>& quirks)
+{
+    quirks.clear();
+    size_t start{};
+    while (start <= list.size())
+    {
+        const size_t end = std::min(list.find(',', start), list.size());
+        const std::string name = list.substr(start, end - start);
+        if (name == "none")
+            quirks.emplace_back(false, false);
+        else if (name == "shift")
+            quirks.emplace_back(true, false);
+        else if (name == "inci")
+            quirks.emplace_back(false, true);
+        else if (name == "shift+inci")
+            quirks.emplace_back(true, true);
+        else if (name == "all")
+            quirks.insert(quirks.end(), {{false, false}, {true, false}, {false, true}, {true, true}});
+        else
+            return false;
+        start = end + 1;
+    }
+    return !quirks.empty();
+}
+
+void runRom(const RunSpec& spec, const Options& options, Chip8Core& core, RunResult& result)
+{
+    std::ifstream file{spec.path, std::ios::binary};
+    if (!file)
+    {
+        result.error = "unable to open";
+        return;
+    }
+    const std::vector<uint8_t> rom{std::istreambuf_iterator<char>{file}, {}};
+
+    if (!core.loadRom(rom.data(), rom.size()))
+    {
+        result.error = "too large";
+        return;
+    }
+    core.setRandomSeed(options.seed);
+    core.setCompatShiftYRegInsteadOfX(spec.isCompatShiftYReg);
+    core.setCompatIncIAfterRegFillLoad(spec.isCompatIncI);
+
+    uint64_t executed{};
+    while (executed < options.cycles && !core.hasPanicked())
+    {
+        const int ran = core.run(std::min<uint64_t>(options.cycles - executed, RUN_CHUNK_CYCLES));
+        if (ran == 0)
+            break;
+        executed += ran;
+    }
+}
+
+void runMovie(const RunSpec& spec, Chip8Core& core, RunResult& result)
+{
+    Movie movie;
+    if (!movie.load(spec.path))
+    {
+        result.error = "invalid movie";
+        return;
+    }
+    auto player = std::make_unique<MoviePlayer>(std::move(movie));
+    if (!player->start(core))
+    {
+        result.error = "invalid movie state";
+        return;
+    }
+
+    while (!player->isFinished(core))
+    {
+        if (player->run(core, RUN_CHUNK_CYCLES) == 0)
+            break;
+    }
+}
+
+void run(const RunSpec& spec, const Options& options, RunResult& result)
+{
+    auto core = std::make_unique<Chip8Core>();
+    core->setJitEnabled(!options.useInterpreter);
+
+    if (spec.isMovie)
+        runMovie(spec, *core, result);
+    else
+        runRom(spec, options, *core, result);
+    if (!result.error.empty())
+        return;
+
+    result.cycleCount = core->getCycleCount();
+    result.pc = core->getPC();
+    result.frameBufferHash = core->getFrameBuffer().getHash();
+    result.hasPanicked = core->hasPanicked();
+    result.panicMessage = core->getPanicMessage();
+}
+
+/*
+ * Adds the ROM file or the `.ch8` files of the directory to `paths`.
+ * Returns false if the path doesn't exist.
+ */
+bool addRomPaths(const std::string& path, std::vector<std::string>& paths)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    if (fs::is_regular_file(path, error))
+    {
+        paths.push_back(path);
+        return true;
+    }
+    if (!fs::is_directory(path, error))
+        return false;
+
+    std::vector<std::string> found;
+    for (const auto& entry : fs::recursive_directory_iterator{path, error})
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+            found.push_back(entry.path().string());
+    }
+    // The order of the directory listing is not defined, sort it so the output can be compared
+    std::sort(found.begin(), found.end());
+    paths.insert(paths.end(), found.begin(), found.end());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+    // The logger is not thread-safe, the machines log from the worker threads
+    // (when they are created, get a program or panic), only the log thread writes
+    AsyncLog::start();
+
+    Options options;
+    std::vector<std::pair<bool, bool>> quirks{{true, true}};
+    std::vector<std::string> romPaths;
+    std::vector<std::string> moviePaths;
+    bool isUsageWrong{};
+    for (int i{1}; i < argc && !isUsageWrong; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        unsigned long long value{};
+        if (std::strcmp(argv[i], "--cycles") == 0 && hasValue)
+        {
+            isUsageWrong = !parseNumber(argv[++i], value);
+            options.cycles = value;
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+        {
+            isUsageWrong = !parseNumber(argv[++i], value);
+            options.seed = value;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+        {
+            isUsageWrong = !parseNumber(argv[++i], value);
+            options.threadCount = value;
+        }
+        else if (std::strcmp(argv[i], "--quirks") == 0 && hasValue)
+            isUsageWrong = !parseQuirks(argv[++i], quirks);
+        else if (std::strcmp(argv[i], "--movie") == 0 && hasValue)
+            moviePaths.push_back(argv[++i]);
+        else if (std::strcmp(argv[i], "--interpret") == 0)
+            options.useInterpreter = true;
+        else if (std::strncmp(argv[i], "--", 2) == 0)
+            isUsageWrong = true;
+        else if (!addRomPaths(argv[i], romPaths))
+        {
+            std::cerr << "No such file or directory: " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+    if (isUsageWrong || (romPaths.empty() && moviePaths.empty()))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--cycles <count>] [--seed <number>] [--quirks <list>]"
+                     " [--movie <file>]... [--threads <count>] [--interpret] <ROM file or directory>..." << std::endl;
+        return 1;
+    }
+
+    std::vector<RunSpec> specs;
+    for (const std::string& path : romPaths)
+    {
+        for (const auto& [isCompatShiftYReg, isCompatIncI] : quirks)
+            specs.push_back({path, false, isCompatShiftYReg, isCompatIncI});
+    }
+    for (const std::string& path : moviePaths)
+        specs.push_back({path, true});
+
+    std::vector<RunResult> results(specs.size());
+    const auto startTime = std::chrono::steady_clock::now();
+    size_t threadCount;
+    {
+        WorkStealingPool pool{options.threadCount};
+        threadCount = pool.getThreadCount();
+        for (size_t i{}; i < specs.size(); ++i)
+            pool.submit([&specs, &options, &results, i](){ run(specs[i], options, results[i]); });
+        pool.wait();
+    }
+    const double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "path\tquirks\tcycles\tpc\tframebuffer_hash\tstatus\n";
+    uint64_t totalCycles{};
+    int failedCount{};
+    for (size_t i{}; i < specs.size(); ++i)
+    {
+        const RunResult& result = results[i];
+        std::cout << specs[i].path << '\t' << getQuirkName(specs[i]) << '\t';
+        if (!result.error.empty())
+        {
+            std::cout << "-\t-\t-\terror: " << result.error << '\n';
+            ++failedCount;
+            continue;
+        }
+
+        std::cout << std::dec << result.cycleCount << '\t'
+                  << to_hex(result.pc, 3) << '\t'
+                  << to_hex(result.frameBufferHash, 8) << '\t'
+                  << (result.hasPanicked ? "panic: " + result.panicMessage : "ok") << '\n';
+        totalCycles += result.cycleCount;
+    }
+    std::cout.flush();
+
+    std::cerr << std::dec << specs.size() << " runs on " << threadCount << " threads in " << elapsedS << " s, "
+              << totalCycles / elapsedS / 1e6 << " million cycles/s" << std::endl;
+
+    return failedCount ? 3 : 0;
+}
@@ -0,0 +1,463 @@
+/*
+ * Benchmark suite.
+ *
+ * Usage: chip8bench [options] [ROM file or directory]...
+ *
+ * Runs every ROM (the `.ch8` files of `roms` by default) headless for a fixed number
+ * of cycles, then runs a microbenchmark for every instruction and for the framebuffer
+ * conversion of `Chip8::renderFrameBuffer()`.
+ *
+ * Options:
+ *      --cycles <count>    How many cycles a ROM and a microbenchmark runs for, 2000000 by default
+ *      --repeat <count>    Every measurement is repeated this many times, the fastest one is reported, 3 by default
+ *      --interpret         Don't use the JIT
+ *      --no-roms           Only run the microbenchmarks
+ *      --no-micro          Only run the ROMs
+ *
+ * The results are printed as tab separated `kind name metric value` lines,
+ * so the outputs of two builds can be compared line by line.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+
+#include "chip8core.h"
+#include "gfx.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+// The ROMs run in pieces of this many cycles, like in the batch runner
+#define RUN_CHUNK_CYCLES 1000000
+
+// At most this many frames are recorded for the framebuffer conversion benchmark of a ROM
+#define MAX_RECORDED_FRAMES 4096
+
+// The instructions are repeated this many times in the loop of a microbenchmark
+#define MICRO_LOOP_LENGTH 128
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    int cycles = 2000000;
+    int repeatCount = 3;
+    bool useInterpreter{};
+};
+
+void printResult(const std::string& kind, const std::string& name, const std::string& metric, double value)
+{
+    std::cout << kind << '\t' << name << '\t' << metric << '\t' << value << '\n';
+}
+
+void printResult(const std::string& kind, const std::string& name, const std::string& metric, uint64_t value)
+{
+    std::cout << kind << '\t' << name << '\t' << metric << '\t' << value << '\n';
+}
+
+/*
+ * Calls `fn` `repeatCount` times and returns the shortest time in seconds.
+ */
+double measureBest(int repeatCount, const std::function<void()>& fn)
+{
+    double best{};
+    for (int i{}; i < repeatCount; ++i)
+    {
+        const auto startTime = Clock::now();
+        fn();
+        const double elapsedS = std::chrono::duration<double>(Clock::now() - startTime).count();
+        if (i == 0 || elapsedS < best)
+            best = elapsedS;
+    }
+    return best;
+}
+
+/*
+ * Converts the changed rows to texels like `Chip8::renderFrameBuffer()`, without uploading them.
+ * Returns the number of converted rows.
+ */
+int convertDirtyRows(const uint64_t* rows, uint32_t dirtyRows, uint32_t* pixels)
+{
+    int convertedCount{};
+    int y{};
+    while (y < 32)
+    {
+        if (!(dirtyRows & (1u << y)))
+        {
+            ++y;
+            continue;
+        }
+
+        const int firstRow = y;
+        while (y < 32 && (dirtyRows & (1u << y)))
+            ++y;
+        const int rowCount = y - firstRow;
+
+        Gfx::expandBitRows(rows + firstRow, rowCount, 64, pixels + firstRow * 64, 64, 0xffffffff, 0xff000000);
+        convertedCount += rowCount;
+    }
+    return convertedCount;
+}
+
+std::unique_ptr<Chip8Core> createCore(const uint8_t* program, size_t size, const Options& options)
+{
+    auto core = std::make_unique<Chip8Core>();
+    core->setJitEnabled(!options.useInterpreter);
+    core->setRandomSeed(0);
+    core->loadRom(program, size);
+    return core;
+}
+
+/*
+ * Runs the core with `run()` until `cycles` cycles elapse or it panics.
+ */
+void runCycles(Chip8Core& core, int cycles)
+{
+    int executed{};
+    while (executed < cycles && !core.hasPanicked())
+    {
+        const int ran = core.run(std::min(cycles - executed, RUN_CHUNK_CYCLES));
+        if (ran == 0)
+            break;
+        executed += ran;
+    }
+}
+
+//-------------------------------- ROMs ----------------------------------------
+
+/*
+ * Adds the ROM file or the `.ch8` files of the directory to `paths`.
+ * Returns false if the path doesn't exist.
+ */
+bool addRomPaths(const std::string& path, std::vector<std::string>& paths)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    if (fs::is_regular_file(path, error))
+    {
+        paths.push_back(path);
+        return true;
+    }
+    if (!fs::is_directory(path, error))
+        return false;
+
+    std::vector<std::string> found;
+    for (const auto& entry : fs::recursive_directory_iterator{path, error})
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+            found.push_back(entry.path().string());
+    }
+    // The order of the directory listing is not defined, sort it so the output can be compared
+    std::sort(found.begin(), found.end());
+    paths.insert(paths.end(), found.begin(), found.end());
+    return true;
+}
+
+void benchmarkRom(const std::string& path, const Options& options)
+{
+    std::ifstream file{path, std::ios::binary};
+    const std::vector<uint8_t> rom{std::istreambuf_iterator<char>{file}, {}};
+    if (!file || rom.size() > Chip8Core::MAX_ROM_SIZE)
+    {
+        std::cerr << "Skipping invalid ROM: " << path << std::endl;
+        return;
+    }
+
+    // The speed of a headless run
+    uint64_t cycleCount{};
+    bool hasPanicked{};
+    const double runS = measureBest(options.repeatCount, [&](){
+        auto core = createCore(rom.data(), rom.size(), options);
+        runCycles(*core, options.cycles);
+        cycleCount = core->getCycleCount();
+        hasPanicked = core->hasPanicked();
+    });
+
+    // The same run instruction by instruction, to count the draws and
+    // to record the changed rows of every frame, like the emulator shows them
+    struct Frame
+    {
+        uint64_t rows[32];
+        uint32_t dirtyRows;
+    };
+    std::vector<Frame> frames;
+    auto core = createCore(rom.data(), rom.size(), options);
+    const int cyclesPerFrame = std::max(1, core->getInstructionsPerSecond() / FRAMES_PER_SECOND);
+    uint64_t drawCount{};
+    uint64_t frameCount{};
+    uint64_t dirtyRowCount{};
+    for (uint64_t cycle{}; cycle < cycleCount && !core->hasPanicked(); ++cycle)
+    {
+        core->emulateCycle();
+        drawCount += decodeOpcode(core->getOpcode()).opClass == OpClass::DRW;
+
+        if ((cycle + 1) % cyclesPerFrame == 0)
+        {
+            const uint32_t dirtyRows = core->getDirtyRows();
+            if (dirtyRows && frames.size() < MAX_RECORDED_FRAMES)
+            {
+                frames.emplace_back();
+                std::memcpy(frames.back().rows, core->getFrameBuffer().m_rows, sizeof(Frame::rows));
+                frames.back().dirtyRows = dirtyRows;
+            }
+            dirtyRowCount += __builtin_popcount(dirtyRows);
+            core->clearDirtyRows();
+            ++frameCount;
+        }
+    }
+
+    // The recorded frames are converted together, a single frame is too quick to time
+    std::vector<uint32_t> pixels(64 * 32);
+    uint64_t convertedRowCount{};
+    const double convertS = measureBest(options.repeatCount, [&](){
+        convertedRowCount = 0;
+        for (const Frame& frame : frames)
+            convertedRowCount += convertDirtyRows(frame.rows, frame.dirtyRows, pixels.data());
+    });
+
+    printResult("rom", path, "cycles", cycleCount);
+    printResult("rom", path, "panicked", (uint64_t)hasPanicked);
+    printResult("rom", path, "mips", cycleCount / runS / 1e6);
+    // The draws of the run at the measured speed
+    printResult("rom", path, "drw_per_s", drawCount / runS);
+    printResult("rom", path, "dirty_rows_per_frame", frameCount ? (double)dirtyRowCount / frameCount : 0.0);
+    printResult("rom", path, "convert_mpix_per_s", convertedRowCount ? convertedRowCount * 64 / convertS / 1e6 : 0.0);
+}
+
+//---------------------------- Instructions ------------------------------------
+
+struct MicroBenchmark
+{
+    const char* name;
+    // Executed once before the loop
+    std::vector<uint16_t> setup;
+    // Returns the instructions at `address` in the loop
+    std::function<std::vector<uint16_t>(uint16_t address)> body;
+};
+
+// Where the subroutine of `CALL` is, after the loop
+constexpr uint16_t MICRO_SUBROUTINE_ADDRESS = 0x600;
+// The memory written and read by the memory instructions
+constexpr uint16_t MICRO_DATA_ADDRESS = 0x800;
+
+std::vector<MicroBenchmark> getMicroBenchmarks()
+{
+    using Ops = std::vector<uint16_t>;
+    auto same = [](uint16_t opcode){ return [opcode](uint16_t){ return Ops{opcode}; }; };
+    // The registers are set so that the skips don't skip
+    const Ops regSetup{0x6000, 0x6101, 0x6203};
+    const Ops dataSetup{uint16_t(0xa000 | MICRO_DATA_ADDRESS), 0x6003};
+
+    return {
+        {"NOP",         {},         same(0x0000)},
+        {"CLS",         {},         same(0x00e0)},
+        {"CALL+RET",    {},         same(0x2000 | MICRO_SUBROUTINE_ADDRESS)},
+        {"JP",          {},         [](uint16_t address){ return Ops{uint16_t(0x1000 | (address + 2))}; }},
+        {"SE_Imm",      regSetup,   same(0x3001)},
+        {"SNE_Imm",     regSetup,   same(0x4000)},
+        {"SE_Reg",      regSetup,   same(0x5010)},
+        {"LD_Imm",      {},         same(0x6012)},
+        {"ADD_Imm",     {},         same(0x7003)},
+        {"LD_Reg",      regSetup,   same(0x8010)},
+        {"OR",          regSetup,   same(0x8011)},
+        {"AND",         regSetup,   same(0x8012)},
+        {"XOR",         regSetup,   same(0x8013)},
+        {"ADD_Reg",     regSetup,   same(0x8014)},
+        {"SUB",         regSetup,   same(0x8015)},
+        {"SHR",         regSetup,   same(0x8016)},
+        {"SUBN",        regSetup,   same(0x8017)},
+        {"SHL",         regSetup,   same(0x801e)},
+        {"SNE_Reg",     regSetup,   same(0x9000)},
+        {"LD_I",        {},         same(0xa123)},
+        {"JP_V0",       regSetup,   [](uint16_t address){ return Ops{uint16_t(0xb000 | (address + 2))}; }},
+        {"RND",         {},         same(0xc0ff)},
+        {"DRW",         {0xa000},   same(0xd015)},
+        {"SKP",         regSetup,   same(0xe09e)},
+        // The key is not pressed, so it always skips the next word
+        {"SKNP",        regSetup,   [](uint16_t){ return Ops{0xe0a1, 0x0000}; }},
+        {"LD_Vx_DT",    {},         same(0xf007)},
+        {"LD_DT_Vx",    {},         same(0xf015)},
+        {"LD_ST_Vx",    {},         same(0xf018)},
+        {"ADD_I",       regSetup,   same(0xf01e)},
+        {"LD_F",        {},         same(0xf029)},
+        {"LD_B",        dataSetup,  same(0xf033)},
+        {"LD_Mem_Vx",   dataSetup,  same(0xf355)},
+        {"LD_Vx_Mem",   dataSetup,  same(0xf365)},
+    };
+}
+
+/*
+ * Builds a program that runs the setup, then the body `MICRO_LOOP_LENGTH` times in an infinite loop.
+ */
+std::vector<uint8_t> buildMicroProgram(const MicroBenchmark& benchmark)
+{
+    std::vector<uint16_t> opcodes = benchmark.setup;
+    const uint16_t loopAddress = 0x200 + opcodes.size() * 2;
+    for (int i{}; i < MICRO_LOOP_LENGTH; ++i)
+    {
+        const std::vector<uint16_t> ops = benchmark.body(0x200 + opcodes.size() * 2);
+        opcodes.insert(opcodes.end(), ops.begin(), ops.end());
+    }
+    opcodes.push_back(0x1000 | loopAddress);
+    assert(0x200 + opcodes.size() * 2 <= MICRO_SUBROUTINE_ADDRESS);
+
+    std::vector<uint8_t> program(MICRO_SUBROUTINE_ADDRESS + 2 - 0x200);
+    for (size_t i{}; i < opcodes.size(); ++i)
+    {
+        program[i * 2] = opcodes[i] >> 8;
+        program[i * 2 + 1] = opcodes[i] & 0xff;
+    }
+    // RET
+    program[MICRO_SUBROUTINE_ADDRESS - 0x200] = 0x00;
+    program[MICRO_SUBROUTINE_ADDRESS - 0x200 + 1] = 0xee;
+    return program;
+}
+
+void benchmarkInstructions(const Options& options)
+{
+    for (const MicroBenchmark& benchmark : getMicroBenchmarks())
+    {
+        const std::vector<uint8_t> program = buildMicroProgram(benchmark);
+        auto prepare = [&](){
+            auto core = createCore(program.data(), program.size(), options);
+            // `I` would leave the data area otherwise
+            core->setCompatIncIAfterRegFillLoad(false);
+            return core;
+        };
+
+        bool hasPanicked{};
+        const double runS = measureBest(options.repeatCount, [&](){
+            auto core = prepare();
+            runCycles(*core, options.cycles);
+            hasPanicked |= core->hasPanicked();
+        });
+        const double stepS = measureBest(options.repeatCount, [&](){
+            auto core = prepare();
+            for (int i{}; i < options.cycles; ++i)
+                core->emulateCycle();
+            hasPanicked |= core->hasPanicked();
+        });
+        if (hasPanicked)
+            std::cerr << "The microbenchmark of " << benchmark.name << " panicked" << std::endl;
+
+        printResult("op", benchmark.name, "run_ns_per_cycle", runS * 1e9 / options.cycles);
+        printResult("op", benchmark.name, "emulatecycle_ns_per_cycle", stepS * 1e9 / options.cycles);
+    }
+}
+
+//------------------------------ Rendering -------------------------------------
+
+void benchmarkRendering(const Options& options)
+{
+    // A fixed pseudo-random picture
+    uint64_t rows[32];
+    uint64_t state = 0x9e3779b97f4a7c15;
+    for (uint64_t& row : rows)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        row = state;
+    }
+    std::vector<uint32_t> pixels(64 * 32);
+
+    // Every row changed, a cleared or scrolled screen
+    // Every fourth row changed, like a few sprites moving
+    const struct { const char* name; uint32_t dirtyRows; } cases[]{
+        {"renderFrameBuffer_full", 0xffffffff},
+        {"renderFrameBuffer_sparse", 0x11111111},
+    };
+    const int frameCount = std::max(1, options.cycles / 100);
+    for (const auto& testCase : cases)
+    {
+        int rowCount{};
+        const double elapsedS = measureBest(options.repeatCount, [&](){
+            rowCount = 0;
+            for (int i{}; i < frameCount; ++i)
+            {
+                // Changes the input, so the calls can't be merged
+                rows[i & 31] ^= i;
+                rowCount += convertDirtyRows(rows, testCase.dirtyRows, pixels.data());
+            }
+        });
+
+        printResult("render", testCase.name, "ns_per_frame", elapsedS * 1e9 / frameCount);
+        printResult("render", testCase.name, "mpix_per_s", (double)rowCount * 64 / elapsedS / 1e6);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+
+    Options options;
+    bool shouldRunRoms = true;
+    bool shouldRunMicro = true;
+    std::vector<std::string> romPaths;
+    bool isUsageWrong{};
+    for (int i{1}; i < argc && !isUsageWrong; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--cycles") == 0 && hasValue)
+            options.cycles = std::stoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue)
+            options.repeatCount = std::stoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--interpret") == 0)
+            options.useInterpreter = true;
+        else if (std::strcmp(argv[i], "--no-roms") == 0)
+            shouldRunRoms = false;
+        else if (std::strcmp(argv[i], "--no-micro") == 0)
+            shouldRunMicro = false;
+        else if (std::strncmp(argv[i], "--", 2) == 0)
+            isUsageWrong = true;
+        else if (!addRomPaths(argv[i], romPaths))
+        {
+            std::cerr << "No such file or directory: " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+    if (isUsageWrong || options.cycles <= 0 || options.repeatCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--cycles <count>] [--repeat <count>] [--interpret]"
+                     " [--no-roms] [--no-micro] [ROM file or directory]..." << std::endl;
+        return 1;
+    }
+    if (shouldRunRoms && romPaths.empty() && !addRomPaths("roms", romPaths))
+    {
+        std::cerr << "No ROMs given and there is no `roms` directory" << std::endl;
+        return 2;
+    }
+
+    std::cout << "kind\tname\tmetric\tvalue\n";
+    printResult("config", "cycles", "value", (uint64_t)options.cycles);
+    printResult("config", "jit", "value", (uint64_t)(!options.useInterpreter && Chip8Core{}.setJitEnabled(true)));
+    std::cout << "config\tframebuffer_kernel\tvalue\t" << Gfx::getExpandKernelName() << '\n';
+
+    if (shouldRunRoms)
+    {
+        for (const std::string& path : romPaths)
+            benchmarkRom(path, options);
+    }
+    if (shouldRunMicro)
+    {
+        benchmarkInstructions(options);
+        benchmarkRendering(options);
+    }
+    std::cout.flush();
+
+    return 0;
+}
@@ -0,0 +1,916 @@
+#include <string>
+#include <cassert>
+#include <ctime>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <array>
+
+#include "chip8core.h"
+#include "async_log.h"
+#include "fontset.h"
+#include "opcode.h"
+#include "rng.h"
+
+namespace
+{
+
+/*
+ * A copy of the memory after loading a program, formatted on the logging thread.
+ */
+struct MemoryDump
+{
+    std::array<uint8_t, 0xfff+1> memory;
+    int romSize{};
+};
+
+std::ostream& operator<<(std::ostream& output, const MemoryDump& dump)
+{
+    output << std::hex << '\n' << "--- START OF MEMORY ---" << '\n';
+    for (int i{}; i < 0xfff + 1; ++i)
+    {
+        output << static_cast<int>(dump.memory[i]) << ' ';
+        if (i == 0x200 - 1)
+            output << '\n' << "--- START OF PROGRAM ---" << '\n';
+        if (i == (dump.romSize + 511))
+            output << '\n' << "--- END OF PROGRAM ---" << '\n';
+        if (i == 0xfff)
+            output << '\n' << "--- END OF MEMORY ---" << '\n';
+    }
+    return output;
+}
+
+/*
+ * The font set, formatted on the logging thread.
+ */
+struct FontSetDump
+{
+};
+
+std::ostream& operator<<(std::ostream& output, const FontSetDump&)
+{
+    output << std::hex << '\n' << "--- FONT SET --- " << '\n';
+    for (int i{}; i < 80; ++i)
+        output << static_cast<int>(fontset[i]) << ' ';
+    output << '\n' << "--- END OF FONT SET ---";
+    return output;
+}
+
+} // namespace
+
+/*
+ * A copy of the state, formatted by `dumpStateToStr()` or on the logging thread after a panic.
+ */
+struct Chip8Core::StateDump
+{
+    bool isDumpingAll{};
+    std::array<uint8_t, 0xfff+1> memory;
+    Framebuffer frameBuffer;
+    uint16_t pc{};
+    uint16_t opcode{};
+    int sp{};
+    uint16_t indexReg{};
+    uint8_t delayTimer{};
+    uint8_t soundTimer{};
+    uint8_t registers[16]{};
+    uint16_t stack[16]{};
+
+    friend std::ostream& operator<<(std::ostream& output, const StateDump& dump)
+    {
+        if (dump.isDumpingAll)
+        {
+            output << "Memory:\n";
+            output << std::hex;
+            for (int i{}; i < 0x1000; ++i)
+            {
+                output << std::setw(2) << std::setfill('0') << +dump.memory[i] << ' ';
+                if (i % 32 == 31)
+                    output << '\n';
+            }
+
+            output << "\nFramebuffer:\n";
+            for (int i{}; i < 64 * 32; ++i)
+            {
+                output << +dump.frameBuffer.get(i) << ' ';
+                if (i % 64 == 63)
+                    output << '\n';
+            }
+            output << '\n';
+        }
+
+        output <<   "PC=" << std::setw(4) << std::setfill('0') << +dump.pc
+               << ", Op=" << std::setw(4) << std::setfill('0') << +dump.opcode
+               << ", SP=" << std::setw(1) << std::setfill('0') << +dump.sp
+               << ", I="  << std::setw(4) << std::setfill('0') << +dump.indexReg
+               << ", DT=" << std::setw(2) << std::setfill('0') << +dump.delayTimer
+               << ", ST=" << std::setw(2) << std::setfill('0') << +dump.soundTimer
+               << '\n';
+        for (int i{}; i < 16; ++i)
+        {
+            output << i << '=' << std::setw(2) << std::setfill('0') << +dump.registers[i];
+            if (i != 15)
+                output << ", ";
+        }
+
+        output << "\n\nStack:\n";
+        for (int i{15}; i > -1; --i)
+        {
+            output << std::setw(4) << std::setfill('0') << dump.stack[i];
+            if (i + 1 == dump.sp)
+                output << " <-"; // Mark the stack pointer
+            output << '\n';
+        }
+        return output;
+    }
+};
+
+Chip8Core::Chip8Core()
+    : m_sp{}
+{
+    setRandomSeed(std::time(nullptr));
+
+    // Load the font set to the memory
+    Chip8Core::loadFontSet();
+}
+
+Chip8Core::~Chip8Core()
+{
+}
+
+bool Chip8Core::setJitEnabled(bool enabled)
+{
+#if CHIP8_HAS_JIT
+    if (!enabled)
+    {
+        m_jit.reset();
+        return true;
+    }
+
+    if (!m_jit)
+    {
+        m_jit = std::make_unique<Chip8Jit>(*this);
+        if (!m_jit->isUsable())
+        {
+            m_jit.reset();
+            return false;
+        }
+    }
+    return true;
+#else
+    return !enabled;
+#endif
+}
+
+bool Chip8Core::setMemoryAccessMap(MemoryAccessMap* map)
+{
+    if (map && !isMemoryAccessTracked)
+        return false;
+
+    m_memoryAccessMap = map;
+    return true;
+}
+
+bool Chip8Core::isJitEnabled() const
+{
+#if CHIP8_HAS_JIT
+    return m_jit != nullptr;
+#else
+    return false;
+#endif
+}
+
+void Chip8Core::setCompatShiftYRegInsteadOfX(bool value)
+{
+    m_compat_shiftYRegInsteadOfX = value;
+
+#if CHIP8_HAS_JIT
+    // The translated shifts depend on it
+    if (m_jit)
+        m_jit->flush();
+#endif
+}
+
+bool Chip8Core::loadRom(const uint8_t* data, size_t size)
+{
+    if (size > MAX_ROM_SIZE)
+    {
+        AsyncLog::error("Program is too large to fit in the memory: ", size, " bytes");
+        return false;
+    }
+
+    std::memcpy(m_memory + 0x200, data, size);
+    invalidateDecodeCache();
+    std::memset(m_writtenMemory, 0, sizeof(m_writtenMemory));
+    m_romSize = size;
+    AsyncLog::info("Copied ", size, " bytes to memory");
+
+    if constexpr (AsyncLog::isEnabled(AsyncLog::Level::Debug))
+    {
+        MemoryDump dump;
+        std::memcpy(dump.memory.data(), m_memory, sizeof(m_memory));
+        dump.romSize = m_romSize;
+        AsyncLog::debug(dump);
+    }
+
+    return true;
+}
+
+void Chip8Core::loadFontSet()
+{
+    AsyncLog::debug(FontSetDump{});
+
+    // copy the font set to the memory
+    for (int i{}; i < 80; ++i)
+    {
+        m_memory[i] = fontset[i];
+    }
+}
+
+void Chip8Core::setRandomSeed(uint64_t seed)
+{
+    m_randomState = Rng::seedToState(seed);
+}
+
+uint8_t Chip8Core::nextRandomByte()
+{
+    return Rng::nextByte(m_randomState);
+}
+
+void Chip8Core::panic(const std::string& message)
+{
+    AsyncLog::error("PANIC: ", message);
+    if constexpr (AsyncLog::isEnabled(AsyncLog::Level::Info))
+    {
+        // Formatted on the logging thread, it is a few kilobytes of text
+        StateDump dump;
+        fillStateDump(dump, true);
+        AsyncLog::info('\n', dump);
+    }
+
+    m_hasPanicked = true;
+    m_panicMessage = message;
+}
+
+void Chip8Core::setKeyState(int key, bool isDown)
+{
+    assert(key >= 0 && key < 16);
+
+    if (isDown && !m_keyStates[key] && isWaitingForKey())
+    {
+        m_registers.set(m_keyWaitRegister, key);
+        m_keyWaitRegister = -1;
+
+        ASYNC_LOG_TRACE("Loaded key: ", key);
+    }
+
+    m_keyStates[key] = isDown;
+}
+
+void Chip8Core::setKeyStates(uint16_t states)
+{
+    for (int i{}; i < 16; ++i)
+        setKeyState(i, (states >> i) & 1);
+}
+
+uint16_t Chip8Core::getKeyStates() const
+{
+    uint16_t states{};
+    for (int i{}; i < 16; ++i)
+        states |= m_keyStates[i] << i;
+    return states;
+}
+
+int Chip8Core::run(int cycles)
+{
+    int executed{};
+    while (executed < cycles)
+    {
+        if (m_hasPanicked)
+            break;
+
+        if (isWaitingForKey())
+        {
+            // Nothing can happen until a key is pressed, just let the time pass
+            advanceTimers(cycles - executed);
+            executed = cycles;
+            break;
+        }
+
+        // The profiler, the memory access map and the trace see the skipped iterations of the loop, too
+        if (const int skipped = isInstrumented() ? 0 : skipDelayTimerWait(cycles - executed))
+        {
+            executed += skipped;
+            continue;
+        }
+
+#if CHIP8_HAS_JIT
+        if (m_jit && !isInstrumented())
+        {
+            const int blockCycles = m_jit->runBlock(cycles - executed);
+            if (blockCycles)
+            {
+                executed += blockCycles;
+                continue;
+            }
+        }
+#endif
+
+        emulateCycle();
+        ++executed;
+    }
+    return executed;
+}
+
+void Chip8Core::fillStateDump(StateDump& dump, bool dumpAll) const
+{
+    dump.isDumpingAll = dumpAll;
+    if (dumpAll)
+    {
+        std::memcpy(dump.memory.data(), m_memory, sizeof(m_memory));
+        dump.frameBuffer = m_frameBuffer;
+    }
+    dump.pc = m_pc;
+    dump.opcode = m_opcode;
+    dump.sp = m_sp;
+    dump.indexReg = m_indexReg;
+    dump.delayTimer = m_delayTimer;
+    dump.soundTimer = m_soundTimer;
+    for (int i{}; i < 16; ++i)
+        dump.registers[i] = m_registers.peek(i);
+    std::memcpy(dump.stack, m_stack, sizeof(m_stack));
+}
+
+std::string Chip8Core::dumpStateToStr(bool dumpAll/*=true*/) const
+{
+    StateDump dump;
+    fillStateDump(dump, dumpAll);
+
+    std::stringstream output;
+    output << dump;
+    return output.str();
+}
+
+void Chip8Core::reset()
+{
+    AsyncLog::info("RESET!");
+
+    m_pc = 0x200;
+    m_sp = 0;
+    m_opcode = 0;
+    m_indexReg = 0;
+    m_delayTimer = 0;
+    m_soundTimer = 0;
+    m_isReadingKey = false;
+    m_keyWaitRegister = -1;
+    m_timerPhase = 0;
+    m_cycleCount = 0;
+    m_hasPanicked = false;
+    m_panicMessage.clear();
+    m_romSize = 0;
+
+    for (int i{}; i < 16; ++i)
+        m_stack[i] = 0;
+
+    for (int i{}; i < 16; ++i)
+        m_registers.set(i, 0, true);
+    m_registers.clearReadWrittenFlags();
+
+    std::memset(m_memory, 0, 0x1000);
+    m_frameBuffer.clear();
+    m_frameBuffer.markAllRowsDirty();
+
+    loadFontSet();
+    invalidateDecodeCache();
+    std::memset(m_writtenMemory, 0, sizeof(m_writtenMemory));
+}
+
+/*
+ * The instruction handlers.
+ * A nested class, so they can access the state of the machine.
+ */
+struct Chip8Core::Ops
+{
+    static void invalid(Chip8Core& c, const DecodedOp&)
+    {
+        c.panic("Invalid opcode.");
+    }
+
+    static void nop(Chip8Core&, const DecodedOp&)
+    {
+    }
+
+    static void cls(Chip8Core& c, const DecodedOp&)
+    {
+        c.m_frameBuffer.clear();
+    }
+
+    static void ret(Chip8Core& c, const DecodedOp&)
+    {
+        // The stack pointer is 4 bits, it wraps around
+        const int top = (c.m_sp - 1) & 0xf;
+        c.m_pc = c.m_stack[top];
+        c.m_stack[top] = 0;
+        --c.m_sp;
+    }
+
+    static void jp(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_pc = op.nnn;
+    }
+
+    static void call(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_stack[c.m_sp] = c.m_pc;
+        ++c.m_sp;
+        c.m_pc = op.nnn;
+    }
+
+    static void seImm(Chip8Core& c, const DecodedOp& op)
+    {
+        if (c.m_registers.get(op.x) == op.nn)
+            c.m_pc += 2;
+    }
+
+    static void sneImm(Chip8Core& c, const DecodedOp& op)
+    {
+        if (c.m_registers.get(op.x) != op.nn)
+            c.m_pc += 2;
+    }
+
+    static void seReg(Chip8Core& c, const DecodedOp& op)
+    {
+        if (c.m_registers.get(op.x) == c.m_registers.get(op.y))
+            c.m_pc += 2;
+    }
+
+    static void ldImm(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, op.nn);
+    }
+
+    static void addImm(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_registers.get(op.x) + op.nn);
+    }
+
+    static void ldReg(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_registers.get(op.y));
+    }
+
+    static void orReg(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_registers.get(op.x) | c.m_registers.get(op.y));
+    }
+
+    static void andReg(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_registers.get(op.x) & c.m_registers.get(op.y));
+    }
+
+    static void xorReg(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_registers.get(op.x) ^ c.m_registers.get(op.y));
+    }
+
+    static void addReg(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_registers.get(op.x) + c.m_registers.get(op.y));
+
+        if (c.m_registers.get(op.y) > (0xff - c.m_registers.get(op.x)))
+            c.m_registers.set(0xf, 1);
+        else
+            c.m_registers.set(0xf, 0);
+    }
+
+    static void sub(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(0xf, !(c.m_registers.get(op.x) < c.m_registers.get(op.y)));
+
+        c.m_registers.set(op.x, c.m_registers.get(op.x) - c.m_registers.get(op.y));
+    }
+
+    static void shr(Chip8Core& c, const DecodedOp& op)
+    {
+        // Mark whether overflow occurs.
+        c.m_registers.set(0xf, c.m_registers.get(op.x) & 1);
+
+        if (c.m_compat_shiftYRegInsteadOfX)
+            c.m_registers.set(op.x, c.m_registers.get(op.y) >> 1);
+        else
+            c.m_registers.set(op.x, c.m_registers.get(op.x) >> 1);
+    }
+
+    static void subn(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(0xf, !(c.m_registers.get(op.x) > c.m_registers.get(op.y)));
+
+        c.m_registers.set(op.x, c.m_registers.get(op.y) - c.m_registers.get(op.x));
+    }
+
+    static void shl(Chip8Core& c, const DecodedOp& op)
+    {
+        // Mark whether overflow occurs.
+        c.m_registers.set(0xf, (c.m_registers.get(op.x) >> 7));
+
+        if (c.m_compat_shiftYRegInsteadOfX)
+            c.m_registers.set(op.x, c.m_registers.get(op.y) << 1);
+        else
+            c.m_registers.set(op.x, c.m_registers.get(op.x) << 1);
+    }
+
+    static void sneReg(Chip8Core& c, const DecodedOp& op)
+    {
+        if (c.m_registers.get(op.x) != c.m_registers.get(op.y))
+            c.m_pc += 2;
+    }
+
+    static void ldI(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_indexReg = op.nnn;
+    }
+
+    static void jpV0(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_pc = c.m_registers.get(0) + op.nnn;
+    }
+
+    static void rnd(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, op.nn & c.nextRandomByte());
+    }
+
+    static void drw(Chip8Core& c, const DecodedOp& op)
+    {
+        // Sprite coordinates are wrapped
+        const int spritex = c.m_registers.get(op.x) % 64;
+        const int spritey = c.m_registers.get(op.y) % 32;
+
+        const int height = op.n;
+
+        if (c.m_indexReg + height >= 0xfff)
+        {
+            c.panic("Invalid sprite address/height");
+            return;
+        }
+
+        c.recordMemoryAccess(MemoryAccess::Read, c.m_indexReg, height);
+
+        // Note: Sprite pixels past the right edge are clipped, the rows are wrapped vertically
+        bool isCollision{};
+        for (int cy{}; cy < height; ++cy)
+            isCollision |= c.m_frameBuffer.xorSpriteRow(spritex, (spritey + cy) % 32, c.m_memory[c.m_indexReg + cy]);
+        c.m_registers.set(0xf, isCollision);
+    }
+
+    static void skp(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_isReadingKey = true;
+
+        ASYNC_LOG_TRACE("KEY: ", c.m_keyStates[c.m_registers.peek(op.x) & 0xf]);
+
+        if (c.m_keyStates[c.m_registers.get(op.x) & 0xf])
+            c.m_pc += 2;
+    }
+
+    static void sknp(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_isReadingKey = true;
+
+        ASYNC_LOG_TRACE("KEY: ", c.m_keyStates[c.m_registers.peek(op.x) & 0xf]);
+
+        if (!c.m_keyStates[c.m_registers.get(op.x) & 0xf])
+            c.m_pc += 2;
+    }
+
+    static void ldVxDT(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_registers.set(op.x, c.m_delayTimer);
+    }
+
+    static void ldVxK(Chip8Core& c, const DecodedOp& op)
+    {
+        // The register is loaded by `setKeyState()` when a key gets pressed
+        c.m_keyWaitRegister = op.x;
+    }
+
+    static void ldDTVx(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_delayTimer = c.m_registers.get(op.x);
+    }
+
+    static void ldSTVx(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_soundTimer = c.m_registers.get(op.x);
+    }
+
+    static void addI(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_indexReg += c.m_registers.get(op.x);
+    }
+
+    static void ldF(Chip8Core& c, const DecodedOp& op)
+    {
+        c.m_indexReg = c.m_registers.get(op.x) * 5;
+        ASYNC_LOG_TRACE("FONT LOADED: ", +c.m_registers.peek(op.x));
+    }
+
+    static void ldB(Chip8Core& c, const DecodedOp& op)
+    {
+        const uint8_t number{c.m_registers.get(op.x)};
+        c.writeMemory(c.m_indexReg, number / 100);
+        c.writeMemory(c.m_indexReg+1, (number / 10) % 10);
+        c.writeMemory(c.m_indexReg+2, number % 10);
+    }
+
+    static void ldMemVx(Chip8Core& c, const DecodedOp& op)
+    {
+        for (uint8_t i{}; i <= op.x; ++i)
+            c.writeMemory(c.m_indexReg + i, c.m_registers.get(i));
+
+        if (c.m_compat_incIAfterRegFillLoad)
+            c.m_indexReg += (op.x + 1);
+    }
+
+    static void ldVxMem(Chip8Core& c, const DecodedOp& op)
+    {
+        c.recordMemoryAccess(MemoryAccess::Read, c.m_indexReg, op.x + 1);
+        for (uint8_t i{}; i <= op.x; ++i)
+            c.m_registers.set(i, c.m_memory[(c.m_indexReg + i) & 0xfff]);
+
+        if (c.m_compat_incIAfterRegFillLoad)
+            c.m_indexReg += (op.x + 1);
+    }
+
+    // Indexed by `OpClass`
+    static const OpHandler handlers[];
+};
+
+
+const OpHandler Chip8Core::Ops::handlers[]{
+    invalid,
+    nop,
+    cls,
+    ret,
+    jp,
+    call,
+    seImm,
+    sneImm,
+    seReg,
+    ldImm,
+    addImm,
+    ldReg,
+    orReg,
+    andReg,
+    xorReg,
+    addReg,
+    sub,
+    shr,
+    subn,
+    shl,
+    sneReg,
+    ldI,
+    jpV0,
+    rnd,
+    drw,
+    skp,
+    sknp,
+    ldVxDT,
+    ldVxK,
+    ldDTVx,
+    ldSTVx,
+    addI,
+    ldF,
+    ldB,
+    ldMemVx,
+    ldVxMem,
+};
+
+void Chip8Core::writeMemory(int address, uint8_t value)
+{
+    address &= 0xfff;
+    m_memory[address] = value;
+    recordMemoryAccess(MemoryAccess::Write, address, 1);
+
+    // The byte is part of the opcode starting here and the one starting before it
+    m_decodeCache[address].handler = nullptr;
+    m_decodeCache[(address - 1) & 0xfff].handler = nullptr;
+    m_writtenMemory[address / 64] |= uint64_t(1) << (address % 64);
+
+#if CHIP8_HAS_JIT
+    if (m_jit)
+        m_jit->invalidate(address);
+#endif
+}
+
+void Chip8Core::invalidateDecodeCache()
+{
+    for (auto& entry : m_decodeCache)
+        entry.handler = nullptr;
+
+#if CHIP8_HAS_JIT
+    if (m_jit)
+        m_jit->flush();
+#endif
+}
+
+bool Chip8Core::isMemoryWritten(int from, int to) const
+{
+    assert(from >= 0 && from <= to && to <= 0xfff);
+
+    for (int word{from / 64}; word <= to / 64; ++word)
+    {
+        uint64_t mask = ~uint64_t(0);
+        if (word == from / 64)
+            mask &= ~uint64_t(0) << (from % 64);
+        if (word == to / 64)
+            mask &= ~uint64_t(0) >> (63 - to % 64);
+
+        if (m_writtenMemory[word] & mask)
+            return true;
+    }
+    return false;
+}
+
+void Chip8Core::tickTimers(int ticks)
+{
+    m_delayTimer = m_delayTimer > ticks ? m_delayTimer - ticks : 0;
+    m_soundTimer = m_soundTimer > ticks ? m_soundTimer - ticks : 0;
+}
+
+void Chip8Core::advanceTimers(int cycles)
+{
+    // Every elapsed cycle goes through here
+    m_cycleCount += cycles;
+
+    m_timerPhase += (uint64_t)cycles * TIMER_FREQUENCY;
+    if (m_timerPhase < (uint64_t)m_instructionsPerSecond)
+        return;
+
+    const uint64_t ticks = m_timerPhase / m_instructionsPerSecond;
+    m_timerPhase %= m_instructionsPerSecond;
+    // The timers are 8-bit, so more ticks don't matter
+    tickTimers(std::min<uint64_t>(ticks, 0xff));
+}
+
+int Chip8Core::getCyclesUntilTimerTick() const
+{
+    // Round up
+    return (m_instructionsPerSecond - m_timerPhase + TIMER_FREQUENCY - 1) / TIMER_FREQUENCY;
+}
+
+int Chip8Core::skipDelayTimerWait(int maxCycles)
+{
+    // Looking for:
+    //   LD Vx, DT
+    //   SE Vx, kk (or SNE)
+    //   JP <the LD>
+    if (m_pc > 0xffa)
+        return 0;
+    const uint8_t* code = m_memory + m_pc;
+
+    if ((code[0] >> 4) != 0xf || code[1] != 0x07)
+        return 0;
+    const int regX = code[0] & 0xf;
+
+    const int skipOp = code[2] >> 4;
+    if ((skipOp != 0x3 && skipOp != 0x4) || (code[2] & 0xf) != regX)
+        return 0;
+
+    const uint16_t jumpOpcode = (code[4] << 8) | code[5];
+    if (jumpOpcode != (0x1000 | m_pc))
+        return 0;
+
+    // Would this iteration leave the loop?
+    const bool isEqual = m_delayTimer == code[3];
+    if (skipOp == 0x3 ? isEqual : !isEqual)
+        return 0;
+
+    // The outcome can only change when the delay timer is decremented
+    const int cycleLimit = m_delayTimer ? std::min(getCyclesUntilTimerTick() - 1, maxCycles) : maxCycles;
+    const int skippedCycles = cycleLimit / 3 * 3;
+    if (!skippedCycles)
+        return 0;
+
+    // Leave the machine in the same state as the last iteration would
+    m_registers.set(regX, m_delayTimer);
+    m_opcode = jumpOpcode;
+    advanceTimers(skippedCycles);
+    return skippedCycles;
+}
+
+const DecodedOp* Chip8Core::fetchOpcode()
+{
+    // Catch the access out of the valid memory address range (0x00 - 0xfff)
+    if (m_pc > 0xffe)
+    {
+        panic("PC out of range");
+        return nullptr;
+    }
+
+    static_assert(sizeof(Ops::handlers) / sizeof(Ops::handlers[0]) == (size_t)OpClass::Count,
+            "Every instruction class needs a handler");
+
+    recordMemoryAccess(MemoryAccess::Execute, m_pc, 2);
+
+    DecodedOp& op = m_decodeCache[m_pc];
+    if (!op.handler)
+    {
+        // We swap the upper and lower bits.
+        // The opcode is 16 bits long, so we have to
+        // shift the left part of the opcode and add the right part.
+        op = decodeOpcode((m_memory[m_pc] << 8) | m_memory[m_pc + 1]);
+        op.handler = Ops::handlers[(int)op.opClass];
+    }
+    m_opcode = op.opcode;
+
+    ASYNC_LOG_TRACE(std::hex, "PC: 0x", m_pc);
+    ASYNC_LOG_TRACE(std::hex, "Current opcode: 0x", m_opcode);
+
+    m_pc += 2;
+    return &op;
+}
+
+void Chip8Core::executeProfiled(const DecodedOp& op)
+{
+    // The PC is already stepped
+    const uint16_t address = m_pc - 2;
+    m_profiler->recordInstruction(address, op.opClass);
+
+    if (m_profiler->shouldSample())
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        op.handler(*this, op);
+        const auto elapsed = std::chrono::steady_clock::now() - startTime;
+        m_profiler->recordSample(op.opClass, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    else
+    {
+        op.handler(*this, op);
+    }
+
+    if (op.opClass == OpClass::JP || op.opClass == OpClass::JP_V0)
+        m_profiler->recordJump(address, m_pc);
+}
+
+void Chip8Core::executeTraced(const DecodedOp& op)
+{
+    // The PC is already stepped
+    TraceRecord record;
+    record.cycle = m_cycleCount;
+    record.pc = m_pc - 2;
+    record.opcode = op.opcode;
+
+    uint8_t registersBefore[16];
+    std::memcpy(registersBefore, m_registers.getData(), sizeof(registersBefore));
+
+    if (m_profiler)
+        executeProfiled(op);
+    else
+        op.handler(*this, op);
+
+    record.indexReg = m_indexReg;
+    const uint8_t* registers = m_registers.getData();
+    for (int i{}; i < 16; ++i)
+    {
+        if (registers[i] == registersBefore[i])
+            continue;
+
+        if (record.changedRegister == TraceRecord::NO_REGISTER)
+        {
+            record.changedRegister = i;
+            record.value = registers[i];
+        }
+        else if (i == 0xf)
+        {
+            record.changedRegister |= TraceRecord::VF_CHANGED_TOO;
+        }
+    }
+    m_traceBuffer->record(record);
+}
+
+void Chip8Core::emulateCycle()
+{
+    if (m_hasPanicked || isWaitingForKey())
+        return;
+
+    const DecodedOp* op = fetchOpcode();
+    if (!op)
+        return;
+
+    ASYNC_LOG_TRACE(getOpClassName(op->opClass));
+
+    if (m_traceBuffer)
+        executeTraced(*op);
+    else if (m_profiler)
+        executeProfiled(*op);
+    else
+        op->handler(*this, *op);
+
+    if (m_hasPanicked)
+        return;
+
+    advanceTimers(1);
+}
@@ -0,0 +1,573 @@
+#ifndef CHIP8CORE_H
+#define CHIP8CORE_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <cassert>
+#include <cstring>
+#include <memory>
+
+#include "config.h"
+#include "opcode.h"
+#include "jit.h"
+#include "profiler.h"
+#include "memory_access_map.h"
+#include "trace.h"
+#include "async_log.h"
+
+/*
+ * The V0-VF registers.
+ *
+ * If `CHIP8_TRACK_REGISTER_ACCESS` is defined, the reads and writes are recorded
+ * for the debugger, otherwise the tracking is compiled out.
+ */
+class Registers final
+{
+public:
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+    static constexpr bool isAccessTracked = true;
+#else
+    static constexpr bool isAccessTracked = false;
+#endif
+
+private:
+    uint8_t m_registers[16]{};
+
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+    bool m_isRegisterWritten[16]{};
+    bool m_isRegisterRead[16]{};
+#endif
+
+public:
+    uint8_t get(int index, bool isInternal=false)
+    {
+        assert(index >= 0);
+        assert(index < 16);
+
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+        if (!isInternal)
+            m_isRegisterRead[index] = true;
+#else
+        (void)isInternal;
+#endif
+
+        return m_registers[index];
+    }
+
+    /*
+     * Reads a register without marking it as read.
+     */
+    uint8_t peek(int index) const
+    {
+        assert(index >= 0);
+        assert(index < 16);
+
+        return m_registers[index];
+    }
+
+    void set(int index, uint8_t value, bool isInternal=false)
+    {
+        assert(index >= 0);
+        assert(index < 16);
+
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+        if (!isInternal)
+            m_isRegisterWritten[index] = true;
+#else
+        (void)isInternal;
+#endif
+
+        m_registers[index] = value;
+    }
+
+    inline uint8_t* getData() { return m_registers; }
+
+    void clearReadWrittenFlags()
+    {
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+        // Clear m_isRegisterWritten
+        memset(m_isRegisterWritten, false, sizeof(m_isRegisterWritten));
+        // Clear m_isRegisterRead
+        memset(m_isRegisterRead, false, sizeof(m_isRegisterRead));
+#endif
+    }
+
+    /*
+     * Always false if the access is not tracked.
+     */
+    inline bool getIsRegisterWritten(int index) const
+    {
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+        return m_isRegisterWritten[index];
+#else
+        (void)index;
+        return false;
+#endif
+    }
+
+    /*
+     * Always false if the access is not tracked.
+     */
+    inline bool getIsRegisterRead(int index) const
+    {
+#ifdef CHIP8_TRACK_REGISTER_ACCESS
+        return m_isRegisterRead[index];
+#else
+        (void)index;
+        return false;
+#endif
+    }
+};
+
+class Framebuffer final
+{
+public:
+    // Every row is stored as a bitmap, the leftmost pixel is the most significant bit
+    uint64_t m_rows[32]{};
+    // Bit N is set if row N has changed since the last `clearDirtyRows()`
+    uint32_t m_dirtyRows = 0xffffffff;
+
+    Framebuffer()
+    {
+    }
+
+    void set(int x, int y, int val)
+    {
+        assert(x >= 0 && x < 64);
+        assert(y >= 0 && y < 32);
+        const uint64_t mask = 1ull << (63 - x);
+        const uint64_t row = val ? (m_rows[y] | mask) : (m_rows[y] & ~mask);
+        if (row != m_rows[y])
+            m_dirtyRows |= 1u << y;
+        m_rows[y] = row;
+    }
+
+    int get(int x, int y) const
+    {
+        assert(x >= 0 && x < 64);
+        assert(y >= 0 && y < 32);
+        return (m_rows[y] >> (63 - x)) & 1;
+    }
+
+    int get(int index) const
+    {
+        assert(index >= 0 && index < 64*32);
+        return get(index % 64, index / 64);
+    }
+
+    inline uint64_t getRow(int y) const
+    {
+        assert(y >= 0 && y < 32);
+        return m_rows[y];
+    }
+
+    /*
+     * XORs a row of a sprite (8 pixels) onto row `y`, starting at column `x`.
+     * The pixels past the right edge are clipped.
+     * Returns true if a lit pixel was turned off.
+     */
+    inline bool xorSpriteRow(int x, int y, uint8_t spriteRow)
+    {
+        assert(x >= 0 && x < 64);
+        assert(y >= 0 && y < 32);
+        // The pixels past column 63 are shifted out
+        const uint64_t bits = (uint64_t(spriteRow) << 56) >> x;
+        const bool isCollision = m_rows[y] & bits;
+        m_rows[y] ^= bits;
+        if (bits)
+            m_dirtyRows |= 1u << y;
+        return isCollision;
+    }
+
+    void clear()
+    {
+        for (int y{}; y < 32; ++y)
+        {
+            if (m_rows[y])
+                m_dirtyRows |= 1u << y;
+        }
+        std::memset(m_rows, 0, sizeof(m_rows));
+    }
+
+    /*
+     * FNV-1a hash of the pixels, identifies the picture in the outputs of the headless tools.
+     */
+    uint32_t getHash() const
+    {
+        uint32_t hash = 2166136261;
+        for (uint64_t row : m_rows)
+        {
+            for (int i{}; i < 8; ++i)
+                hash = (hash ^ uint8_t(row >> (i * 8))) * 16777619;
+        }
+        return hash;
+    }
+
+    inline uint32_t getDirtyRows() const { return m_dirtyRows; }
+    inline void clearDirtyRows() { m_dirtyRows = 0; }
+    inline void markAllRowsDirty() { m_dirtyRows = 0xffffffff; }
+
+    void print()
+    {
+        std::string output = "--- frame buffer ---\n";
+        for (int i{}; i < 64 * 32; ++i)
+        {
+            output += char('0' + get(i));
+            if ((i + 1) % 64 == 0)
+                output += '\n';
+        }
+        output += "--------------------";
+        AsyncLog::info(output);
+    }
+};
+
+/*
+ * The emulated machine: memory, registers, stack, framebuffer and timers.
+ *
+ * It doesn't use SDL, so it can be created and run without a display
+ * or an audio device. Input is fed in with `setKeyState()`, output is read
+ * from `getFrameBuffer()`.
+ */
+class Chip8Core final
+{
+private:
+    // stack
+    uint16_t m_stack[16]{};
+    // stack pointer (4 bits)
+    uint8_t m_sp: 4; // It will be init-ed in ctor
+    // registers
+    Registers m_registers;
+    // memory - 0x00 - 0xfff
+    uint8_t m_memory[0xfff+1]{};
+    // program counter - the programs start at 0x200
+    uint16_t m_pc = 0x200;
+    // current opcode
+    uint16_t m_opcode = 0;
+    // index register
+    uint16_t m_indexReg = 0;
+    // delay timer
+    uint8_t m_delayTimer = 0;
+    // sound timer
+    uint8_t m_soundTimer = 0;
+    // framebuffer - stores which pixels are turned on
+    // We don't fill it with zeros, because the original implementation doesn't do so
+    Framebuffer m_frameBuffer;
+
+    // The decoded instruction for every address of the memory.
+    // An entry is invalidated when the memory under it is written.
+    DecodedOp m_decodeCache[0xfff+1]{};
+    // One bit for every byte of the memory, set when an instruction writes it
+    uint64_t m_writtenMemory[(0xfff+1) / 64]{};
+
+#if CHIP8_HAS_JIT
+    // nullptr if the JIT is disabled
+    std::unique_ptr<Chip8Jit> m_jit;
+#endif
+
+    // rom size in bytes
+    int m_romSize{};
+
+    // Which keys of the keypad are held down
+    bool m_keyStates[16]{};
+    // The register `Fx0A` loads the next pressed key into, -1 if not waiting for a key
+    int m_keyWaitRegister = -1;
+    bool m_isReadingKey{};
+
+    // How many instructions the machine executes in a second of emulated time
+    int m_instructionsPerSecond = INSTRUCTIONS_PER_SECOND;
+    // Increased by the timer frequency every cycle, the timers are decremented
+    // every time it reaches `m_instructionsPerSecond`, so they run at exactly 60 Hz
+    uint64_t m_timerPhase{};
+    // How many cycles elapsed since the reset
+    uint64_t m_cycleCount{};
+
+    // The state of the xorshift64* generator used by `Cxkk`, never 0
+    uint64_t m_randomState = 1;
+
+    bool m_hasPanicked{};
+    std::string m_panicMessage;
+
+    // Not owned, nullptr if not profiling
+    Profiler* m_profiler{};
+    // Not owned, nullptr if the memory accesses are not recorded
+    MemoryAccessMap* m_memoryAccessMap{};
+    // Not owned, nullptr if not tracing
+    TraceBuffer* m_traceBuffer{};
+
+    /*
+     * The `8xy6` opcode is right-shift, the `8xyE` is left-shift.
+     * Register 0xF is set to the shifted-out bit of register X.
+     *
+     * If this is true,
+     *      register X is set to register Y shifted,
+     * if false,
+     *      register X is set to register X shifted.
+     *
+     * The old implementations used the Y register.
+     */
+    bool m_compat_shiftYRegInsteadOfX = true;
+
+    /*
+     * The `Fx55` and `Fx66` opcodes loop through the registers and write them to / read from the memory.
+     * This variable marks if the index register needs to be incremented while doing the operations.
+     * In the original implementation this does happen.
+     */
+    bool m_compat_incIAfterRegFillLoad = true;
+
+
+    struct Ops;
+    friend class Chip8Jit;
+    friend struct Chip8RecompilerAccess;
+
+    void loadFontSet();
+
+    /*
+     * Returns the next byte of the random number generator.
+     */
+    uint8_t nextRandomByte();
+
+    /*
+     * Returns the decoded instruction at the PC and steps the PC.
+     * Returns nullptr if the PC is out of range.
+     */
+    const DecodedOp* fetchOpcode();
+
+    /*
+     * All the writes to the memory made by the instructions go through this,
+     * so the decoded instructions under it are thrown away.
+     */
+    void writeMemory(int address, uint8_t value);
+    void invalidateDecodeCache();
+
+    enum class MemoryAccess
+    {
+        Read,
+        Write,
+        Execute,
+    };
+    /*
+     * Records an access of `count` bytes in the memory access map, if there is one.
+     * Compiled out if `CHIP8_TRACK_MEMORY_ACCESS` is not defined.
+     */
+    inline void recordMemoryAccess(MemoryAccess access, int address, int count)
+    {
+#ifdef CHIP8_TRACK_MEMORY_ACCESS
+        if (!m_memoryAccessMap)
+            return;
+        switch (access)
+        {
+        case MemoryAccess::Read:    m_memoryAccessMap->markRead(address, count); break;
+        case MemoryAccess::Write:   m_memoryAccessMap->markWritten(address, count); break;
+        case MemoryAccess::Execute: m_memoryAccessMap->markExecuted(address, count); break;
+        }
+#else
+        (void)access;
+        (void)address;
+        (void)count;
+#endif
+    }
+
+    /*
+     * Whether every instruction has to be executed by the interpreter, one by one,
+     * because something watches them.
+     */
+    inline bool isInstrumented() const { return m_profiler || m_memoryAccessMap || m_traceBuffer; }
+
+    /*
+     * Executes an instruction fetched by `fetchOpcode()` and records it in the profiler.
+     */
+    void executeProfiled(const DecodedOp& op);
+    /*
+     * Executes an instruction fetched by `fetchOpcode()` and records it in the trace buffer.
+     */
+    void executeTraced(const DecodedOp& op);
+
+    /*
+     * Lets the time of `cycles` instructions pass for the timers.
+     */
+    void advanceTimers(int cycles);
+    void tickTimers(int ticks);
+    // How many cycles are needed for the next timer tick (at least 1)
+    int getCyclesUntilTimerTick() const;
+
+    /*
+     * If the PC is at a loop waiting for the delay timer, skips the iterations that can't
+     * change the outcome (the ones before the next timer tick), but at most `maxCycles` cycles.
+     * Returns the number of skipped cycles.
+     */
+    int skipDelayTimerWait(int maxCycles);
+
+    // A copy of the state for `dumpStateToStr()`, it can be formatted on the logging thread
+    struct StateDump;
+    void fillStateDump(StateDump& dump, bool dumpAll) const;
+
+    /*
+     * Should be called when a serious error happens.
+     * Stops the machine, the message can be queried with `getPanicMessage()`.
+     */
+    void panic(const std::string& message);
+
+public:
+    // The delay and sound timers are decremented at this rate
+    static constexpr int TIMER_FREQUENCY = 60;
+    // The size of the states written by `saveState()`
+    static constexpr size_t SAVE_STATE_SIZE = 4961;
+    // The largest program that fits in the memory after 0x200
+    static constexpr size_t MAX_ROM_SIZE = 0x1000 - 0x200;
+
+    Chip8Core();
+    ~Chip8Core();
+
+    /*
+     * Resets the machine to the power-on state.
+     * The memory is cleared, so the ROM needs to be loaded again.
+     */
+    void reset();
+
+    /*
+     * Copies a program to the memory starting at 0x200.
+     * Returns false if it doesn't fit in the memory (larger than `MAX_ROM_SIZE`).
+     */
+    bool loadRom(const uint8_t* data, size_t size);
+
+    /*
+     * Writes the state of the machine to `dest`, which has to be `SAVE_STATE_SIZE` bytes long.
+     * The state is versioned binary data, see savestate.cpp.
+     */
+    void saveState(uint8_t* dest) const;
+
+    /*
+     * Restores a state written by `saveState()`.
+     * Returns false and leaves the machine untouched if `data` is not a valid state.
+     */
+    bool loadState(const uint8_t* data, size_t size);
+
+    /*
+     * Seeds the random number generator used by `Cxkk`.
+     * The same seed produces the same numbers.
+     */
+    void setRandomSeed(uint64_t seed);
+
+    /*
+     * Executes one instruction.
+     * Does nothing if the machine has panicked or waits for a keypress.
+     */
+    void emulateCycle();
+
+    /*
+     * Runs the machine for `cycles` instruction cycles.
+     * While waiting for a keypress, the rest of the cycles pass without executing
+     * anything (the timers keep running). Stops early if the machine panics.
+     * Returns the number of elapsed cycles.
+     */
+    int run(int cycles);
+
+    /*
+     * Enables or disables the x86-64 JIT, used by `run()`.
+     * Returns false if the JIT is not available.
+     */
+    bool setJitEnabled(bool enabled);
+    bool isJitEnabled() const;
+
+    /*
+     * Records every executed instruction in `profiler`, nullptr stops profiling.
+     * While profiling, `run()` executes every instruction one by one, without the JIT.
+     */
+    inline void setProfiler(Profiler* profiler) { m_profiler = profiler; }
+    inline Profiler* getProfiler() const { return m_profiler; }
+
+#ifdef CHIP8_TRACK_MEMORY_ACCESS
+    static constexpr bool isMemoryAccessTracked = true;
+#else
+    static constexpr bool isMemoryAccessTracked = false;
+#endif
+    /*
+     * Records the memory reads, writes and executed bytes in `map`, nullptr stops recording.
+     * While recording, `run()` executes every instruction one by one, without the JIT.
+     * Returns false if the recording is compiled out (`CHIP8_TRACK_MEMORY_ACCESS` is not defined).
+     */
+    bool setMemoryAccessMap(MemoryAccessMap* map);
+    inline MemoryAccessMap* getMemoryAccessMap() const { return m_memoryAccessMap; }
+
+    /*
+     * Records every executed instruction in `buffer`, nullptr stops tracing.
+     * While tracing, `run()` executes every instruction one by one, without the JIT.
+     */
+    inline void setTraceBuffer(TraceBuffer* buffer) { m_traceBuffer = buffer; }
+    inline TraceBuffer* getTraceBuffer() const { return m_traceBuffer; }
+
+    /*
+     * Sets how many instructions are executed in a second of emulated time.
+     * The timers are decremented at 60 Hz of emulated time.
+     */
+    inline void setInstructionsPerSecond(int value) { assert(value > 0); m_instructionsPerSecond = value; m_timerPhase = 0; }
+    inline int getInstructionsPerSecond() const { return m_instructionsPerSecond; }
+
+    /*
+     * Marks a key of the keypad as pressed or released.
+     * If `Fx0A` is waiting for a key, a press finishes the wait.
+     */
+    void setKeyState(int key, bool isDown);
+    /*
+     * Sets the state of every key, bit N is key N.
+     * The keys are set in order, so if `Fx0A` is waiting, the lowest pressed key finishes the wait.
+     */
+    void setKeyStates(uint16_t states);
+    uint16_t getKeyStates() const;
+    inline bool isWaitingForKey() const { return m_keyWaitRegister != -1; }
+
+    inline bool hasPanicked() const { return m_hasPanicked; }
+    inline const std::string& getPanicMessage() const { return m_panicMessage; }
+
+    /*
+     * The rows of the framebuffer changed since the last `clearDirtyRows()`,
+     * bit N is set if row N changed.
+     */
+    inline uint32_t getDirtyRows() const { return m_frameBuffer.getDirtyRows(); }
+    inline void clearDirtyRows() { m_frameBuffer.clearDirtyRows(); }
+    inline void markAllRowsDirty() { m_frameBuffer.markAllRowsDirty(); }
+    // Whether the framebuffer needs to be redrawn
+    inline bool getRenderFlag() const { return getDirtyRows(); }
+
+    inline const Framebuffer& getFrameBuffer() const { return m_frameBuffer; }
+    inline const Registers& getRegisters() const { return m_registers; }
+    inline const uint8_t* getMemory() const { return m_memory; }
+    inline uint16_t getStackElement(int index) const { assert(index >= 0 && index < 16); return m_stack[index]; }
+    inline uint8_t getSP() const { return m_sp; }
+    inline uint16_t getPC() const { return m_pc; }
+    inline uint16_t getOpcode() const { return m_opcode; }
+    inline uint16_t getIndexReg() const { return m_indexReg; }
+    inline uint8_t getDelayTimer() const { return m_delayTimer; }
+    inline uint8_t getSoundTimer() const { return m_soundTimer; }
+    inline int getRomSize() const { return m_romSize; }
+    /*
+     * The number of elapsed instruction cycles since the reset, including the ones spent waiting.
+     * Saved in the save states, so it identifies a point of a run.
+     */
+    inline uint64_t getCycleCount() const { return m_cycleCount; }
+
+    /*
+     * Returns true if an instruction wrote any byte in the range [from, to]
+     * since the ROM was loaded.
+     */
+    bool isMemoryWritten(int from, int to) const;
+
+    inline void clearLastRegisterOperationFlags() { m_registers.clearReadWrittenFlags(); }
+    inline void clearIsReadingKeyStateFlag() { m_isReadingKey = false; }
+    inline bool isReadingKey() const { return m_isReadingKey; }
+
+    void setCompatShiftYRegInsteadOfX(bool value);
+    inline void setCompatIncIAfterRegFillLoad(bool value) { m_compat_incIAfterRegFillLoad = value; }
+    inline void toggleCompatShiftYRegInsteadOfX() { setCompatShiftYRegInsteadOfX(!m_compat_shiftYRegInsteadOfX); }
+    inline void toggleCompatIncIAfterRegFillLoad() { setCompatIncIAfterRegFillLoad(!m_compat_incIAfterRegFillLoad); }
+    inline bool getCompatShiftYRegInsteadOfX() const { return m_compat_shiftYRegInsteadOfX; }
+    inline bool getCompatIncIAfterRegFillLoad() const { return m_compat_incIAfterRegFillLoad; }
+
+    /*
+     * If `dumpAll` is true, the memory and the screenbuffer are dumped, too.
+     */
+    std::string dumpStateToStr(bool dumpAll=true) const;
+};
+
+#endif // CHIP8CORE_H
@@ -0,0 +1,193 @@
+/*
+ * Validator and benchmark of the lockstep engine.
+ *
+ * Usage: chip8lockstep <rom file> [--lanes <count>] [--cycles <count>] [--same-input] [--scalar]
+ *
+ * Runs the ROM on the lanes of a `LockstepEngine` and on the same number of `Chip8Core`s
+ * stepped with `emulateCycle()`. Every lane gets its own random seed and key presses,
+ * or with `--same-input` the same key presses, so the lanes only diverge because of the random numbers.
+ * The states are compared regularly, the first difference is printed.
+ * With `--scalar` the engine doesn't use the AVX2 kernel.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <memory>
+#include <chrono>
+#include <cstring>
+
+#include "chip8core.h"
+#include "lockstep_engine.h"
+#include "to_hex.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+// The keys of the lanes are changed, then the states are compared, after this many cycles
+#define INPUT_PERIOD_CYCLES 1000
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * The keys held down by a lane in a period, a few random ones.
+ */
+static uint16_t getLaneKeys(int lane, int period)
+{
+    uint32_t hash = (lane * 0x9e3779b1u) ^ (period * 0x85ebca6bu);
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6d;
+    hash ^= hash >> 12;
+    return hash & (hash >> 16);
+}
+
+/*
+ * Returns the name of the first differing value, an empty string if the lane is the same as the core.
+ */
+static std::string compareLane(const LockstepEngine& engine, int lane, const Chip8Core& core)
+{
+    if (engine.hasPanicked(lane) != core.hasPanicked())
+        return "panic state";
+    if (engine.getPC(lane) != core.getPC())
+        return "PC";
+    if (engine.getOpcode(lane) != core.getOpcode())
+        return "opcode";
+    if (engine.getIndexReg(lane) != core.getIndexReg())
+        return "I";
+    if (engine.getSP(lane) != core.getSP())
+        return "SP";
+    if (engine.getDelayTimer(lane) != core.getDelayTimer())
+        return "DT";
+    if (engine.getSoundTimer(lane) != core.getSoundTimer())
+        return "ST";
+    if (engine.getCycleCount(lane) != core.getCycleCount())
+        return "cycle count";
+    if (engine.isWaitingForKey(lane) != core.isWaitingForKey())
+        return "key wait";
+    for (int i{}; i < 16; ++i)
+    {
+        if (engine.getRegister(lane, i) != core.getRegisters().peek(i))
+            return "V" + to_hex(i, 1, false);
+        if (engine.getStackElement(lane, i) != core.getStackElement(i))
+            return "stack";
+    }
+    for (int y{}; y < 32; ++y)
+    {
+        if (engine.getFrameBufferRow(lane, y) != core.getFrameBuffer().getRow(y))
+            return "framebuffer row " + std::to_string(y);
+    }
+    if (std::memcmp(engine.getMemory(lane), core.getMemory(), 0x1000) != 0)
+        return "memory";
+    return "";
+}
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+
+    std::string romPath;
+    int laneCount = 256;
+    int cycles = 100000;
+    bool useScalar{};
+    bool isInputShared{};
+    bool isUsageWrong{};
+    for (int i{1}; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--lanes") == 0 && i + 1 < argc)
+            laneCount = std::stoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+            cycles = std::stoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--same-input") == 0)
+            isInputShared = true;
+        else if (std::strcmp(argv[i], "--scalar") == 0)
+            useScalar = true;
+        else if (romPath.empty())
+            romPath = argv[i];
+        else
+            isUsageWrong = true;
+    }
+    if (romPath.empty() || isUsageWrong || laneCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " <rom file> [--lanes <count>] [--cycles <count>] [--same-input] [--scalar]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file{romPath, std::ios::binary};
+    if (!file)
+    {
+        std::cerr << "Unable to open ROM: " << romPath << std::endl;
+        return 2;
+    }
+    const std::vector<uint8_t> rom{std::istreambuf_iterator<char>{file}, {}};
+
+    LockstepEngine engine{laneCount};
+    if (!engine.setSimdEnabled(!useScalar))
+        std::cerr << "AVX2 is not supported, using the scalar kernel" << std::endl;
+    std::vector<std::unique_ptr<Chip8Core>> cores;
+    if (!engine.loadRom(rom.data(), rom.size()))
+    {
+        std::cerr << "Program is too large" << std::endl;
+        return 2;
+    }
+    for (int lane{}; lane < laneCount; ++lane)
+    {
+        cores.push_back(std::make_unique<Chip8Core>());
+        cores.back()->loadRom(rom.data(), rom.size());
+        // The seed of the lane
+        cores.back()->setRandomSeed(lane);
+    }
+
+    Clock::duration engineTime{};
+    Clock::duration coreTime{};
+    for (int period{}; period * INPUT_PERIOD_CYCLES < cycles; ++period)
+    {
+        const int periodCycles = std::min(INPUT_PERIOD_CYCLES, cycles - period * INPUT_PERIOD_CYCLES);
+        for (int lane{}; lane < laneCount; ++lane)
+        {
+            const uint16_t keys = getLaneKeys(isInputShared ? 0 : lane, period);
+            engine.setKeyStates(lane, keys);
+            cores[lane]->setKeyStates(keys);
+        }
+
+        auto startTime = Clock::now();
+        engine.run(periodCycles);
+        engineTime += Clock::now() - startTime;
+
+        startTime = Clock::now();
+        for (auto& core : cores)
+        {
+            for (int i{}; i < periodCycles; ++i)
+                core->emulateCycle();
+        }
+        coreTime += Clock::now() - startTime;
+
+        for (int lane{}; lane < laneCount; ++lane)
+        {
+            const std::string difference = compareLane(engine, lane, *cores[lane]);
+            if (!difference.empty())
+            {
+                std::cout << "MISMATCH in lane " << std::dec << lane << " before cycle "
+                          << (period + 1) * INPUT_PERIOD_CYCLES << ": " << difference << '\n'
+                          << "Engine: PC=" << to_hex(engine.getPC(lane), 3)
+                          << ", Op=" << to_hex(engine.getOpcode(lane), 4) << '\n'
+                          << "Core:   " << cores[lane]->dumpStateToStr(false) << std::endl;
+                return 3;
+            }
+        }
+    }
+
+    int panickedCount{};
+    for (int lane{}; lane < laneCount; ++lane)
+        panickedCount += engine.hasPanicked(lane);
+
+    const double engineS = std::chrono::duration<double>(engineTime).count();
+    const double coreS = std::chrono::duration<double>(coreTime).count();
+    const double laneCycles = (double)laneCount * cycles;
+    std::cout << "All " << std::dec << laneCount << " lanes match after " << cycles << " cycles ("
+              << panickedCount << " panicked)\n"
+              << "Engine (" << (engine.isSimdEnabled() ? "AVX2" : "scalar") << "): "
+              << laneCycles / engineS / 1e6 << " million lane cycles/s\n"
+              << "Chip8Core::emulateCycle(): " << laneCycles / coreS / 1e6 << " million cycles/s" << std::endl;
+
+    return 0;
+}
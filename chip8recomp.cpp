@@ -0,0 +1,338 @@
+/*
+ * Static recompiler: translates a CHIP-8 ROM to a C++ source file.
+ *
+ * Usage: chip8recomp <rom file> <output file>
+ *
+ * The control flow is recovered by following the jumps, calls and skips from
+ * the start of the program. The found instructions are emitted as the cases of
+ * a `switch` on the PC, falling through to the next instruction, so a block of
+ * code runs without decoding or dispatching. Everything the generated code
+ * doesn't handle (computed jumps, drawing, input, timers, memory access,
+ * modified code) is executed by the interpreter of `Chip8Core`.
+ */
+
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <cstring>
+
+#include "opcode.h"
+#include "to_hex.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+#define PROGRAM_START 0x200
+
+// The blocks are cut at this length, the generated code falls back
+// to the interpreter when the remaining cycle budget is less than this
+#define MAX_BLOCK_INSTRUCTIONS 32
+
+/*
+ * Instructions that end a block.
+ */
+static bool isBranch(OpClass opClass)
+{
+    switch (opClass)
+    {
+        case OpClass::JP:
+        case OpClass::CALL:
+        case OpClass::RET:
+        case OpClass::SE_Imm:
+        case OpClass::SNE_Imm:
+        case OpClass::SE_Reg:
+        case OpClass::SNE_Reg:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/*
+ * Returns the C++ code of an instruction that the generated code executes itself,
+ * an empty string if it has to be left to the interpreter.
+ * The branches set `pc`.
+ */
+static std::string getNativeCode(const DecodedOp& op, uint16_t nextPc)
+{
+    const std::string x = to_hex(op.x, 1);
+    const std::string y = to_hex(op.y, 1);
+    const std::string nn = to_hex(op.nn, 2);
+    const std::string nnn = to_hex(op.nnn, 3);
+    const std::string next = to_hex(nextPc, 3);
+    const std::string skip = to_hex(nextPc + 2, 3);
+
+    switch (op.opClass)
+    {
+        case OpClass::NOP:      return ";";
+        case OpClass::CLS:      return "Access::clearScreen(core);";
+        case OpClass::RET:      return "pc = Access::ret(core);";
+        case OpClass::JP:       return "pc = " + nnn + ";";
+        case OpClass::CALL:     return "Access::call(core, " + next + "); pc = " + nnn + ";";
+        case OpClass::SE_Imm:   return "pc = V[" + x + "] == " + nn + " ? " + skip + " : " + next + ";";
+        case OpClass::SNE_Imm:  return "pc = V[" + x + "] != " + nn + " ? " + skip + " : " + next + ";";
+        case OpClass::SE_Reg:   return "pc = V[" + x + "] == V[" + y + "] ? " + skip + " : " + next + ";";
+        case OpClass::SNE_Reg:  return "pc = V[" + x + "] != V[" + y + "] ? " + skip + " : " + next + ";";
+        case OpClass::LD_Imm:   return "V[" + x + "] = " + nn + ";";
+        case OpClass::ADD_Imm:  return "V[" + x + "] += " + nn + ";";
+        case OpClass::LD_Reg:   return "V[" + x + "] = V[" + y + "];";
+        case OpClass::OR:       return "V[" + x + "] |= V[" + y + "];";
+        case OpClass::AND:      return "V[" + x + "] &= V[" + y + "];";
+        case OpClass::XOR:      return "V[" + x + "] ^= V[" + y + "];";
+        // Note: The carry is calculated from the updated Vx, like the interpreter does
+        case OpClass::ADD_Reg:  return "V[" + x + "] += V[" + y + "]; V[0xf] = V[" + y + "] > 0xff - V[" + x + "];";
+        case OpClass::SUB:      return "V[0xf] = !(V[" + x + "] < V[" + y + "]); V[" + x + "] = V[" + x + "] - V[" + y + "];";
+        case OpClass::SHR:      return "V[0xf] = V[" + x + "] & 1; V[" + x + "] = (shiftY ? V[" + y + "] : V[" + x + "]) >> 1;";
+        case OpClass::SUBN:     return "V[0xf] = !(V[" + x + "] > V[" + y + "]); V[" + x + "] = V[" + y + "] - V[" + x + "];";
+        case OpClass::SHL:      return "V[0xf] = V[" + x + "] >> 7; V[" + x + "] = (shiftY ? V[" + y + "] : V[" + x + "]) << 1;";
+        case OpClass::LD_I:     return "I = " + nnn + ";";
+        case OpClass::ADD_I:    return "I += V[" + x + "];";
+        case OpClass::LD_F:     return "I = V[" + x + "] * 5;";
+
+        default:                return "";
+    }
+}
+
+class Recompiler final
+{
+private:
+    uint8_t m_memory[0xfff+1]{};
+    size_t m_romSize{};
+
+    // The addresses of the instructions reachable from the start of the program
+    std::set<uint16_t> m_instructions;
+
+    inline DecodedOp decodeAt(uint16_t address) const
+    {
+        return decodeOpcode((m_memory[address] << 8) | m_memory[address + 1]);
+    }
+
+    inline bool isNative(uint16_t address) const
+    {
+        return m_instructions.count(address) && !getNativeCode(decodeAt(address), address + 2).empty();
+    }
+
+public:
+    bool loadRom(const std::vector<uint8_t>& rom)
+    {
+        if (rom.size() > 0x1000 - PROGRAM_START)
+            return false;
+
+        std::memcpy(m_memory + PROGRAM_START, rom.data(), rom.size());
+        m_romSize = rom.size();
+        return true;
+    }
+
+    void recoverControlFlow()
+    {
+        std::vector<uint16_t> toVisit{PROGRAM_START};
+        while (!toVisit.empty())
+        {
+            const uint16_t address = toVisit.back();
+            toVisit.pop_back();
+
+            if (address > 0xffe || m_instructions.count(address))
+                continue;
+
+            const DecodedOp op = decodeAt(address);
+            // Probably data
+            if (op.opClass == OpClass::Invalid)
+                continue;
+
+            m_instructions.insert(address);
+
+            switch (op.opClass)
+            {
+                case OpClass::JP:
+                    toVisit.push_back(op.nnn);
+                    break;
+
+                case OpClass::CALL:
+                    toVisit.push_back(op.nnn);
+                    toVisit.push_back(address + 2);
+                    break;
+
+                case OpClass::RET:
+                case OpClass::JP_V0: // Computed, left to the interpreter
+                    break;
+
+                case OpClass::SE_Imm:
+                case OpClass::SNE_Imm:
+                case OpClass::SE_Reg:
+                case OpClass::SNE_Reg:
+                case OpClass::SKP:
+                case OpClass::SKNP:
+                    toVisit.push_back(address + 2);
+                    toVisit.push_back(address + 4);
+                    break;
+
+                default:
+                    toVisit.push_back(address + 2);
+                    break;
+            }
+        }
+
+        Logger::log << "Found " << std::dec << m_instructions.size() << " reachable instructions" << Logger::End;
+    }
+
+    std::string generate(const std::string& romName) const
+    {
+        std::stringstream out;
+
+        out << "// Generated by chip8recomp from \"" << romName << "\". Do not edit.\n\n"
+            << "#include \"recompiled.h\"\n\n"
+            << "#define MAX_BLOCK_INSTRUCTIONS " << MAX_BLOCK_INSTRUCTIONS << "\n\n";
+
+        // ----- The ROM itself -----
+        out << "const uint8_t chip8RecompiledRom[] = {";
+        for (size_t i{}; i < m_romSize; ++i)
+        {
+            if (i % 16 == 0)
+                out << "\n   ";
+            out << ' ' << to_hex(m_memory[PROGRAM_START + i], 2) << ',';
+        }
+        out << "\n};\n"
+            << "const size_t chip8RecompiledRomSize = " << std::dec << m_romSize << ";\n\n";
+
+        // ----- The code -----
+        std::stringstream cases;
+        // The last byte of the block started at the address, 0 if the instruction is not recompiled
+        std::vector<uint16_t> blockEnds(0xfff+1);
+        int blockLength{};
+        std::vector<uint16_t> blockLabels;
+        for (auto it = m_instructions.begin(); it != m_instructions.end(); ++it)
+        {
+            const uint16_t address = *it;
+            if (!isNative(address))
+                continue;
+
+            const DecodedOp op = decodeAt(address);
+
+            blockLabels.push_back(address);
+            ++blockLength;
+
+            cases << "        case " << to_hex(address, 3) << ": // " << to_hex(op.opcode, 4, false)
+                  << "  " << getOpClassName(op.opClass) << '\n'
+                  << "            " << getNativeCode(op, address + 2) << '\n'
+                  << "            ++count;\n";
+
+            const auto next = std::next(it);
+            const bool canFallThrough = !isBranch(op.opClass)
+                && blockLength < MAX_BLOCK_INSTRUCTIONS
+                && next != m_instructions.end() && *next == address + 2 && isNative(*next);
+
+            if (canFallThrough)
+            {
+                cases << "            [[fallthrough]];\n";
+                continue;
+            }
+
+            if (!isBranch(op.opClass))
+                cases << "            pc = " << to_hex(address + 2, 3) << ";\n";
+            cases << "            lastOpcode = " << to_hex(op.opcode, 4) << ";\n"
+                  << "            break;\n\n";
+
+            for (uint16_t label : blockLabels)
+                blockEnds[label] = address + 1;
+            blockLabels.clear();
+            blockLength = 0;
+        }
+
+        out << "// The last byte of the block starting at the address, 0 if there's no block\n"
+            << "static const uint16_t blockEnds[0xfff+1] = {";
+        for (int i{}; i <= 0xfff; ++i)
+        {
+            if (i % 16 == 0)
+                out << "\n   ";
+            out << ' ' << to_hex(blockEnds[i], 3) << ',';
+        }
+        out << "\n};\n\n";
+
+        out << "int chip8RecompiledRun(Chip8Core& core, int cycles)\n"
+            << "{\n"
+            << "    using Access = Chip8RecompilerAccess;\n"
+            << "    uint8_t* const V = Access::getRegisters(core);\n"
+            << "    uint16_t& I = Access::getIndexReg(core);\n"
+            << "    const bool shiftY = Access::getCompatShiftYRegInsteadOfX(core);\n"
+            << "    (void)I; (void)shiftY;\n"
+            << "\n"
+            << "    int executed{};\n"
+            << "    while (executed < cycles)\n"
+            << "    {\n"
+            << "        if (!Access::canExecute(core))\n"
+            << "        {\n"
+            << "            // Panicked or waiting for a key\n"
+            << "            executed += core.run(cycles - executed);\n"
+            << "            break;\n"
+            << "        }\n"
+            << "\n"
+            << "        uint16_t pc = Access::getPC(core);\n"
+            << "        const uint16_t blockEnd = pc <= 0xfff ? blockEnds[pc] : 0;\n"
+            << "        if (!blockEnd || cycles - executed < MAX_BLOCK_INSTRUCTIONS || core.isMemoryWritten(pc, blockEnd))\n"
+            << "        {\n"
+            << "            // Not recompiled, computed jump target or modified code\n"
+            << "            core.emulateCycle();\n"
+            << "            ++executed;\n"
+            << "            continue;\n"
+            << "        }\n"
+            << "\n"
+            << "        int count{};\n"
+            << "        uint16_t lastOpcode{};\n"
+            << "        switch (pc)\n"
+            << "        {\n"
+            << cases.str()
+            << "        default:\n"
+            << "            core.emulateCycle();\n"
+            << "            ++executed;\n"
+            << "            continue;\n"
+            << "        }\n"
+            << "\n"
+            << "        Access::finishBlock(core, pc, count, lastOpcode);\n"
+            << "        executed += count;\n"
+            << "    }\n"
+            << "    return executed;\n"
+            << "}\n";
+
+        return out.str();
+    }
+};
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Verbose);
+
+    if (argc != 3)
+    {
+        Logger::err << "Usage: " << argv[0] << " <rom file> <output file>" << Logger::End;
+        return 1;
+    }
+
+    std::ifstream romFile{argv[1], std::ios::binary};
+    if (!romFile)
+    {
+        Logger::err << "Unable to open file: " << argv[1] << Logger::End;
+        return 2;
+    }
+    const std::vector<uint8_t> rom{std::istreambuf_iterator<char>{romFile}, {}};
+
+    Recompiler recompiler;
+    if (!recompiler.loadRom(rom))
+    {
+        Logger::err << "ROM is too large to fit in the memory: " << argv[1] << Logger::End;
+        return 2;
+    }
+    recompiler.recoverControlFlow();
+
+    std::ofstream outFile{argv[2]};
+    outFile << recompiler.generate(argv[1]);
+    if (!outFile)
+    {
+        Logger::err << "Unable to write file: " << argv[2] << Logger::End;
+        return 2;
+    }
+
+    Logger::log << "Wrote " << argv[2] << Logger::End;
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Headless movie player.
+ *
+ * Usage: chip8replay <movie file> [--cycles <count>] [--interpret] [--memory-map <file>] [--trace <file>]
+ *
+ * Replays a movie recorded by the emulator (`--record`) as fast as possible and prints
+ * the state of the machine at its end, or after the given number of cycles.
+ * The replay is bit-exact, so it shows the same as the emulator did when the recording stopped.
+ * With `--interpret` the JIT is not used, the output has to be the same.
+ * With `--memory-map` the bytes read, written and executed during the replay are saved
+ * to a file (see `MemoryAccessMap::saveToFile()`), the JIT is not used then either.
+ * With `--trace` the last `TRACE_BUFFER_SIZE` executed instructions are saved to a file
+ * at the end (or when the machine panics), it can be read with `chip8trace`.
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <memory>
+
+#include "chip8core.h"
+#include "movie.h"
+#include "to_hex.h"
+#include "async_log.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+    // Built with the debug messages (the tracked core is shared with the emulator),
+    // the memory dump is formatted on the log thread
+    AsyncLog::start();
+
+    std::string moviePath;
+    uint64_t cycleLimit = std::numeric_limits<uint64_t>::max();
+    bool useInterpreter{};
+    std::string memoryMapPath;
+    std::string tracePath;
+    bool isUsageWrong{};
+    for (int i{1}; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+            cycleLimit = std::stoull(argv[++i]);
+        else if (std::strcmp(argv[i], "--interpret") == 0)
+            useInterpreter = true;
+        else if (std::strcmp(argv[i], "--memory-map") == 0 && i + 1 < argc)
+            memoryMapPath = argv[++i];
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (moviePath.empty())
+            moviePath = argv[i];
+        else
+            isUsageWrong = true;
+    }
+    if (moviePath.empty() || isUsageWrong)
+    {
+        std::cerr << "Usage: " << argv[0] << " <movie file> [--cycles <count>] [--interpret] [--memory-map <file>] [--trace <file>]" << std::endl;
+        return 1;
+    }
+
+    Movie movie;
+    if (!movie.load(moviePath))
+        return 2;
+
+    Chip8Core core;
+    core.setJitEnabled(!useInterpreter);
+    MemoryAccessMap memoryAccessMap;
+    if (!memoryMapPath.empty())
+        core.setMemoryAccessMap(&memoryAccessMap);
+    std::unique_ptr<TraceBuffer> traceBuffer;
+    if (!tracePath.empty())
+    {
+        traceBuffer = std::make_unique<TraceBuffer>(TRACE_BUFFER_SIZE);
+        core.setTraceBuffer(traceBuffer.get());
+    }
+    MoviePlayer player{std::move(movie)};
+    if (!player.start(core))
+        return 2;
+    const uint64_t startCycle = core.getCycleCount();
+
+    const auto startTime = std::chrono::steady_clock::now();
+    uint64_t executed{};
+    while (executed < cycleLimit && !player.isFinished(core))
+    {
+        const int ran = player.run(core, std::min<uint64_t>(cycleLimit - executed, 1000000));
+        if (ran == 0)
+            break;
+        executed += ran;
+    }
+    const auto elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << std::dec
+              << "Movie: " << player.getMovie().events.size() << " input changes in "
+              << player.getMovie().endCycle - startCycle << " cycles\n"
+              << "Executed cycles: " << executed << '\n'
+              << "Cycle count: " << core.getCycleCount() << '\n'
+              << "PC: " << to_hex(core.getPC(), 3) << '\n'
+              << "Framebuffer hash: " << to_hex(core.getFrameBuffer().getHash(), 8) << '\n';
+    if (core.hasPanicked())
+        std::cout << "Panic: " << core.getPanicMessage() << '\n';
+    for (int y{}; y < 32; ++y)
+    {
+        for (int x{}; x < 64; ++x)
+            std::cout << (core.getFrameBuffer().get(x, y) ? '#' : '.');
+        std::cout << '\n';
+    }
+    std::cout << core.dumpStateToStr(false)
+              << "Time: " << elapsedMs << " ms" << std::endl;
+
+    if (!memoryMapPath.empty() && !memoryAccessMap.saveToFile(memoryMapPath))
+        return 2;
+    if (traceBuffer && !traceBuffer->save(tracePath))
+        return 2;
+    return 0;
+}
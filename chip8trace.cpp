@@ -0,0 +1,149 @@
+/*
+ * Trace decoder.
+ *
+ * Usage: chip8trace <trace file> [--last <count>] [--pc <address>[-<address>]] [--op <instruction>] [--reg <index>]
+ *
+ * Prints the instructions of a trace saved by the emulator or `chip8replay --trace`, from the oldest:
+ * the cycle, the PC, the opcode, the instruction, the index register after it and the register it changed.
+ * The filters select the instructions at the PC or in the address range, the instructions
+ * of a kind (the mnemonic without the operands, like "DRW") and the ones that changed a register.
+ * With `--last` only the last matching instructions are printed.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cctype>
+#include <vector>
+#include <limits>
+
+#include "trace.h"
+#include "opcode.h"
+#include "to_hex.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+static bool parseNumber(const std::string& text, unsigned long& value)
+{
+    try
+    {
+        size_t end;
+        value = std::stoul(text, &end, 0);
+        return end == text.size();
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+/*
+ * Returns the mnemonic of the instruction class without the operands, like "LD" for "LD Vx, byte".
+ */
+static std::string getMnemonic(OpClass opClass)
+{
+    const std::string name = getOpClassName(opClass);
+    return name.substr(0, name.find(' '));
+}
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+
+    std::string tracePath;
+    size_t lastCount = std::numeric_limits<size_t>::max();
+    unsigned long pcFrom = 0;
+    unsigned long pcTo = 0xfff;
+    std::string mnemonic;
+    int registerFilter = -1;
+    bool isUsageWrong{};
+    for (int i{1}; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--last") == 0 && i + 1 < argc)
+        {
+            unsigned long value;
+            isUsageWrong |= !parseNumber(argv[++i], value);
+            lastCount = value;
+        }
+        else if (std::strcmp(argv[i], "--pc") == 0 && i + 1 < argc)
+        {
+            const std::string range = argv[++i];
+            const size_t dash = range.find('-');
+            isUsageWrong |= !parseNumber(range.substr(0, dash), pcFrom);
+            pcTo = pcFrom;
+            if (dash != std::string::npos)
+                isUsageWrong |= !parseNumber(range.substr(dash + 1), pcTo);
+        }
+        else if (std::strcmp(argv[i], "--op") == 0 && i + 1 < argc)
+        {
+            mnemonic = argv[++i];
+            for (char& c : mnemonic)
+                c = std::toupper(c);
+        }
+        else if (std::strcmp(argv[i], "--reg") == 0 && i + 1 < argc)
+        {
+            unsigned long value;
+            isUsageWrong |= !parseNumber(argv[++i], value) || value > 0xf;
+            registerFilter = value;
+        }
+        else if (tracePath.empty())
+        {
+            tracePath = argv[i];
+        }
+        else
+        {
+            isUsageWrong = true;
+        }
+    }
+    if (tracePath.empty() || isUsageWrong)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace file> [--last <count>] [--pc <address>[-<address>]]"
+                     " [--op <instruction>] [--reg <index>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    uint64_t writtenCount;
+    if (!loadTrace(tracePath, records, writtenCount))
+        return 2;
+
+    std::cout << std::dec << "Trace: the last " << records.size() << " of " << writtenCount << " instructions";
+    if (!records.empty())
+        std::cout << ", cycles " << records.front().cycle << '-' << records.back().cycle;
+    std::cout << '\n';
+
+    std::vector<const TraceRecord*> matches;
+    for (const TraceRecord& record : records)
+    {
+        if (record.pc < pcFrom || record.pc > pcTo)
+            continue;
+        if (!mnemonic.empty() && getMnemonic(decodeOpcode(record.opcode).opClass) != mnemonic)
+            continue;
+        if (registerFilter != -1 && (record.changedRegister == TraceRecord::NO_REGISTER
+                || ((record.changedRegister & 0xf) != registerFilter
+                    && !(registerFilter == 0xf && (record.changedRegister & TraceRecord::VF_CHANGED_TOO)))))
+            continue;
+        matches.push_back(&record);
+    }
+
+    const size_t first = matches.size() > lastCount ? matches.size() - lastCount : 0;
+    for (size_t i{first}; i < matches.size(); ++i)
+    {
+        const TraceRecord& record = *matches[i];
+        std::cout << std::dec << std::setw(12) << std::setfill(' ') << record.cycle
+                  << "  " << to_hex(record.pc, 3)
+                  << "  " << to_hex(record.opcode, 4)
+                  << "  " << std::left << std::setw(18) << getOpClassName(decodeOpcode(record.opcode).opClass) << std::right
+                  << "  I=" << to_hex(record.indexReg, 3);
+        if (record.changedRegister != TraceRecord::NO_REGISTER)
+        {
+            std::cout << "  V" << "0123456789ABCDEF"[record.changedRegister & 0xf] << '=' << to_hex(record.value, 2);
+            if (record.changedRegister & TraceRecord::VF_CHANGED_TOO)
+                std::cout << " (VF changed)";
+        }
+        std::cout << '\n';
+    }
+    std::cout << std::flush;
+
+    return 0;
+}
@@ -1,16 +1,25 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#include <SDL2/SDL.h>
 #include <stdint.h>
 
 //-------------------------------- Logging -------------------------------------
 
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_ERROR 3
+
 /*
- * If 1, the currently executed opcode, the current PC value and the pressed
- * key is logged to the terminal.
+ * The least important messages that are logged, the ones below it are compiled out.
+ * With LOG_LEVEL_TRACE the currently executed opcode, the current PC value and
+ * the pressed key are logged to the terminal, too (very slow).
+ * With LOG_LEVEL_DEBUG the memory is dumped when a program is loaded.
+ * The headless tools and the library are built with LOG_LEVEL_INFO (see CMakeLists.txt).
  */
-#define VERBOSE_LOG 0
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
 
 //--------------------------------- Look ---------------------------------------
 
@@ -43,6 +52,7 @@
 //-------------------------------- Shortcuts -----------------------------------
 
 // See: https://wiki.libsdl.org/SDL_Keycode
+// The SDL headers have to be included where these are used.
 
 #define SHORTCUT_KEYCODE_PAUSE           SDLK_p
 #define SHORTCUT_KEYCODE_FULLSCREEN      SDLK_F11
@@ -56,10 +66,37 @@
 #define SHORTCUT_KEYCODE_DEC_SPEED       SDLK_F7
 #define SHORTCUT_KEYCODE_RESET           SDLK_F4
 #define SHORTCUT_KEYCODE_SCREENSHOT      SDLK_F2
+#define SHORTCUT_KEYCODE_SAVE_STATE      SDLK_F3
+#define SHORTCUT_KEYCODE_LOAD_STATE      SDLK_F12
+#define SHORTCUT_KEYCODE_REWIND          SDLK_LEFT // Hold to rewind
 #define SHORTCUT_KEYCODE_TOGGLE_HELP     SDLK_F1
 #define SHORTCUT_KEYCODE_TOGGLE_COMPAT_SHIFTYREG    SDLK_n
 #define SHORTCUT_KEYCODE_TOGGLE_COMPAT_INCI         SDLK_m
 #define SHORTCUT_KEYCODE_GOTO_FILE_DLG   SDLK_TAB
+#define SHORTCUT_KEYCODE_EXPORT_PROFILE  SDLK_j // In debug mode
+#define SHORTCUT_KEYCODE_EXPORT_MEMORY_MAP  SDLK_k // In debug mode
+#define SHORTCUT_KEYCODE_TOGGLE_TRACING  SDLK_t
+#define SHORTCUT_KEYCODE_SAVE_TRACE      SDLK_y
+#define SHORTCUT_KEYCODE_SAVE_ROM_PROFILE   SDLK_u
+
+//------------------------------- Emulation ------------------------------------
+
+/*
+ * How many instructions are executed a second at 100% speed.
+ */
+#define INSTRUCTIONS_PER_SECOND 500
+
+/*
+ * How many times a second the keyboard is read, the screen is updated
+ * and the timers are decremented.
+ */
+#define FRAMES_PER_SECOND 60
+
+/*
+ * If the emulator falls behind by more frames than this (for example the
+ * window was being dragged), it doesn't try to catch up.
+ */
+#define MAX_FRAME_LAG 5
 
 //--------------------------------- Misc. --------------------------------------
 
@@ -68,9 +105,31 @@
  */
 #define MESSAGE_SHOW_TIME_S 3.0
 
+/*
+ * How many times a second the debugger can be redrawn at most.
+ */
+#define DEBUGGER_MAX_REFRESH_RATE 30
+
+/*
+ * How much memory is used to record the earlier frames for rewinding, in bytes.
+ * A frame usually takes 30-50 bytes, so 8 MiB holds about an hour.
+ */
+#define REWIND_BUFFER_SIZE (8 * 1024 * 1024)
+
+/*
+ * How many of the last executed instructions are kept while tracing.
+ * A record takes 16 bytes, so a million takes 16 MiB.
+ */
+#define TRACE_BUFFER_SIZE (1024 * 1024)
+
+/*
+ * The settings of the known ROMs, applied when a ROM is loaded. See rom_profile.h.
+ */
+#define ROM_PROFILE_DATABASE_PATH "rom_profiles.txt"
+
 /*
  * How long the beep sound should be. Specified in frames
  */
-#define BEEP_DURATION 50 // frames
+#define BEEP_DURATION 6 // frames
 
 #endif // CONFIG_H
@@ -0,0 +1,273 @@
+#include "emulator_thread.h"
+
+#include <chrono>
+#include <future>
+
+#include "config.h"
+#include "async_log.h"
+
+using Clock = std::chrono::steady_clock;
+
+EmulatorThread::EmulatorThread(Chip8Core& core)
+    : m_core{core}
+{
+}
+
+EmulatorThread::~EmulatorThread()
+{
+    stop();
+}
+
+void EmulatorThread::start()
+{
+    if (isRunning())
+        return;
+
+    m_shouldStop = false;
+    publishFrame();
+    m_thread = std::thread{&EmulatorThread::threadMain, this};
+}
+
+void EmulatorThread::stop()
+{
+    if (!isRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_shouldStop = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+}
+
+void EmulatorThread::execute(const std::function<void(Chip8Core&)>& function)
+{
+    if (!isRunning())
+    {
+        function(m_core);
+        return;
+    }
+
+    std::promise<void> done;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_commands.push_back([&](){ function(m_core); done.set_value(); });
+    }
+    m_wakeUp.notify_one();
+    done.get_future().wait();
+}
+
+void EmulatorThread::clearRewindHistory()
+{
+    execute([this](Chip8Core& core){
+            m_rewindBuffer.clear();
+            // The history starts from the current state
+            core.saveState(m_stateBuffer.data());
+            m_rewindBuffer.push(m_stateBuffer.data());
+    });
+}
+
+void EmulatorThread::startRecording()
+{
+    execute([this](Chip8Core& core){
+            m_player.reset();
+            m_recorder = std::make_unique<MovieRecorder>(core);
+    });
+    clearRewindHistory();
+}
+
+bool EmulatorThread::stopRecording(Movie* movie)
+{
+    bool wasRecording{};
+    execute([this, movie, &wasRecording](Chip8Core& core){
+            if (!m_recorder)
+                return;
+            *movie = m_recorder->finish(core);
+            m_recorder.reset();
+            wasRecording = true;
+    });
+    return wasRecording;
+}
+
+bool EmulatorThread::startReplay(Movie movie)
+{
+    bool isStarted{};
+    execute([this, &movie, &isStarted](Chip8Core& core){
+            m_recorder.reset();
+            m_player = std::make_unique<MoviePlayer>(std::move(movie));
+            isStarted = m_player->start(core);
+            if (!isStarted)
+                m_player.reset();
+    });
+    if (isStarted)
+        clearRewindHistory();
+    return isStarted;
+}
+
+void EmulatorThread::stopReplay()
+{
+    execute([this](Chip8Core&){ m_player.reset(); });
+}
+
+void EmulatorThread::threadMain()
+{
+    const auto frameDuration = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>{1.0 / FRAMES_PER_SECOND});
+    // When the next frame should start
+    auto nextFrameTime = Clock::now();
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            // Sleep until the next frame, but wake up for the commands
+            while (true)
+            {
+                for (auto& command : m_commands)
+                    command();
+                const bool hadCommands = !m_commands.empty();
+                m_commands.clear();
+                // A command may have loaded another state
+                if (hadCommands)
+                    seekMovie();
+
+                if (m_shouldStop)
+                    return;
+
+                // Show the result of the commands even if paused
+                if (hadCommands)
+                    publishFrame();
+
+                if (Clock::now() >= nextFrameTime)
+                    break;
+                m_wakeUp.wait_until(lock, nextFrameTime);
+            }
+        }
+
+        emulateFrame();
+
+        // The deadline is advanced by exactly one frame, so the timing errors don't add up
+        nextFrameTime += frameDuration;
+        const auto now = Clock::now();
+        if (now - nextFrameTime > frameDuration * MAX_FRAME_LAG)
+            nextFrameTime = now;
+    }
+}
+
+void EmulatorThread::emulateFrame()
+{
+    if (m_isRewinding.load(std::memory_order_relaxed))
+    {
+        rewindFrame();
+        return;
+    }
+
+    const bool isPaused = m_isPaused.load(std::memory_order_relaxed);
+    if (isPaused && m_pendingSteps.load(std::memory_order_relaxed) == 0)
+        return;
+
+    // During a replay the keyboard is ignored, the player sets the keys
+    if (!m_player)
+    {
+        const uint16_t keyStates = m_keyStates.load(std::memory_order_relaxed);
+        if (m_recorder)
+            m_recorder->recordKeyStates(m_core, keyStates);
+        m_core.setKeyStates(keyStates);
+    }
+
+    if (isPaused)
+    {
+        m_pendingSteps.fetch_sub(1, std::memory_order_relaxed);
+
+        m_core.clearLastRegisterOperationFlags();
+        m_core.clearIsReadingKeyStateFlag();
+        if (m_player)
+            m_player->step(m_core);
+        else
+            m_core.emulateCycle();
+    }
+    else
+    {
+        m_pendingSteps.store(0, std::memory_order_relaxed);
+
+        // A ROM profile can change the speed of the machine
+        m_instructionBudget += m_core.getInstructionsPerSecond()
+            * (m_speedPerc.load(std::memory_order_relaxed) / 100.0) / FRAMES_PER_SECOND;
+        const int instructionCount = m_instructionBudget;
+        m_instructionBudget -= instructionCount;
+
+        m_core.clearLastRegisterOperationFlags();
+        m_core.clearIsReadingKeyStateFlag();
+        if (m_player)
+            m_player->run(m_core, instructionCount);
+        else
+            m_core.run(instructionCount);
+    }
+
+    if (m_player && m_player->isFinished(m_core))
+    {
+        AsyncLog::info("The replay has finished");
+        m_player.reset();
+    }
+
+    m_core.saveState(m_stateBuffer.data());
+    m_rewindBuffer.push(m_stateBuffer.data());
+
+    publishFrame();
+}
+
+void EmulatorThread::rewindFrame()
+{
+    const uint8_t* state = m_rewindBuffer.pop();
+    if (!state)
+        return;
+
+    m_core.loadState(state, Chip8Core::SAVE_STATE_SIZE);
+    m_core.clearLastRegisterOperationFlags();
+    seekMovie();
+    publishFrame();
+}
+
+void EmulatorThread::seekMovie()
+{
+    if (m_recorder)
+        m_recorder->seek(m_core);
+    if (m_player)
+        m_player->seek(m_core);
+}
+
+void EmulatorThread::publishFrame()
+{
+    FrameSnapshot& frame = m_frames.getWriteBuffer();
+
+    std::memcpy(frame.rows, m_core.getFrameBuffer().m_rows, sizeof(frame.rows));
+    m_core.clearDirtyRows();
+
+    frame.registers = m_core.getRegisters();
+    for (int i{}; i < 16; ++i)
+        frame.stack[i] = m_core.getStackElement(i);
+    frame.sp = m_core.getSP();
+    frame.pc = m_core.getPC();
+    frame.opcode = m_core.getOpcode();
+    frame.indexReg = m_core.getIndexReg();
+    frame.delayTimer = m_core.getDelayTimer();
+    frame.soundTimer = m_core.getSoundTimer();
+    frame.isReadingKey = m_core.isReadingKey();
+    frame.isWaitingForKey = m_core.isWaitingForKey();
+    frame.hasPanicked = m_core.hasPanicked();
+    frame.rewindFrameCount = m_rewindBuffer.getFrameCount();
+    frame.isReplaying = (bool)m_player;
+    frame.isProfiling = m_core.getProfiler();
+    if (frame.isProfiling)
+        m_core.getProfiler()->summarize(frame.profile);
+    frame.isTrackingMemory = m_core.getMemoryAccessMap();
+    if (frame.isTrackingMemory)
+    {
+        frame.memoryAccess = *m_core.getMemoryAccessMap();
+        // The next frame shows the accesses made during it
+        m_core.getMemoryAccessMap()->clearRecent();
+    }
+
+    m_frames.publish();
+}
@@ -0,0 +1,169 @@
+#ifndef EMULATOR_THREAD_H
+#define EMULATOR_THREAD_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <memory>
+
+#include "chip8core.h"
+#include "profiler.h"
+#include "memory_access_map.h"
+#include "triple_buffer.h"
+#include "rewind_buffer.h"
+#include "movie.h"
+
+/*
+ * The state of the machine after a frame, everything the window needs to show.
+ */
+struct FrameSnapshot
+{
+    uint64_t rows[32]{};
+
+    // For the debugger
+    Registers registers;
+    uint16_t stack[16]{};
+    uint8_t sp{};
+    uint16_t pc{};
+    uint16_t opcode{};
+    uint16_t indexReg{};
+    uint8_t delayTimer{};
+    uint8_t soundTimer{};
+    bool isReadingKey{};
+
+    bool isWaitingForKey{};
+    bool hasPanicked{};
+
+    // How many frames the machine can be rewound
+    int rewindFrameCount{};
+    // Whether the input comes from a movie instead of the keyboard
+    bool isReplaying{};
+
+    // Only valid if a profiler is attached to the machine
+    bool isProfiling{};
+    ProfileSummary profile;
+    // Only valid if a memory access map is attached to the machine,
+    // the recent accesses are the ones made during this frame
+    bool isTrackingMemory{};
+    MemoryAccessMap memoryAccess;
+};
+
+/*
+ * Runs a `Chip8Core` on its own thread at `FRAMES_PER_SECOND`, independently
+ * of how fast the window is presented.
+ *
+ * The finished frames are handed over through a lock-free triple buffer,
+ * the input is forwarded as atomics. Everything else that touches the
+ * machine has to go through `execute()`.
+ */
+class EmulatorThread final
+{
+private:
+    Chip8Core& m_core;
+
+    std::thread m_thread;
+    std::atomic<bool> m_shouldStop{};
+
+    // Guards `m_commands`
+    std::mutex m_mutex;
+    // Wakes up the thread when a command is queued or it should stop
+    std::condition_variable m_wakeUp;
+    std::vector<std::function<void()>> m_commands;
+
+    TripleBuffer<FrameSnapshot> m_frames;
+
+    // Bit N is set if key N is down
+    std::atomic<uint16_t> m_keyStates{};
+    std::atomic<int> m_speedPerc{100};
+    std::atomic<bool> m_isPaused{};
+    // Instructions to execute while paused
+    std::atomic<int> m_pendingSteps{};
+    std::atomic<bool> m_isRewinding{};
+
+    // Only used by the emulation thread
+    double m_instructionBudget{};
+    // The state after every emulated frame
+    RewindBuffer m_rewindBuffer{REWIND_BUFFER_SIZE, Chip8Core::SAVE_STATE_SIZE};
+    std::vector<uint8_t> m_stateBuffer = std::vector<uint8_t>(Chip8Core::SAVE_STATE_SIZE);
+    // At most one of them is active
+    std::unique_ptr<MovieRecorder> m_recorder;
+    std::unique_ptr<MoviePlayer> m_player;
+
+    void threadMain();
+    void emulateFrame();
+    /*
+     * Restores the state before the last recorded frame.
+     */
+    void rewindFrame();
+    /*
+     * Tells the recorder or the player that the machine may have been moved to another point of the run.
+     */
+    void seekMovie();
+    void publishFrame();
+
+public:
+    EmulatorThread(Chip8Core& core);
+    ~EmulatorThread();
+
+    void start();
+    /*
+     * Stops the thread and waits for it to finish.
+     * After this, the machine can be accessed directly.
+     */
+    void stop();
+    inline bool isRunning() const { return m_thread.joinable(); }
+
+    /*
+     * Executes `function` on the emulation thread between two frames and waits for it.
+     * If the thread is not running, it is executed right away.
+     */
+    void execute(const std::function<void(Chip8Core&)>& function);
+
+    inline void setKeyStates(uint16_t states) { m_keyStates.store(states, std::memory_order_relaxed); }
+    inline void setSpeedPerc(int value) { m_speedPerc.store(value, std::memory_order_relaxed); }
+    /*
+     * While paused, only the instructions requested with `step()` are executed.
+     */
+    inline void setPaused(bool value) { m_isPaused.store(value, std::memory_order_relaxed); }
+    inline void step() { m_pendingSteps.fetch_add(1, std::memory_order_relaxed); }
+
+    /*
+     * While rewinding, every frame restores the state before the previous frame
+     * instead of emulating, until the start of the recorded history.
+     */
+    inline void setRewinding(bool value) { m_isRewinding.store(value, std::memory_order_relaxed); }
+    /*
+     * Forgets the recorded frames, so the machine can't be rewound to before its current state.
+     */
+    void clearRewindHistory();
+
+    /*
+     * Starts recording the input from the current state.
+     * The rewind history is cleared, so the machine can't be rewound to before the start of the movie.
+     */
+    void startRecording();
+    /*
+     * Returns false if nothing was being recorded.
+     */
+    bool stopRecording(Movie* movie);
+    /*
+     * Loads the start state of `movie` and feeds its input to the machine instead of the keyboard.
+     * When the movie ends, the keyboard takes over.
+     * Returns false if the movie has an invalid state.
+     */
+    bool startReplay(Movie movie);
+    void stopReplay();
+
+    /*
+     * Picks up the latest finished frame.
+     * Returns false if there is no new frame since the last call.
+     */
+    inline bool updateFrame() { return m_frames.update(); }
+    inline const FrameSnapshot& getFrame() const { return m_frames.getReadBuffer(); }
+};
+
+#endif // EMULATOR_THREAD_H
@@ -0,0 +1,122 @@
+#include "gfx.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GFX_HAS_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define GFX_HAS_X86_KERNELS 0
+#endif
+
+namespace Gfx
+{
+
+namespace
+{
+
+using RowKernel = void (*)(uint64_t bits, uint32_t* dest, uint32_t onTexel, uint32_t offTexel);
+
+void expandRowScalar(uint64_t bits, uint32_t* dest, uint32_t onTexel, uint32_t offTexel)
+{
+    for (int i{}; i < 64; ++i)
+        dest[i] = ((bits >> (63 - i)) & 1) ? onTexel : offTexel;
+}
+
+#if GFX_HAS_X86_KERNELS
+
+/*
+ * Lookup kernel: a table maps a nibble to four lane masks,
+ * the texel is `off ^ (mask & (on ^ off))`.
+ */
+struct NibbleMaskTable
+{
+    alignas(16) uint32_t masks[16][4];
+
+    NibbleMaskTable()
+    {
+        for (int nibble{}; nibble < 16; ++nibble)
+        {
+            for (int lane{}; lane < 4; ++lane)
+                masks[nibble][lane] = (nibble & (0x8 >> lane)) ? 0xffffffff : 0;
+        }
+    }
+};
+const NibbleMaskTable nibbleMaskTable;
+
+__attribute__((target("sse2")))
+void expandRowSse2(uint64_t bits, uint32_t* dest, uint32_t onTexel, uint32_t offTexel)
+{
+    const __m128i off = _mm_set1_epi32(offTexel);
+    const __m128i diff = _mm_set1_epi32(onTexel ^ offTexel);
+    for (int i{}; i < 16; ++i)
+    {
+        const int nibble = (bits >> (60 - i * 4)) & 0xf;
+        const __m128i mask = _mm_load_si128((const __m128i*)nibbleMaskTable.masks[nibble]);
+        _mm_storeu_si128((__m128i*)(dest + i * 4), _mm_xor_si128(off, _mm_and_si128(mask, diff)));
+    }
+}
+
+/*
+ * Blend kernel: a byte is broadcast to eight lanes, every lane tests its own bit.
+ */
+__attribute__((target("avx2")))
+void expandRowAvx2(uint64_t bits, uint32_t* dest, uint32_t onTexel, uint32_t offTexel)
+{
+    const __m256i on = _mm256_set1_epi32(onTexel);
+    const __m256i off = _mm256_set1_epi32(offTexel);
+    const __m256i bitMasks = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    for (int i{}; i < 8; ++i)
+    {
+        const __m256i byte = _mm256_set1_epi32((bits >> (56 - i * 8)) & 0xff);
+        const __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bitMasks), bitMasks);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8), _mm256_blendv_epi8(off, on, mask));
+    }
+}
+
+#endif // GFX_HAS_X86_KERNELS
+
+struct Kernel
+{
+    RowKernel fn;
+    const char* name;
+};
+
+Kernel selectKernel()
+{
+#if GFX_HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {expandRowAvx2, "AVX2"};
+    if (__builtin_cpu_supports("sse2"))
+        return {expandRowSse2, "SSE2"};
+#endif
+    return {expandRowScalar, "scalar"};
+}
+
+const Kernel& getKernel()
+{
+    static const Kernel kernel = selectKernel();
+    return kernel;
+}
+
+} // End of namespace
+
+void expandBitRows(
+        const uint64_t* rows, int rowCount, int width,
+        uint32_t* dest, size_t destPitch,
+        uint32_t onTexel, uint32_t offTexel)
+{
+    const RowKernel kernel = getKernel().fn;
+    const int wordsPerRow = width / 64;
+    for (int y{}; y < rowCount; ++y)
+    {
+        for (int word{}; word < wordsPerRow; ++word)
+            kernel(rows[y * wordsPerRow + word], dest + y * destPitch + word * 64, onTexel, offTexel);
+    }
+}
+
+const char* getExpandKernelName()
+{
+    return getKernel().name;
+}
+
+} // End of namespace
@@ -1,25 +1,36 @@
-#include <SDL2/SDL.h>
+#ifndef GFX_H
+#define GFX_H
+
+#include <stdint.h>
+#include <stddef.h>
 
 namespace Gfx
 {
 
 /*
- * Draw a pixel to a locked 24-bit RGB texture.
- * The function does not check the validity of the arguments.
+ * Expand 1-bit rows to 32-bit texels.
+ * Uses AVX2 or SSE2 if the CPU supports it.
  *
  * Arguments:
- *      pixelData: A pointer to the pixel data of the destination texture.
- *      texturePitch: Number of bytes per one texture scanline.
- *      xPos: The x coordinate of the pixel.
- *      yPos: The y coordinate of the pixel.
- *      color: The color to set the pixel to. The alpha channel is ignored.
+ *      rows: The bitmaps of the rows, `width / 64` words per row,
+ *            the leftmost pixel is the most significant bit.
+ *      rowCount: The number of rows to convert.
+ *      width: The number of pixels in a row, must be a multiple of 64.
+ *      dest: The texels of the first row.
+ *      destPitch: Number of texels per one destination row.
+ *      onTexel: The texel of the set bits, in the format of the destination.
+ *      offTexel: The texel of the clear bits, in the format of the destination.
  */
-inline void drawPoint(uint8_t* pixelData, int texturePitch, int xPos, int yPos, const SDL_Color& color)
-{
-    const int offset{xPos * 3 + yPos * texturePitch};
-    pixelData[offset + 0] = color.r;
-    pixelData[offset + 1] = color.g;
-    pixelData[offset + 2] = color.b;
-}
+void expandBitRows(
+        const uint64_t* rows, int rowCount, int width,
+        uint32_t* dest, size_t destPitch,
+        uint32_t onTexel, uint32_t offTexel);
+
+/*
+ * Returns the name of the conversion kernel `expandBitRows()` uses on this CPU.
+ */
+const char* getExpandKernelName();
 
 } // End of namespace
+
+#endif // GFX_H
@@ -0,0 +1,21 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Hashes `size` bytes with FNV-1a. Pass the result as `hash` to continue the hash with more data.
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash=0xcbf29ce484222325)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i{}; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+#endif // HASH_H
@@ -0,0 +1,375 @@
+#include "jit.h"
+
+#if CHIP8_HAS_JIT
+
+#include <vector>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "chip8core.h"
+#include "opcode.h"
+
+// The blocks are cut at this length, so the cycle budget of `run()` can be kept
+#define MAX_BLOCK_INSTRUCTIONS 32
+
+#define CODE_BUFFER_SIZE (1024 * 1024)
+
+namespace
+{
+
+/*
+ * Emits the x86-64 code of the instructions.
+ *
+ * The generated function gets the address of the registers in `rdi`
+ * and the address of the index register in `rsi`, returns the new PC in `eax`.
+ * Only `rax`, `rcx` and `rdx` are used, so nothing needs to be saved.
+ */
+class Emitter final
+{
+private:
+    std::vector<uint8_t> m_code;
+
+    void emit(std::initializer_list<uint8_t> bytes)
+    {
+        m_code.insert(m_code.end(), bytes);
+    }
+
+    void emit32(uint32_t value)
+    {
+        emit({uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)});
+    }
+
+    // mov al, [rdi+reg]
+    void loadAl(uint8_t reg) { emit({0x8a, 0x47, reg}); }
+    // mov cl, [rdi+reg]
+    void loadCl(uint8_t reg) { emit({0x8a, 0x4f, reg}); }
+    // mov [rdi+reg], al
+    void storeAl(uint8_t reg) { emit({0x88, 0x47, reg}); }
+    // mov [rdi+reg], cl
+    void storeCl(uint8_t reg) { emit({0x88, 0x4f, reg}); }
+    // mov eax, value
+    void movEax(uint32_t value) { emit({0xb8}); emit32(value); }
+    // ret
+    void ret() { emit({0xc3}); }
+
+    /*
+     * Sets the PC to `nextPc` or to the instruction after it, depending on
+     * the flags (`jccKeepNext` is the opcode of the short jump taken when
+     * the instruction is not skipped), then returns.
+     */
+    void skipAndReturn(uint8_t jccKeepNext, uint16_t nextPc)
+    {
+        movEax(nextPc); // Note: `mov` doesn't modify the flags
+        emit({jccKeepNext, 0x05}); // Jump over the next `mov`
+        movEax(nextPc + 2);
+        ret();
+    }
+
+public:
+    inline const std::vector<uint8_t>& getCode() const { return m_code; }
+
+    /*
+     * Emits an instruction that doesn't change the control flow.
+     * Returns false if it can't be translated.
+     */
+    bool emitStraight(const DecodedOp& op, bool shiftYReg)
+    {
+        switch (op.opClass)
+        {
+            case OpClass::NOP:
+                return true;
+
+            case OpClass::LD_Imm:
+                emit({0xc6, 0x47, op.x, op.nn}); // mov byte [rdi+x], nn
+                return true;
+
+            case OpClass::ADD_Imm:
+                emit({0x80, 0x47, op.x, op.nn}); // add byte [rdi+x], nn
+                return true;
+
+            case OpClass::LD_Reg:
+                loadAl(op.y);
+                storeAl(op.x);
+                return true;
+
+            case OpClass::OR:
+                loadAl(op.x);
+                emit({0x0a, 0x47, op.y}); // or al, [rdi+y]
+                storeAl(op.x);
+                return true;
+
+            case OpClass::AND:
+                loadAl(op.x);
+                emit({0x22, 0x47, op.y}); // and al, [rdi+y]
+                storeAl(op.x);
+                return true;
+
+            case OpClass::XOR:
+                loadAl(op.x);
+                emit({0x32, 0x47, op.y}); // xor al, [rdi+y]
+                storeAl(op.x);
+                return true;
+
+            case OpClass::ADD_Reg:
+                // The interpreter calculates the carry from the already updated Vx,
+                // do the same, so the two engines agree.
+                loadAl(op.x);
+                emit({0x02, 0x47, op.y}); // add al, [rdi+y]
+                storeAl(op.x);
+                loadCl(op.y);
+                emit({0xb0, 0xff}); // mov al, 0xff
+                emit({0x2a, 0x47, op.x}); // sub al, [rdi+x]
+                emit({0x38, 0xc1}); // cmp cl, al
+                emit({0x0f, 0x97, 0xc0}); // seta al
+                storeAl(0xf);
+                return true;
+
+            case OpClass::SUB:
+                loadAl(op.x);
+                emit({0x3a, 0x47, op.y}); // cmp al, [rdi+y]
+                emit({0x0f, 0x93, 0xc1}); // setae cl
+                storeCl(0xf);
+                loadAl(op.x);
+                emit({0x2a, 0x47, op.y}); // sub al, [rdi+y]
+                storeAl(op.x);
+                return true;
+
+            case OpClass::SUBN:
+                loadAl(op.x);
+                emit({0x3a, 0x47, op.y}); // cmp al, [rdi+y]
+                emit({0x0f, 0x96, 0xc1}); // setbe cl
+                storeCl(0xf);
+                loadAl(op.y);
+                emit({0x2a, 0x47, op.x}); // sub al, [rdi+x]
+                storeAl(op.x);
+                return true;
+
+            case OpClass::SHR:
+                loadAl(op.x);
+                emit({0x24, 0x01}); // and al, 1
+                storeAl(0xf);
+                loadAl(shiftYReg ? op.y : op.x);
+                emit({0xd0, 0xe8}); // shr al, 1
+                storeAl(op.x);
+                return true;
+
+            case OpClass::SHL:
+                loadAl(op.x);
+                emit({0xc0, 0xe8, 0x07}); // shr al, 7
+                storeAl(0xf);
+                loadAl(shiftYReg ? op.y : op.x);
+                emit({0x00, 0xc0}); // add al, al
+                storeAl(op.x);
+                return true;
+
+            case OpClass::LD_I:
+                emit({0x66, 0xc7, 0x06, uint8_t(op.nnn), uint8_t(op.nnn >> 8)}); // mov word [rsi], nnn
+                return true;
+
+            case OpClass::ADD_I:
+                emit({0x0f, 0xb6, 0x47, op.x}); // movzx eax, byte [rdi+x]
+                emit({0x66, 0x01, 0x06}); // add [rsi], ax
+                return true;
+
+            case OpClass::LD_F:
+                emit({0x0f, 0xb6, 0x47, op.x}); // movzx eax, byte [rdi+x]
+                emit({0x8d, 0x04, 0x80}); // lea eax, [rax+rax*4]
+                emit({0x66, 0x89, 0x06}); // mov [rsi], ax
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    /*
+     * Emits an instruction that ends the block.
+     * `nextPc` is the address after the instruction.
+     * Returns false if it can't be translated.
+     */
+    bool emitBranch(const DecodedOp& op, uint16_t nextPc)
+    {
+        switch (op.opClass)
+        {
+            case OpClass::JP:
+                movEax(op.nnn);
+                ret();
+                return true;
+
+            case OpClass::SE_Imm:
+                emit({0x80, 0x7f, op.x, op.nn}); // cmp byte [rdi+x], nn
+                skipAndReturn(0x75 /*jne*/, nextPc);
+                return true;
+
+            case OpClass::SNE_Imm:
+                emit({0x80, 0x7f, op.x, op.nn}); // cmp byte [rdi+x], nn
+                skipAndReturn(0x74 /*je*/, nextPc);
+                return true;
+
+            case OpClass::SE_Reg:
+                loadCl(op.x);
+                emit({0x3a, 0x4f, op.y}); // cmp cl, [rdi+y]
+                skipAndReturn(0x75 /*jne*/, nextPc);
+                return true;
+
+            case OpClass::SNE_Reg:
+                loadCl(op.x);
+                emit({0x3a, 0x4f, op.y}); // cmp cl, [rdi+y]
+                skipAndReturn(0x74 /*je*/, nextPc);
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    void emitReturn(uint16_t pc)
+    {
+        movEax(pc);
+        ret();
+    }
+};
+
+} // End of namespace
+
+Chip8Jit::Chip8Jit(Chip8Core& core)
+    : m_core{core}
+{
+    void* buffer = mmap(nullptr, CODE_BUFFER_SIZE,
+            PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+        AsyncLog::error("JIT: Failed to allocate executable memory, falling back to the interpreter");
+        return;
+    }
+    m_codeBuffer = static_cast<uint8_t*>(buffer);
+    m_codeBufferSize = CODE_BUFFER_SIZE;
+}
+
+Chip8Jit::~Chip8Jit()
+{
+    if (m_codeBuffer)
+        munmap(m_codeBuffer, m_codeBufferSize);
+}
+
+bool Chip8Jit::translate(uint16_t startPc)
+{
+    const uint8_t* memory = m_core.m_memory;
+
+    Emitter emitter;
+    uint16_t pc = startPc;
+    int instructionCount{};
+    uint16_t lastOpcode{};
+    bool hasBranch{};
+    while (instructionCount < MAX_BLOCK_INSTRUCTIONS && pc <= 0xffe)
+    {
+        const DecodedOp op = decodeOpcode((memory[pc] << 8) | memory[pc + 1]);
+
+        if (emitter.emitStraight(op, m_core.m_compat_shiftYRegInsteadOfX))
+        {
+        }
+        else if (emitter.emitBranch(op, pc + 2))
+        {
+            hasBranch = true;
+        }
+        else
+        {
+            // Leave it to the interpreter
+            break;
+        }
+
+        lastOpcode = op.opcode;
+        pc += 2;
+        ++instructionCount;
+
+        if (hasBranch)
+            break;
+    }
+
+    if (instructionCount == 0)
+    {
+        m_isInterpretOnly[startPc] = true;
+        return false;
+    }
+
+    if (!hasBranch)
+        emitter.emitReturn(pc);
+
+    const auto& code = emitter.getCode();
+    if (m_codeBufferUsed + code.size() > m_codeBufferSize)
+    {
+        // Out of space, start over
+        for (auto& block : m_blocks)
+            block = {};
+        m_isTranslated.reset();
+        m_codeBufferUsed = 0;
+    }
+
+    uint8_t* dest = m_codeBuffer + m_codeBufferUsed;
+    std::memcpy(dest, code.data(), code.size());
+    m_codeBufferUsed += code.size();
+
+    Block& block = m_blocks[startPc];
+    block.fn = reinterpret_cast<BlockFn>(dest);
+    block.instructionCount = instructionCount;
+    block.lastOpcode = lastOpcode;
+
+    for (int i{startPc}; i < pc; ++i)
+        m_isTranslated[i] = true;
+
+    return true;
+}
+
+int Chip8Jit::runBlock(int maxCycles)
+{
+    const uint16_t pc = m_core.m_pc;
+    if (pc > 0xffe || m_isInterpretOnly[pc])
+        return 0;
+
+    Block& block = m_blocks[pc];
+    if (!block.fn && !translate(pc))
+        return 0;
+
+    if (block.instructionCount > maxCycles)
+        return 0;
+
+    m_core.m_pc = block.fn(m_core.m_registers.getData(), &m_core.m_indexReg);
+    m_core.m_opcode = block.lastOpcode;
+    m_core.advanceTimers(block.instructionCount);
+
+    return block.instructionCount;
+}
+
+void Chip8Jit::invalidateBlocksAt(int address)
+{
+    m_isTranslated.reset();
+    for (int start{}; start <= 0xfff; ++start)
+    {
+        Block& block = m_blocks[start];
+        if (!block.fn)
+            continue;
+
+        const int end = start + block.instructionCount * 2;
+        if (address >= start && address < end)
+        {
+            // Self-modifying code, don't bother translating it again
+            block = {};
+            m_isInterpretOnly[start] = true;
+            continue;
+        }
+
+        for (int i{start}; i < end; ++i)
+            m_isTranslated[i] = true;
+    }
+}
+
+void Chip8Jit::flush()
+{
+    for (auto& block : m_blocks)
+        block = {};
+    m_isInterpretOnly.reset();
+    m_isTranslated.reset();
+    m_codeBufferUsed = 0;
+}
+
+#endif // CHIP8_HAS_JIT
@@ -0,0 +1,89 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <bitset>
+
+// The JIT emits x86-64 machine code and needs `mmap()` for executable memory
+#if !defined(CHIP8_NO_JIT) && defined(__x86_64__) && defined(__unix__)
+#define CHIP8_HAS_JIT 1
+#else
+#define CHIP8_HAS_JIT 0
+#endif
+
+class Chip8Core;
+
+/*
+ * Translates basic blocks of CHIP-8 instructions to native x86-64 code
+ * and caches them by their starting address.
+ *
+ * A block is a run of register/ALU instructions, optionally ended by a
+ * jump or a skip. Everything else (calls, `DRW`, input, timers, memory
+ * access, `Fx0A`...) ends the block and is executed by the interpreter.
+ *
+ * Translated instructions don't update the register access flags
+ * shown by the debugger.
+ */
+class Chip8Jit final
+{
+private:
+    // Takes the registers and the index register, returns the new PC
+    using BlockFn = uint32_t (*)(uint8_t* registers, uint16_t* indexReg);
+
+    struct Block
+    {
+        BlockFn fn{};
+        uint16_t instructionCount{};
+        uint16_t lastOpcode{};
+    };
+
+    Chip8Core& m_core;
+
+    uint8_t* m_codeBuffer{};
+    size_t m_codeBufferSize{};
+    size_t m_codeBufferUsed{};
+
+    Block m_blocks[0xfff+1]{};
+    // The addresses where we don't even try to translate.
+    // Set when the block starting here was overwritten or the first instruction can't be translated.
+    std::bitset<0xfff+1> m_isInterpretOnly;
+    // The bytes that belong to a translated block
+    std::bitset<0xfff+1> m_isTranslated;
+
+    bool translate(uint16_t startPc);
+
+public:
+    Chip8Jit(Chip8Core& core);
+    ~Chip8Jit();
+
+    /*
+     * Returns false if no executable memory could be allocated.
+     */
+    inline bool isUsable() const { return m_codeBuffer; }
+
+    /*
+     * Executes the block at the PC if it fits in `maxCycles`.
+     * Returns the number of executed instructions,
+     * 0 if the interpreter needs to execute the next instruction.
+     */
+    int runBlock(int maxCycles);
+
+    /*
+     * Needs to be called when the memory at `address` is written.
+     * The blocks containing it are dropped and left to the interpreter.
+     */
+    inline void invalidate(int address)
+    {
+        if (m_isTranslated[address])
+            invalidateBlocksAt(address);
+    }
+    void invalidateBlocksAt(int address);
+
+    /*
+     * Drops every block, for example after a ROM is loaded.
+     */
+    void flush();
+};
+
+#endif // JIT_H
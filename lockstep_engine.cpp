@@ -0,0 +1,779 @@
+#include "lockstep_engine.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include "chip8core.h"
+#include "fontset.h"
+#include "rng.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LOCKSTEP_HAS_AVX2_KERNEL 1
+#include <immintrin.h>
+#else
+#define LOCKSTEP_HAS_AVX2_KERNEL 0
+#endif
+
+#if LOCKSTEP_HAS_AVX2_KERNEL
+namespace
+{
+
+/*
+ * Returns a vector with 0xff in the bytes of the lanes set in `mask`.
+ */
+__attribute__((target("avx2")))
+inline __m256i expandLaneMask(uint32_t mask)
+{
+    // Byte N gets byte N/8 of the mask, then tests bit N%8 of it
+    const __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(mask), _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3));
+    const __m256i bits = _mm256_set1_epi64x(0x8040201008040201);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+}
+
+__attribute__((target("avx2")))
+inline __m256i load8(const uint8_t* values)
+{
+    return _mm256_loadu_si256((const __m256i*)values);
+}
+
+/*
+ * Stores the bytes of the lanes set in `laneMask`.
+ */
+__attribute__((target("avx2")))
+inline void store8(uint8_t* values, __m256i newValues, __m256i laneMask)
+{
+    _mm256_storeu_si256((__m256i*)values, _mm256_blendv_epi8(load8(values), newValues, laneMask));
+}
+
+/*
+ * Stores 32 16-bit values, `low` has the first 16, `high` has the rest.
+ */
+__attribute__((target("avx2")))
+inline void store16(uint16_t* values, __m256i low, __m256i high, __m256i laneMask)
+{
+    const __m256i lowMask = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(laneMask));
+    const __m256i highMask = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(laneMask, 1));
+    __m256i* lowPtr = (__m256i*)values;
+    __m256i* highPtr = (__m256i*)(values + 16);
+    _mm256_storeu_si256(lowPtr, _mm256_blendv_epi8(_mm256_loadu_si256(lowPtr), low, lowMask));
+    _mm256_storeu_si256(highPtr, _mm256_blendv_epi8(_mm256_loadu_si256(highPtr), high, highMask));
+}
+
+/*
+ * Adds the zero-extended bytes of `bytes` to 32 16-bit values, multiplied by `factor`.
+ */
+__attribute__((target("avx2")))
+inline void add16(uint16_t* values, __m256i bytes, int factor, __m256i laneMask)
+{
+    const __m256i multiplier = _mm256_set1_epi16(factor);
+    const __m256i low = _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)), multiplier);
+    const __m256i high = _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)), multiplier);
+    store16(values,
+            _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)values), low),
+            _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(values + 16)), high),
+            laneMask);
+}
+
+/*
+ * 0xff where a > b, unsigned.
+ */
+__attribute__((target("avx2")))
+inline __m256i greaterThan8(__m256i a, __m256i b)
+{
+    return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b), _mm256_set1_epi8(-1));
+}
+
+/*
+ * 1 where the byte of `mask` is set, 0 elsewhere.
+ */
+__attribute__((target("avx2")))
+inline __m256i toFlag(__m256i mask)
+{
+    return _mm256_and_si256(mask, _mm256_set1_epi8(1));
+}
+
+} // End of namespace
+#endif // LOCKSTEP_HAS_AVX2_KERNEL
+
+/*
+ * The instruction handlers.
+ * They do the same as `Chip8Core::Ops`, in the same order, so the flags come out
+ * the same when VF is an operand, too.
+ */
+struct LockstepEngine::Ops
+{
+    static void executeLane(LockstepEngine& e, const DecodedOp& op, int lane)
+    {
+        switch (op.opClass)
+        {
+        case OpClass::Invalid:
+            e.panic(lane, "Invalid opcode.");
+            break;
+
+        case OpClass::NOP:
+            break;
+
+        case OpClass::CLS:
+            for (int y{}; y < 32; ++y)
+                e.m_frameBuffers[y * e.m_stride + lane] = 0;
+            break;
+
+        case OpClass::RET:
+        {
+            // The stack pointer is 4 bits, it wraps around
+            const int top = (e.m_sp[lane] - 1) & 0xf;
+            e.m_pc[lane] = e.m_stack[top * e.m_stride + lane];
+            e.m_stack[top * e.m_stride + lane] = 0;
+            e.m_sp[lane] = top;
+            break;
+        }
+
+        case OpClass::JP:
+            e.m_pc[lane] = op.nnn;
+            break;
+
+        case OpClass::CALL:
+            e.m_stack[e.m_sp[lane] * e.m_stride + lane] = e.m_pc[lane];
+            e.m_sp[lane] = (e.m_sp[lane] + 1) & 0xf;
+            e.m_pc[lane] = op.nnn;
+            break;
+
+        case OpClass::SE_Imm:
+            if (e.reg(lane, op.x) == op.nn)
+                e.m_pc[lane] += 2;
+            break;
+
+        case OpClass::SNE_Imm:
+            if (e.reg(lane, op.x) != op.nn)
+                e.m_pc[lane] += 2;
+            break;
+
+        case OpClass::SE_Reg:
+            if (e.reg(lane, op.x) == e.reg(lane, op.y))
+                e.m_pc[lane] += 2;
+            break;
+
+        case OpClass::LD_Imm:
+            e.reg(lane, op.x) = op.nn;
+            break;
+
+        case OpClass::ADD_Imm:
+            e.reg(lane, op.x) += op.nn;
+            break;
+
+        case OpClass::LD_Reg:
+            e.reg(lane, op.x) = e.reg(lane, op.y);
+            break;
+
+        case OpClass::OR:
+            e.reg(lane, op.x) |= e.reg(lane, op.y);
+            break;
+
+        case OpClass::AND:
+            e.reg(lane, op.x) &= e.reg(lane, op.y);
+            break;
+
+        case OpClass::XOR:
+            e.reg(lane, op.x) ^= e.reg(lane, op.y);
+            break;
+
+        case OpClass::ADD_Reg:
+            e.reg(lane, op.x) += e.reg(lane, op.y);
+            // Checked with the new value of Vx, like the interpreter does
+            e.reg(lane, 0xf) = e.reg(lane, op.y) > (0xff - e.reg(lane, op.x));
+            break;
+
+        case OpClass::SUB:
+            e.reg(lane, 0xf) = !(e.reg(lane, op.x) < e.reg(lane, op.y));
+            e.reg(lane, op.x) -= e.reg(lane, op.y);
+            break;
+
+        case OpClass::SHR:
+            e.reg(lane, 0xf) = e.reg(lane, op.x) & 1;
+            e.reg(lane, op.x) = e.reg(lane, e.m_compat_shiftYRegInsteadOfX ? op.y : op.x) >> 1;
+            break;
+
+        case OpClass::SUBN:
+            e.reg(lane, 0xf) = !(e.reg(lane, op.x) > e.reg(lane, op.y));
+            e.reg(lane, op.x) = e.reg(lane, op.y) - e.reg(lane, op.x);
+            break;
+
+        case OpClass::SHL:
+            e.reg(lane, 0xf) = e.reg(lane, op.x) >> 7;
+            e.reg(lane, op.x) = e.reg(lane, e.m_compat_shiftYRegInsteadOfX ? op.y : op.x) << 1;
+            break;
+
+        case OpClass::SNE_Reg:
+            if (e.reg(lane, op.x) != e.reg(lane, op.y))
+                e.m_pc[lane] += 2;
+            break;
+
+        case OpClass::LD_I:
+            e.m_indexReg[lane] = op.nnn;
+            break;
+
+        case OpClass::JP_V0:
+            e.m_pc[lane] = e.reg(lane, 0) + op.nnn;
+            break;
+
+        case OpClass::RND:
+            e.reg(lane, op.x) = op.nn & Rng::nextByte(e.m_randomState[lane]);
+            break;
+
+        case OpClass::DRW:
+        {
+            const int spriteX = e.reg(lane, op.x) % 64;
+            const int spriteY = e.reg(lane, op.y) % 32;
+            const int indexReg = e.m_indexReg[lane];
+            if (indexReg + op.n >= 0xfff)
+            {
+                e.panic(lane, "Invalid sprite address/height");
+                break;
+            }
+
+            bool isCollision{};
+            for (int row{}; row < op.n; ++row)
+            {
+                uint64_t& pixels = e.m_frameBuffers[((spriteY + row) % 32) * e.m_stride + lane];
+                const uint64_t bits = (uint64_t(e.readMemory(lane, indexReg + row)) << 56) >> spriteX;
+                isCollision |= (pixels & bits) != 0;
+                pixels ^= bits;
+            }
+            e.reg(lane, 0xf) = isCollision;
+            break;
+        }
+
+        case OpClass::SKP:
+            if ((e.m_keyStates[lane] >> (e.reg(lane, op.x) & 0xf)) & 1)
+                e.m_pc[lane] += 2;
+            break;
+
+        case OpClass::SKNP:
+            if (!((e.m_keyStates[lane] >> (e.reg(lane, op.x) & 0xf)) & 1))
+                e.m_pc[lane] += 2;
+            break;
+
+        case OpClass::LD_Vx_DT:
+            e.reg(lane, op.x) = e.m_delayTimer[lane];
+            break;
+
+        case OpClass::LD_Vx_K:
+            e.m_keyWaitRegister[lane] = op.x;
+            break;
+
+        case OpClass::LD_DT_Vx:
+            e.m_delayTimer[lane] = e.reg(lane, op.x);
+            break;
+
+        case OpClass::LD_ST_Vx:
+            e.m_soundTimer[lane] = e.reg(lane, op.x);
+            break;
+
+        case OpClass::ADD_I:
+            e.m_indexReg[lane] += e.reg(lane, op.x);
+            break;
+
+        case OpClass::LD_F:
+            e.m_indexReg[lane] = e.reg(lane, op.x) * 5;
+            break;
+
+        case OpClass::LD_B:
+        {
+            const uint8_t number = e.reg(lane, op.x);
+            e.writeMemory(lane, e.m_indexReg[lane], number / 100);
+            e.writeMemory(lane, e.m_indexReg[lane] + 1, (number / 10) % 10);
+            e.writeMemory(lane, e.m_indexReg[lane] + 2, number % 10);
+            break;
+        }
+
+        case OpClass::LD_Mem_Vx:
+            for (int i{}; i <= op.x; ++i)
+                e.writeMemory(lane, e.m_indexReg[lane] + i, e.reg(lane, i));
+            if (e.m_compat_incIAfterRegFillLoad)
+                e.m_indexReg[lane] += op.x + 1;
+            break;
+
+        case OpClass::LD_Vx_Mem:
+            for (int i{}; i <= op.x; ++i)
+                e.reg(lane, i) = e.readMemory(lane, e.m_indexReg[lane] + i);
+            if (e.m_compat_incIAfterRegFillLoad)
+                e.m_indexReg[lane] += op.x + 1;
+            break;
+
+        case OpClass::Count:
+            assert(false);
+            break;
+        }
+    }
+
+    static void executeGroupScalar(LockstepEngine& e, const DecodedOp& op, int base, uint32_t mask)
+    {
+        for (; mask; mask &= mask - 1)
+            executeLane(e, op, base + __builtin_ctz(mask));
+    }
+
+#if LOCKSTEP_HAS_AVX2_KERNEL
+    /*
+     * Executes the register, skip and jump instructions on a whole block.
+     */
+    __attribute__((target("avx2")))
+    static bool executeGroupAvx2(LockstepEngine& e, const DecodedOp& op, int base, uint32_t mask)
+    {
+        const __m256i laneMask = expandLaneMask(mask);
+        uint8_t* const vx = &e.m_registers[op.x * e.m_stride + base];
+        uint8_t* const vy = &e.m_registers[op.y * e.m_stride + base];
+        uint8_t* const vf = &e.m_registers[0xf * e.m_stride + base];
+        uint8_t* const shiftSource = e.m_compat_shiftYRegInsteadOfX ? vy : vx;
+        uint16_t* const pc = &e.m_pc[base];
+        uint16_t* const indexReg = &e.m_indexReg[base];
+
+        // The condition of the skips
+        __m256i isTaken;
+        switch (op.opClass)
+        {
+        case OpClass::NOP:
+            return true;
+
+        case OpClass::JP:
+            store16(pc, _mm256_set1_epi16(op.nnn), _mm256_set1_epi16(op.nnn), laneMask);
+            return true;
+
+        case OpClass::SE_Imm:
+            isTaken = _mm256_cmpeq_epi8(load8(vx), _mm256_set1_epi8(op.nn));
+            break;
+
+        case OpClass::SNE_Imm:
+            isTaken = _mm256_xor_si256(_mm256_cmpeq_epi8(load8(vx), _mm256_set1_epi8(op.nn)), _mm256_set1_epi8(-1));
+            break;
+
+        case OpClass::SE_Reg:
+            isTaken = _mm256_cmpeq_epi8(load8(vx), load8(vy));
+            break;
+
+        case OpClass::SNE_Reg:
+            isTaken = _mm256_xor_si256(_mm256_cmpeq_epi8(load8(vx), load8(vy)), _mm256_set1_epi8(-1));
+            break;
+
+        case OpClass::LD_Imm:
+            store8(vx, _mm256_set1_epi8(op.nn), laneMask);
+            return true;
+
+        case OpClass::ADD_Imm:
+            store8(vx, _mm256_add_epi8(load8(vx), _mm256_set1_epi8(op.nn)), laneMask);
+            return true;
+
+        case OpClass::LD_Reg:
+            store8(vx, load8(vy), laneMask);
+            return true;
+
+        case OpClass::OR:
+            store8(vx, _mm256_or_si256(load8(vx), load8(vy)), laneMask);
+            return true;
+
+        case OpClass::AND:
+            store8(vx, _mm256_and_si256(load8(vx), load8(vy)), laneMask);
+            return true;
+
+        case OpClass::XOR:
+            store8(vx, _mm256_xor_si256(load8(vx), load8(vy)), laneMask);
+            return true;
+
+        case OpClass::ADD_Reg:
+            store8(vx, _mm256_add_epi8(load8(vx), load8(vy)), laneMask);
+            // Vy > 0xff - Vx, with the new Vx
+            store8(vf, toFlag(greaterThan8(load8(vy), _mm256_xor_si256(load8(vx), _mm256_set1_epi8(-1)))), laneMask);
+            return true;
+
+        case OpClass::SUB:
+        {
+            // Vx >= Vy
+            const __m256i x = load8(vx);
+            store8(vf, toFlag(_mm256_cmpeq_epi8(_mm256_max_epu8(x, load8(vy)), x)), laneMask);
+            store8(vx, _mm256_sub_epi8(load8(vx), load8(vy)), laneMask);
+            return true;
+        }
+
+        case OpClass::SHR:
+            store8(vf, toFlag(load8(vx)), laneMask);
+            // There is no 8-bit shift, the bits shifted in from the next byte are masked out
+            store8(vx, _mm256_and_si256(_mm256_srli_epi16(load8(shiftSource), 1), _mm256_set1_epi8(0x7f)), laneMask);
+            return true;
+
+        case OpClass::SUBN:
+        {
+            // Vx <= Vy
+            const __m256i y = load8(vy);
+            store8(vf, toFlag(_mm256_cmpeq_epi8(_mm256_max_epu8(load8(vx), y), y)), laneMask);
+            store8(vx, _mm256_sub_epi8(load8(vy), load8(vx)), laneMask);
+            return true;
+        }
+
+        case OpClass::SHL:
+        {
+            store8(vf, toFlag(_mm256_srli_epi16(load8(vx), 7)), laneMask);
+            const __m256i source = load8(shiftSource);
+            store8(vx, _mm256_add_epi8(source, source), laneMask);
+            return true;
+        }
+
+        case OpClass::LD_I:
+            store16(indexReg, _mm256_set1_epi16(op.nnn), _mm256_set1_epi16(op.nnn), laneMask);
+            return true;
+
+        case OpClass::ADD_I:
+            add16(indexReg, load8(vx), 1, laneMask);
+            return true;
+
+        case OpClass::LD_F:
+            store16(indexReg, _mm256_setzero_si256(), _mm256_setzero_si256(), laneMask);
+            add16(indexReg, load8(vx), 5, laneMask);
+            return true;
+
+        case OpClass::LD_Vx_DT:
+            store8(vx, load8(&e.m_delayTimer[base]), laneMask);
+            return true;
+
+        case OpClass::LD_DT_Vx:
+            store8(&e.m_delayTimer[base], load8(vx), laneMask);
+            return true;
+
+        case OpClass::LD_ST_Vx:
+            store8(&e.m_soundTimer[base], load8(vx), laneMask);
+            return true;
+
+        default:
+            return false;
+        }
+
+        // A skip, add 2 to the PC of the lanes that take it
+        add16(pc, toFlag(_mm256_and_si256(isTaken, laneMask)), 2, laneMask);
+        return true;
+    }
+
+    __attribute__((target("avx2")))
+    static uint32_t findLowestPcLanesAvx2(const uint16_t* pcs, uint32_t lanes)
+    {
+        const __m256i laneMask = expandLaneMask(lanes);
+        const __m256i lowMask = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(laneMask));
+        const __m256i highMask = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(laneMask, 1));
+        // The PC of the other lanes is taken as 0xffff
+        const __m256i low = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)pcs), _mm256_xor_si256(lowMask, _mm256_set1_epi8(-1)));
+        const __m256i high = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(pcs + 16)), _mm256_xor_si256(highMask, _mm256_set1_epi8(-1)));
+
+        const __m256i min16 = _mm256_min_epu16(low, high);
+        const __m128i min8 = _mm_min_epu16(_mm256_castsi256_si128(min16), _mm256_extracti128_si256(min16, 1));
+        const __m256i minPc = _mm256_set1_epi16(_mm_extract_epi16(_mm_minpos_epu16(min8), 0));
+
+        const __m256i isLowLowest = _mm256_and_si256(_mm256_cmpeq_epi16(low, minPc), lowMask);
+        const __m256i isHighLowest = _mm256_and_si256(_mm256_cmpeq_epi16(high, minPc), highMask);
+        // Packing works in 128-bit halves, the 64-bit parts have to be put in order
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(isLowLowest, isHighLowest), 0xd8);
+        return _mm256_movemask_epi8(packed);
+    }
+#endif // LOCKSTEP_HAS_AVX2_KERNEL
+
+    static uint32_t findLowestPcLanesScalar(const uint16_t* pcs, uint32_t lanes)
+    {
+        uint16_t minPc = 0xffff;
+        for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+            minPc = std::min(minPc, pcs[__builtin_ctz(bits)]);
+
+        uint32_t result{};
+        for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+        {
+            const int index = __builtin_ctz(bits);
+            result |= uint32_t(pcs[index] == minPc) << index;
+        }
+        return result;
+    }
+};
+
+LockstepEngine::LockstepEngine(int laneCount)
+    : m_laneCount{laneCount}, m_stride{(laneCount + BLOCK_LANES - 1) / BLOCK_LANES * BLOCK_LANES}
+{
+    assert(laneCount > 0);
+
+    m_registers.resize(16 * m_stride);
+    m_pc.resize(m_stride);
+    m_opcode.resize(m_stride);
+    m_indexReg.resize(m_stride);
+    m_delayTimer.resize(m_stride);
+    m_soundTimer.resize(m_stride);
+    m_sp.resize(m_stride);
+    m_stack.resize(16 * m_stride);
+    m_frameBuffers.resize(32 * m_stride);
+    m_memory.resize((size_t)m_laneCount * 0x1000);
+    m_keyStates.resize(m_stride);
+    m_keyWaitRegister.resize(m_stride);
+    m_timerPhase.resize(m_stride);
+    m_cycleCount.resize(m_stride);
+    m_pendingCycles.resize(m_stride);
+    m_randomState.resize(m_stride);
+    m_hasPanicked.resize(m_stride);
+    m_panicMessages.resize(m_stride);
+
+    setSimdEnabled(true);
+    loadRom(nullptr, 0);
+}
+
+bool LockstepEngine::setSimdEnabled(bool enabled)
+{
+    m_groupKernel = nullptr;
+    m_lowestPcFinder = Ops::findLowestPcLanesScalar;
+    if (!enabled)
+        return true;
+
+#if LOCKSTEP_HAS_AVX2_KERNEL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        m_groupKernel = Ops::executeGroupAvx2;
+        m_lowestPcFinder = Ops::findLowestPcLanesAvx2;
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool LockstepEngine::loadRom(const uint8_t* data, size_t size)
+{
+    if (size > 0x1000 - 0x200)
+        return false;
+
+    std::fill(m_registers.begin(), m_registers.end(), 0);
+    std::fill(m_pc.begin(), m_pc.end(), 0x200);
+    std::fill(m_opcode.begin(), m_opcode.end(), 0);
+    std::fill(m_indexReg.begin(), m_indexReg.end(), 0);
+    std::fill(m_delayTimer.begin(), m_delayTimer.end(), 0);
+    std::fill(m_soundTimer.begin(), m_soundTimer.end(), 0);
+    std::fill(m_sp.begin(), m_sp.end(), 0);
+    std::fill(m_stack.begin(), m_stack.end(), 0);
+    std::fill(m_frameBuffers.begin(), m_frameBuffers.end(), 0);
+    std::fill(m_keyStates.begin(), m_keyStates.end(), 0);
+    std::fill(m_keyWaitRegister.begin(), m_keyWaitRegister.end(), -1);
+    std::fill(m_timerPhase.begin(), m_timerPhase.end(), 0);
+    std::fill(m_cycleCount.begin(), m_cycleCount.end(), 0);
+    std::fill(m_pendingCycles.begin(), m_pendingCycles.end(), 0);
+    std::fill(m_hasPanicked.begin(), m_hasPanicked.end(), false);
+    std::fill(m_panicMessages.begin(), m_panicMessages.end(), std::string{});
+
+    uint8_t program[0x1000]{};
+    std::memcpy(program, fontset, 80);
+    if (size)
+        std::memcpy(program + 0x200, data, size);
+    for (int address{}; address < 0xfff; ++address)
+        m_programOps[address] = decodeOpcode((program[address] << 8) | program[address + 1]);
+    std::memset(m_writtenMemory, 0, sizeof(m_writtenMemory));
+
+    for (int lane{}; lane < m_laneCount; ++lane)
+    {
+        std::memcpy(&m_memory[(size_t)lane * 0x1000], program, 0x1000);
+        setRandomSeed(lane, lane);
+    }
+    return true;
+}
+
+void LockstepEngine::setInstructionsPerSecond(int value)
+{
+    assert(value > 0);
+    m_instructionsPerSecond = value;
+    std::fill(m_timerPhase.begin(), m_timerPhase.end(), 0);
+}
+
+void LockstepEngine::setRandomSeed(int lane, uint64_t seed)
+{
+    assert(lane >= 0 && lane < m_laneCount);
+    m_randomState[lane] = Rng::seedToState(seed);
+}
+
+void LockstepEngine::setKeyStates(int lane, uint16_t states)
+{
+    assert(lane >= 0 && lane < m_laneCount);
+
+    // A newly pressed key finishes the wait of `Fx0A`, the lowest one first
+    const uint16_t pressed = states & ~m_keyStates[lane];
+    if (pressed && m_keyWaitRegister[lane] != -1)
+    {
+        reg(lane, m_keyWaitRegister[lane]) = __builtin_ctz(pressed);
+        m_keyWaitRegister[lane] = -1;
+    }
+    m_keyStates[lane] = states;
+}
+
+void LockstepEngine::panic(int lane, const std::string& message)
+{
+    // Not logged, it could happen to thousands of lanes at once
+    m_hasPanicked[lane] = true;
+    m_panicMessages[lane] = message;
+}
+
+void LockstepEngine::flushCycles(int base, uint32_t lanes)
+{
+    for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+    {
+        const int lane = base + __builtin_ctz(bits);
+        const uint32_t cycles = m_pendingCycles[lane];
+        if (!cycles)
+            continue;
+        m_pendingCycles[lane] = 0;
+        m_cycleCount[lane] += cycles;
+
+        // Like `Chip8Core::advanceTimers()`
+        m_timerPhase[lane] += (uint64_t)cycles * Chip8Core::TIMER_FREQUENCY;
+        if (m_timerPhase[lane] < (uint64_t)m_instructionsPerSecond)
+            continue;
+
+        const int ticks = std::min<uint64_t>(m_timerPhase[lane] / m_instructionsPerSecond, 0xff);
+        m_timerPhase[lane] %= m_instructionsPerSecond;
+        m_delayTimer[lane] = m_delayTimer[lane] > ticks ? m_delayTimer[lane] - ticks : 0;
+        m_soundTimer[lane] = m_soundTimer[lane] > ticks ? m_soundTimer[lane] - ticks : 0;
+    }
+}
+
+uint32_t LockstepEngine::getLiveLanes(int base) const
+{
+    const int end = std::min(base + BLOCK_LANES, m_laneCount);
+    uint32_t lanes{};
+    for (int lane{base}; lane < end; ++lane)
+        lanes |= uint32_t(!m_hasPanicked[lane] & (m_keyWaitRegister[lane] == -1)) << (lane - base);
+    return lanes;
+}
+
+uint32_t LockstepEngine::executeInstruction(int base, uint32_t lanes)
+{
+    assert(lanes);
+
+    bool isPcShared = true;
+    const uint16_t sharedPc = m_pc[base + __builtin_ctz(lanes)];
+    for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+        isPcShared &= m_pc[base + __builtin_ctz(bits)] == sharedPc;
+
+    if (isPcShared && sharedPc <= 0xffe && !isMemoryWritten(sharedPc) && !isMemoryWritten(sharedPc + 1))
+    {
+        // Fast path: every lane is at the same unmodified instruction
+        const DecodedOp& op = m_programOps[sharedPc];
+        for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+        {
+            const int lane = base + __builtin_ctz(bits);
+            m_opcode[lane] = op.opcode;
+            m_pc[lane] = sharedPc + 2;
+        }
+
+        executeGroup(op, base, lanes);
+    }
+    else
+    {
+        // Fetch every lane
+        const DecodedOp* ops[BLOCK_LANES];
+        // For the lanes that run modified code
+        DecodedOp decodedOps[BLOCK_LANES];
+        for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+        {
+            const int index = __builtin_ctz(bits);
+            const int lane = base + index;
+            const uint16_t pc = m_pc[lane];
+            if (pc > 0xffe)
+            {
+                panic(lane, "PC out of range");
+                lanes &= ~(uint32_t(1) << index);
+                continue;
+            }
+            if (!isMemoryWritten(pc) && !isMemoryWritten(pc + 1))
+            {
+                ops[index] = &m_programOps[pc];
+            }
+            else
+            {
+                decodedOps[index] = decodeOpcode((readMemory(lane, pc) << 8) | readMemory(lane, pc + 1));
+                ops[index] = &decodedOps[index];
+            }
+            m_opcode[lane] = ops[index]->opcode;
+            m_pc[lane] = pc + 2;
+        }
+
+        // Execute the lanes with the same opcode together
+        uint32_t remaining = lanes;
+        while (remaining)
+        {
+            const DecodedOp& op = *ops[__builtin_ctz(remaining)];
+            uint32_t group{};
+            for (uint32_t bits{remaining}; bits; bits &= bits - 1)
+            {
+                const int index = __builtin_ctz(bits);
+                if (ops[index]->opcode == op.opcode)
+                    group |= uint32_t(1) << index;
+            }
+            remaining &= ~group;
+
+            executeGroup(op, base, group);
+        }
+    }
+
+    for (uint32_t bits{lanes}; bits; bits &= bits - 1)
+    {
+        const int lane = base + __builtin_ctz(bits);
+        // The instruction that panicked doesn't count, like in `Chip8Core::emulateCycle()`
+        m_pendingCycles[lane] += !m_hasPanicked[lane];
+    }
+    return lanes;
+}
+
+void LockstepEngine::executeGroup(const DecodedOp& op, int base, uint32_t lanes)
+{
+    if (op.opClass == OpClass::LD_Vx_DT || op.opClass == OpClass::LD_DT_Vx || op.opClass == OpClass::LD_ST_Vx)
+        flushCycles(base, lanes);
+
+    if (!m_groupKernel || !m_groupKernel(*this, op, base, lanes))
+        Ops::executeGroupScalar(*this, op, base, lanes);
+}
+
+void LockstepEngine::runBlock(int base, int cycles)
+{
+    // The cycles left for every lane
+    int budgets[BLOCK_LANES];
+    std::fill(budgets, budgets + BLOCK_LANES, cycles);
+
+    const uint32_t liveLanes = getLiveLanes(base);
+    uint32_t activeLanes = liveLanes;
+    while (activeLanes)
+    {
+        // The lanes behind the others go first, so the ones that took a
+        // different branch get together again where the branches meet
+        const uint32_t group = m_lowestPcFinder(&m_pc[base], activeLanes);
+
+        const uint32_t executed = executeInstruction(base, group);
+        activeLanes &= ~(group & ~executed);
+
+        for (uint32_t bits{executed}; bits; bits &= bits - 1)
+        {
+            const int index = __builtin_ctz(bits);
+            const int lane = base + index;
+            // Like `emulateCycle()`, nothing happens after a panic or while waiting for a key
+            if (--budgets[index] == 0 || m_hasPanicked[lane] || m_keyWaitRegister[lane] != -1)
+                activeLanes &= ~(uint32_t(1) << index);
+        }
+    }
+
+    flushCycles(base, liveLanes);
+}
+
+void LockstepEngine::step()
+{
+    for (int base{}; base < m_laneCount; base += BLOCK_LANES)
+    {
+        if (const uint32_t lanes = getLiveLanes(base))
+            flushCycles(base, executeInstruction(base, lanes));
+    }
+}
+
+void LockstepEngine::run(int cycles)
+{
+    if (cycles <= 0)
+        return;
+
+    // A block is finished before the next one, so its state stays in the cache
+    for (int base{}; base < m_laneCount; base += BLOCK_LANES)
+        runBlock(base, cycles);
+}
@@ -0,0 +1,187 @@
+#ifndef LOCKSTEP_ENGINE_H
+#define LOCKSTEP_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "opcode.h"
+
+/*
+ * Runs many copies ("lanes") of the same program in lockstep.
+ *
+ * Every lane is a separate machine with its own input and random numbers,
+ * and a cycle of `step()` does the same to each as `Chip8Core::emulateCycle()`.
+ * The state is stored as structure-of-arrays: the values of a register (or the PC,
+ * a row of the framebuffer...) of all the lanes are next to each other.
+ *
+ * The lanes are processed in blocks of `BLOCK_LANES`. The lanes of a block that
+ * fetched the same opcode are executed together, the arithmetic, the skips and the
+ * jumps with AVX2 if the CPU supports it, the rest of the instructions lane by lane.
+ * The lanes that diverged form more groups, which are executed one after another.
+ * The input is the same during a `run()`, so it can let the groups of a block
+ * get out of step to meet again, see `runBlock()`.
+ *
+ * The lanes don't record the register accesses and don't use the JIT.
+ */
+class LockstepEngine final
+{
+public:
+    // One AVX2 vector holds a register of this many lanes
+    static constexpr int BLOCK_LANES = 32;
+
+private:
+    int m_laneCount{};
+    // `m_laneCount` rounded up to whole blocks, the distance of the values of two registers
+    int m_stride{};
+
+    // [register][lane]
+    std::vector<uint8_t> m_registers;
+    std::vector<uint16_t> m_pc;
+    std::vector<uint16_t> m_opcode;
+    std::vector<uint16_t> m_indexReg;
+    std::vector<uint8_t> m_delayTimer;
+    std::vector<uint8_t> m_soundTimer;
+    // 4 bits
+    std::vector<uint8_t> m_sp;
+    // [level][lane]
+    std::vector<uint16_t> m_stack;
+    // [row][lane], the leftmost pixel is the most significant bit like in `Framebuffer`
+    std::vector<uint64_t> m_frameBuffers;
+    // [lane][address], every lane can write its own memory
+    std::vector<uint8_t> m_memory;
+    // The memory after loading the ROM, decoded at every address
+    DecodedOp m_programOps[0xfff];
+    // One bit for every byte of the memory, set when any lane writes it.
+    // Where it is clear, the memory of every lane is the same as the loaded program.
+    uint64_t m_writtenMemory[(0xfff+1) / 64]{};
+    // Bit N is key N
+    std::vector<uint16_t> m_keyStates;
+    // The register `Fx0A` loads the next pressed key into, -1 if not waiting for a key
+    std::vector<int8_t> m_keyWaitRegister;
+    std::vector<uint64_t> m_timerPhase;
+    std::vector<uint64_t> m_cycleCount;
+    // The executed cycles not yet added to `m_cycleCount` and the timers, see `flushCycles()`
+    std::vector<uint32_t> m_pendingCycles;
+    std::vector<uint64_t> m_randomState;
+    std::vector<uint8_t> m_hasPanicked;
+    // Only set for the panicked lanes
+    std::vector<std::string> m_panicMessages;
+
+    // The same for every lane, like the program
+    int m_instructionsPerSecond = INSTRUCTIONS_PER_SECOND;
+    bool m_compat_shiftYRegInsteadOfX = true;
+    bool m_compat_incIAfterRegFillLoad = true;
+
+    // Executes an instruction on the lanes in `mask` of the block starting at `base`.
+    // Returns false if it doesn't handle the instruction.
+    using GroupKernel = bool (*)(LockstepEngine& engine, const DecodedOp& op, int base, uint32_t mask);
+    // nullptr if the SIMD kernel is disabled
+    GroupKernel m_groupKernel{};
+    // Returns the lanes in `lanes` with the lowest PC, `pcs` is the PC of the first lane of the block
+    using LowestPcFinder = uint32_t (*)(const uint16_t* pcs, uint32_t lanes);
+    LowestPcFinder m_lowestPcFinder{};
+
+    struct Ops;
+
+    inline uint8_t& reg(int lane, int index) { return m_registers[index * m_stride + lane]; }
+    inline uint8_t readMemory(int lane, int address) const { return m_memory[(size_t)lane * 0x1000 + (address & 0xfff)]; }
+    inline void writeMemory(int lane, int address, uint8_t value)
+    {
+        address &= 0xfff;
+        m_memory[(size_t)lane * 0x1000 + address] = value;
+        m_writtenMemory[address / 64] |= uint64_t(1) << (address % 64);
+    }
+    inline bool isMemoryWritten(int address) const { return (m_writtenMemory[address / 64] >> (address % 64)) & 1; }
+
+    void panic(int lane, const std::string& message);
+    /*
+     * Adds the pending cycles of `lanes` to their cycle count and lets their timers run for them.
+     * Adding them in one go gives the same timers as one by one, so this is only needed
+     * before an instruction uses the timers and when the caller gets back the control.
+     */
+    void flushCycles(int base, uint32_t lanes);
+
+    /*
+     * Returns the lanes of the block starting at `base` that can execute instructions,
+     * bit N is lane `base + N`.
+     */
+    uint32_t getLiveLanes(int base) const;
+    /*
+     * Fetches and executes an instruction on `lanes` of the block starting at `base`.
+     * Returns the lanes that executed it, the ones with a PC out of range panic instead.
+     */
+    uint32_t executeInstruction(int base, uint32_t lanes);
+    void executeGroup(const DecodedOp& op, int base, uint32_t lanes);
+    /*
+     * Executes `cycles` instructions on every lane of a block.
+     */
+    void runBlock(int base, int cycles);
+
+public:
+    LockstepEngine(int laneCount);
+
+    /*
+     * Resets every lane to the power-on state and copies the program to their memory at 0x200.
+     * Lane N gets the random seed N.
+     * Returns false if it doesn't fit in the memory.
+     */
+    bool loadRom(const uint8_t* data, size_t size);
+
+    /*
+     * Executes one instruction on every lane, like `Chip8Core::emulateCycle()`.
+     * The lanes that have panicked or wait for a keypress are left alone.
+     */
+    void step();
+    /*
+     * Leaves the lanes in the same state as calling `step()` `cycles` times.
+     *
+     * The lanes don't have to be at the same cycle inside the call, so it lets the lanes
+     * behind the others catch up, and the lanes that diverged can run together again.
+     */
+    void run(int cycles);
+
+    /*
+     * Enables or disables the AVX2 kernel.
+     * Returns false if the CPU doesn't support it.
+     */
+    bool setSimdEnabled(bool enabled);
+    inline bool isSimdEnabled() const { return m_groupKernel != nullptr; }
+
+    /*
+     * Like `Chip8Core::setRandomSeed()`.
+     */
+    void setRandomSeed(int lane, uint64_t seed);
+    /*
+     * Like `Chip8Core::setKeyStates()`.
+     */
+    void setKeyStates(int lane, uint16_t states);
+
+    /*
+     * Like `Chip8Core::setInstructionsPerSecond()`, for every lane.
+     */
+    void setInstructionsPerSecond(int value);
+    inline void setCompatShiftYRegInsteadOfX(bool value) { m_compat_shiftYRegInsteadOfX = value; }
+    inline void setCompatIncIAfterRegFillLoad(bool value) { m_compat_incIAfterRegFillLoad = value; }
+
+    inline int getLaneCount() const { return m_laneCount; }
+    inline uint8_t getRegister(int lane, int index) const { return m_registers[index * m_stride + lane]; }
+    inline uint16_t getPC(int lane) const { return m_pc[lane]; }
+    inline uint16_t getOpcode(int lane) const { return m_opcode[lane]; }
+    inline uint16_t getIndexReg(int lane) const { return m_indexReg[lane]; }
+    inline uint8_t getDelayTimer(int lane) const { return m_delayTimer[lane]; }
+    inline uint8_t getSoundTimer(int lane) const { return m_soundTimer[lane]; }
+    inline uint8_t getSP(int lane) const { return m_sp[lane]; }
+    inline uint16_t getStackElement(int lane, int index) const { return m_stack[index * m_stride + lane]; }
+    inline uint64_t getFrameBufferRow(int lane, int y) const { return m_frameBuffers[y * m_stride + lane]; }
+    inline const uint8_t* getMemory(int lane) const { return &m_memory[(size_t)lane * 0x1000]; }
+    inline uint64_t getCycleCount(int lane) const { return m_cycleCount[lane]; }
+    inline bool isWaitingForKey(int lane) const { return m_keyWaitRegister[lane] != -1; }
+    inline bool hasPanicked(int lane) const { return m_hasPanicked[lane]; }
+    inline const std::string& getPanicMessage(int lane) const { return m_panicMessages[lane]; }
+};
+
+#endif // LOCKSTEP_ENGINE_H
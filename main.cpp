@@ -1,6 +1,7 @@
 #include <string>
 #include <random>
 #include <filesystem>
+#include <cstdlib>
 
 #include "config.h"
 #include "Chip-8.h"
@@ -13,20 +14,70 @@
 #endif
 
 #include "submodules/chip8asm/src/Logger.h"
+#include "async_log.h"
 
 int main(int argc, char** argv)
 {
     std::cout << LICENSE_STR << std::endl;
 
     Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Verbose);
+    AsyncLog::start();
 
     std::string romFilename{};
-    FileChooser fileChooser{{"./roms", "../submodules/chip8asm/tests", "."}, {"ch8", "asm"}};
-    if (argc > 1)
+    std::string recordPath{};
+    std::string replayPath{};
+    bool hasSeed{};
+    uint64_t seed{};
+    bool isTracing{};
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if ((arg == "--seed" || arg == "--record" || arg == "--replay") && i + 1 < argc)
+        {
+            const std::string value = argv[++i];
+            if (arg == "--seed")
+            {
+                char* end;
+                seed = std::strtoull(value.c_str(), &end, 0);
+                if (value.empty() || *end)
+                {
+                    AsyncLog::error("Invalid seed: ", value);
+                    return 1;
+                }
+                hasSeed = true;
+            }
+            else if (arg == "--record")
+            {
+                recordPath = value;
+            }
+            else
+            {
+                replayPath = value;
+            }
+        }
+        else if (arg == "--trace")
+        {
+            isTracing = true;
+        }
+        else if (romFilename.empty() && arg.rfind("--", 0) != 0)
+        {
+            romFilename = arg;
+        }
+        else
+        {
+            AsyncLog::error("Usage: ", argv[0], " [file] [--seed <number>] [--record <movie file>] [--replay <movie file>] [--trace]");
+            return 1;
+        }
+    }
+    if (!recordPath.empty() && !replayPath.empty())
     {
-        romFilename = argv[1];
+        AsyncLog::error("A movie can't be recorded and replayed at the same time");
+        return 1;
     }
-    else
+
+    FileChooser fileChooser{{"./roms", "../submodules/chip8asm/tests", "."}, {"ch8", "asm"}};
+    // A movie contains the ROM, so it doesn't need one
+    if (romFilename.empty() && replayPath.empty())
     {
         romFilename = fileChooser.show();
         // If the user canceled the file selection or the file list is empty, quit.
@@ -34,22 +85,37 @@ int main(int argc, char** argv)
             return 0;
     }
 
-    Logger::log << "Filename: " << romFilename << Logger::End;
+    AsyncLog::info("Filename: ", romFilename);
 
     Chip8 chip8{romFilename};
+    if (chip8.hasExited())
+    {
+        chip8.deinit();
+        return 2;
+    }
     chip8.whenWindowResized(64 * 20, 32 * 20);
 
-    Logger::log << std::hex;
+    if (hasSeed)
+        chip8.setRandomSeed(seed);
+    if (!replayPath.empty() && !chip8.startReplay(replayPath))
+    {
+        AsyncLog::error("Unable to replay movie: ", replayPath);
+        chip8.deinit();
+        return 1;
+    }
+    if (!recordPath.empty())
+        chip8.startRecording(recordPath);
+    if (isTracing)
+        chip8.setTracing(true);
 
     double emulationSpeed = 1.0;
-    int frameDelay = 1000.0 / 500 / emulationSpeed;
     chip8.setSpeedPerc(100);
 
     bool isRunning = true;
-    bool wasPaused{};
-    bool isSteppingMode{};
-    bool shouldStep{}; // no effect when not in stepping mode
-    double renderUpdateCountdown{}; // Decremented and when 0, the renderer is updated
+
+    const uint64_t ticksPerFrame = SDL_GetPerformanceFrequency() / FRAMES_PER_SECOND;
+    // When the next frame should start, in performance counter ticks
+    uint64_t nextFrameTime = SDL_GetPerformanceCounter();
 
     while (isRunning && !chip8.hasExited())
     {
@@ -62,6 +128,10 @@ int main(int argc, char** argv)
                     isRunning = false;
                     break;
 
+                case SDL_RENDER_TARGETS_RESET:
+                    chip8.whenRenderTargetsReset();
+                    break;
+
                 case SDL_KEYDOWN:
                     switch(event.key.keysym.sym)
                     {
@@ -70,7 +140,7 @@ int main(int argc, char** argv)
                             chip8.setInfoMessage(chip8.isPaused() ?
                                     Chip8::InfoMessageValue::Pause :
                                     Chip8::InfoMessageValue::Unpause);
-                            isSteppingMode = false;
+                            chip8.setSteppingMode(false);
                             break;
 
                         case SHORTCUT_KEYCODE_QUIT:
@@ -90,19 +160,19 @@ int main(int argc, char** argv)
                             break;
 
                         case SHORTCUT_KEYCODE_STEP_INST:
-                            shouldStep = true;
+                            chip8.step();
                             break;
 
                         case SHORTCUT_KEYCODE_STEPPING_MODE:
-                            isSteppingMode = !isSteppingMode;
+                            chip8.setSteppingMode(!chip8.isSteppingMode());
                             chip8.unpause();
-                            chip8.setInfoMessage(isSteppingMode ?
+                            chip8.setInfoMessage(chip8.isSteppingMode() ?
                                     Chip8::InfoMessageValue::EnableSteppingMode :
                                     Chip8::InfoMessageValue::DisableSteppingMode);
                             break;
 
                         case SHORTCUT_KEYCODE_DUMP_STATE:
-                            Logger::log << '\n' << chip8.dumpStateToStr() << Logger::End;
+                            AsyncLog::info('\n', chip8.dumpStateToStr());
                             chip8.setInfoMessage(Chip8::InfoMessageValue::DumpState);
                             break;
 
@@ -110,7 +180,6 @@ int main(int argc, char** argv)
                             emulationSpeed += 0.05;
                             if (emulationSpeed > 10)
                                 emulationSpeed = 10;
-                            frameDelay = 1000.0 / 500 / emulationSpeed;
                             chip8.setSpeedPerc(emulationSpeed * 100);
                             chip8.setInfoMessage(Chip8::InfoMessageValue::IncrementSpeed);
                             break;
@@ -119,7 +188,6 @@ int main(int argc, char** argv)
                             emulationSpeed -= 0.05;
                             if (emulationSpeed < 0.05)
                                 emulationSpeed = 0.05;
-                            frameDelay = 1000.0 / 500 / emulationSpeed;
                             chip8.setSpeedPerc(emulationSpeed * 100);
                             chip8.setInfoMessage(Chip8::InfoMessageValue::DecrementSpeed);
                             break;
@@ -133,6 +201,18 @@ int main(int argc, char** argv)
                             chip8.setInfoMessage(Chip8::InfoMessageValue::Screenshot, chip8.saveScreenshot());
                             break;
 
+                        case SHORTCUT_KEYCODE_SAVE_STATE:
+                            chip8.setInfoMessage(chip8.saveState() ?
+                                    Chip8::InfoMessageValue::SaveState :
+                                    Chip8::InfoMessageValue::SaveStateFailed);
+                            break;
+
+                        case SHORTCUT_KEYCODE_LOAD_STATE:
+                            chip8.setInfoMessage(chip8.loadState() ?
+                                    Chip8::InfoMessageValue::LoadState :
+                                    Chip8::InfoMessageValue::LoadStateFailed);
+                            break;
+
                         case SHORTCUT_KEYCODE_TOGGLE_HELP:
                             chip8.toggleKeyboardHelp();
                             break;
@@ -147,17 +227,68 @@ int main(int argc, char** argv)
                             chip8.setInfoMessage(Chip8::InfoMessageValue::ToggleCompatIncIAfterRegFillLoad);
                             break;
 
+                        case SHORTCUT_KEYCODE_REWIND:
+                            chip8.setRewinding(true);
+                            break;
+
+                        case SHORTCUT_KEYCODE_EXPORT_PROFILE:
+                        {
+                            const std::string filename = chip8.exportProfile();
+                            chip8.setInfoMessage(filename.empty() ?
+                                    Chip8::InfoMessageValue::ExportProfileFailed :
+                                    Chip8::InfoMessageValue::ExportProfile, filename);
+                            break;
+                        }
+
+                        case SHORTCUT_KEYCODE_EXPORT_MEMORY_MAP:
+                        {
+                            const std::string filename = chip8.exportMemoryMap();
+                            chip8.setInfoMessage(filename.empty() ?
+                                    Chip8::InfoMessageValue::ExportMemoryMapFailed :
+                                    Chip8::InfoMessageValue::ExportMemoryMap, filename);
+                            break;
+                        }
+
+                        case SHORTCUT_KEYCODE_TOGGLE_TRACING:
+                            chip8.setTracing(!chip8.isTracing());
+                            chip8.setInfoMessage(chip8.isTracing() ?
+                                    Chip8::InfoMessageValue::EnableTracing :
+                                    Chip8::InfoMessageValue::DisableTracing);
+                            break;
+
+                        case SHORTCUT_KEYCODE_SAVE_TRACE:
+                        {
+                            const std::string filename = chip8.saveTrace();
+                            chip8.setInfoMessage(filename.empty() ?
+                                    Chip8::InfoMessageValue::SaveTraceFailed :
+                                    Chip8::InfoMessageValue::SaveTrace, filename);
+                            break;
+                        }
+
+                        case SHORTCUT_KEYCODE_SAVE_ROM_PROFILE:
+                            chip8.setInfoMessage(chip8.saveRomProfile() ?
+                                    Chip8::InfoMessageValue::SaveRomProfile :
+                                    Chip8::InfoMessageValue::SaveRomProfileFailed);
+                            break;
+
                         case SHORTCUT_KEYCODE_GOTO_FILE_DLG:
                             const std::string path = fileChooser.show();
                             if (!path.empty())
                             {
                                 chip8.reset(false);
-                                chip8.loadFile(path);
+                                // Keep running the previous program
+                                if (!chip8.loadFile(path))
+                                    chip8.reset();
                             }
                             break;
                     }
                     break;
 
+                case SDL_KEYUP:
+                    if (event.key.keysym.sym == SHORTCUT_KEYCODE_REWIND)
+                        chip8.setRewinding(false);
+                    break;
+
                 case SDL_WINDOWEVENT:
                     if (event.window.windowID == chip8.getWindowID())
                     {
@@ -168,6 +299,11 @@ int main(int argc, char** argv)
                             continue;
                             break;
 
+                        case SDL_WINDOWEVENT_EXPOSED:
+                            chip8.requestRedraw();
+                            continue;
+                            break;
+
                         case SDL_WINDOWEVENT_CLOSE:
                             isRunning = false;
                             continue;
@@ -178,58 +314,28 @@ int main(int argc, char** argv)
             }
         }
 
-        if (chip8.isPaused() || (isSteppingMode && !shouldStep))
-        {
-            wasPaused = true;
+        // The emulation runs on its own thread, this loop only shows its output
+        chip8.update();
 
+        // Most frames are identical, don't present them again
+        if (chip8.needsRedraw())
+        {
             chip8.renderFrameBuffer();
             chip8.renderDebugInfoIfInDebugMode();
             chip8.copyTexturesToRenderer();
             chip8.updateInfoMessage();
             chip8.updateOverlay();
             chip8.updateRenderer();
-
-            SDL_Delay(frameDelay);
-
-            // If paused or the stepping key was not pressed, don't execute instruction
-            if (chip8.isPaused() || !shouldStep)
-                continue;
-        }
-
-        if (wasPaused)
-        {
-            // To make the pixels light again.
-            chip8.renderFrameBuffer();
-
-            wasPaused = false;
-
-            // We don't need a redraw for a while
-            renderUpdateCountdown = 16.67;
         }
 
-        chip8.clearLastRegisterOperationFlags();
-        chip8.clearIsReadingKeyStateFlag();
-
-        chip8.emulateCycle();
-
-        // Mark that we executed an instruction since the last step
-        shouldStep = false;
-
-        if (chip8.getRenderFlag() || renderUpdateCountdown <= 0)
-        {
-            chip8.renderFrameBuffer();
-            renderUpdateCountdown = 16.67;
-        }
-
-        chip8.renderDebugInfoIfInDebugMode();
-        chip8.copyTexturesToRenderer();
-        chip8.updateInfoMessage();
-        chip8.updateOverlay();
-        chip8.updateRenderer();
-
-        SDL_Delay(frameDelay);
-
-        renderUpdateCountdown -= frameDelay;
+        // Wait for the start of the next frame.
+        // The deadline is advanced by exactly one frame, so the rounding of `SDL_Delay()` doesn't add up.
+        nextFrameTime += ticksPerFrame;
+        const uint64_t now = SDL_GetPerformanceCounter();
+        if (now < nextFrameTime)
+            SDL_Delay((nextFrameTime - now) * 1000 / SDL_GetPerformanceFrequency());
+        else if (now - nextFrameTime > ticksPerFrame * MAX_FRAME_LAG)
+            nextFrameTime = now;
     }
 
     chip8.deinit();
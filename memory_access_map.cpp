@@ -0,0 +1,39 @@
+#include "memory_access_map.h"
+#include "async_log.h"
+
+#include <fstream>
+#include <iomanip>
+
+void MemoryAccessMap::reset()
+{
+    *this = MemoryAccessMap{};
+}
+
+bool MemoryAccessMap::saveToFile(const std::string& path) const
+{
+    std::ofstream file{path, std::ios::trunc};
+
+    auto _getFlags{[this](int address){
+        return std::string{isRead(address) ? 'r' : '-'} + (isWritten(address) ? 'w' : '-') + (isExecuted(address) ? 'x' : '-');
+    }};
+
+    file << std::hex << std::setfill('0');
+    int address{};
+    while (address <= 0xfff)
+    {
+        const std::string flags = _getFlags(address);
+        const int start = address;
+        while (address <= 0xfff && _getFlags(address) == flags)
+            ++address;
+
+        if (flags != "---")
+            file << std::setw(4) << start << ' ' << std::setw(4) << address - 1 << ' ' << flags << '\n';
+    }
+
+    if (!file)
+    {
+        AsyncLog::error("Unable to write memory map: ", path);
+        return false;
+    }
+    return true;
+}
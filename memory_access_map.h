@@ -0,0 +1,83 @@
+#ifndef MEMORY_ACCESS_MAP_H
+#define MEMORY_ACCESS_MAP_H
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+
+/*
+ * One bit for every byte of the memory for each kind of access: read by an instruction
+ * (`Dxyn`, `Fx65`), written by an instruction (`Fx33`, `Fx55`) or executed as an instruction.
+ * The bytes that were only executed are code, the ones that were only read are data.
+ *
+ * The accesses since the last `clearRecent()` are recorded separately, too,
+ * so it can be shown which bytes are used right now.
+ *
+ * Attached to a machine with `Chip8Core::setMemoryAccessMap()`.
+ */
+class MemoryAccessMap final
+{
+public:
+    static constexpr int WORD_COUNT = (0xfff+1) / 64;
+
+private:
+    uint64_t m_read[WORD_COUNT]{};
+    uint64_t m_written[WORD_COUNT]{};
+    uint64_t m_executed[WORD_COUNT]{};
+    // Any kind of access since the last `clearRecent()`
+    uint64_t m_recent[WORD_COUNT]{};
+
+    static inline void setBits(uint64_t* bits, int address, int count)
+    {
+        for (int i{}; i < count; ++i)
+        {
+            const int wrapped = (address + i) & 0xfff;
+            bits[wrapped / 64] |= uint64_t(1) << (wrapped % 64);
+        }
+    }
+
+    static inline bool getBit(const uint64_t* bits, int address)
+    {
+        address &= 0xfff;
+        return (bits[address / 64] >> (address % 64)) & 1;
+    }
+
+public:
+    // The addresses wrap around at the end of the memory
+    inline void markRead(int address, int count)
+    {
+        setBits(m_read, address, count);
+        setBits(m_recent, address, count);
+    }
+    inline void markWritten(int address, int count)
+    {
+        setBits(m_written, address, count);
+        setBits(m_recent, address, count);
+    }
+    inline void markExecuted(int address, int count)
+    {
+        setBits(m_executed, address, count);
+        setBits(m_recent, address, count);
+    }
+
+    inline bool isRead(int address) const { return getBit(m_read, address); }
+    inline bool isWritten(int address) const { return getBit(m_written, address); }
+    inline bool isExecuted(int address) const { return getBit(m_executed, address); }
+    inline bool isRecent(int address) const { return getBit(m_recent, address); }
+
+    /*
+     * Forgets every access.
+     */
+    void reset();
+    inline void clearRecent() { std::memset(m_recent, 0, sizeof(m_recent)); }
+
+    /*
+     * Writes the accessed ranges of the memory to a text file, one range per line:
+     * the first and the last address and the kinds of access (`r`, `w` and `x`, `-` if not),
+     * for example `0200 02a3 --x`. The bytes that were never accessed are left out.
+     * Returns false on error.
+     */
+    bool saveToFile(const std::string& path) const;
+};
+
+#endif // MEMORY_ACCESS_MAP_H
@@ -0,0 +1,247 @@
+/*
+ * Movie files.
+ *
+ * Every value is stored little-endian:
+ *
+ *      Size  Content
+ *      4     Magic: "C8MV"
+ *      2     Version of the format, `MOVIE_VERSION`
+ *      4     Size of the start state
+ *      ?     The start state, written by `Chip8Core::saveState()`
+ *      8     End cycle
+ *      4     Event count
+ *      ?     The events, each is:
+ *            1-10  The cycles since the previous event (or the start state), LEB128 encoded
+ *            2     Key states
+ */
+
+#include "movie.h"
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+
+#include "chip8core.h"
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 1
+
+static void putValue(std::vector<uint8_t>& output, uint64_t value, int size)
+{
+    for (int i{}; i < size; ++i)
+        output.push_back(value >> (i * 8));
+}
+
+static bool getValue(const std::vector<uint8_t>& input, size_t& pos, uint64_t& value, int size)
+{
+    if (input.size() - pos < (size_t)size)
+        return false;
+
+    value = 0;
+    for (int i{}; i < size; ++i)
+        value |= uint64_t(input[pos++]) << (i * 8);
+    return true;
+}
+
+bool Movie::save(const std::string& path) const
+{
+    std::vector<uint8_t> output;
+    output.insert(output.end(), MOVIE_MAGIC, MOVIE_MAGIC + 4);
+    putValue(output, MOVIE_VERSION, 2);
+    putValue(output, startState.size(), 4);
+    output.insert(output.end(), startState.begin(), startState.end());
+    putValue(output, endCycle, 8);
+    putValue(output, events.size(), 4);
+
+    uint64_t previousCycle = 0;
+    for (const MovieEvent& event : events)
+    {
+        uint64_t delta = event.cycle - previousCycle;
+        previousCycle = event.cycle;
+        // 7 bits at a time, the high bit is set if there are more
+        do
+        {
+            output.push_back((delta & 0x7f) | (delta > 0x7f ? 0x80 : 0));
+            delta >>= 7;
+        } while (delta);
+        putValue(output, event.keyStates, 2);
+    }
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file.write((const char*)output.data(), output.size()))
+    {
+        AsyncLog::error("Unable to write movie: ", path);
+        return false;
+    }
+    return true;
+}
+
+bool Movie::load(const std::string& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+    {
+        AsyncLog::error("Unable to open movie: ", path);
+        return false;
+    }
+    const std::vector<uint8_t> input{std::istreambuf_iterator<char>{file}, {}};
+
+    auto fail{[&path](){
+        AsyncLog::error("Invalid movie file: ", path);
+        return false;
+    }};
+
+    if (input.size() < 4 || std::memcmp(input.data(), MOVIE_MAGIC, 4) != 0)
+        return fail();
+    size_t pos = 4;
+
+    uint64_t version;
+    if (!getValue(input, pos, version, 2))
+        return fail();
+    if (version != MOVIE_VERSION)
+    {
+        AsyncLog::error("Unsupported movie version: ", std::dec, version);
+        return false;
+    }
+
+    uint64_t stateSize;
+    if (!getValue(input, pos, stateSize, 4) || input.size() - pos < stateSize)
+        return fail();
+    startState.assign(input.begin() + pos, input.begin() + pos + stateSize);
+    pos += stateSize;
+
+    uint64_t eventCount;
+    if (!getValue(input, pos, endCycle, 8) || !getValue(input, pos, eventCount, 4))
+        return fail();
+
+    events.clear();
+    uint64_t cycle{};
+    for (uint64_t i{}; i < eventCount; ++i)
+    {
+        uint64_t delta{};
+        for (int shift{}; ; shift += 7)
+        {
+            if (pos >= input.size() || shift > 63)
+                return fail();
+            const uint8_t byte = input[pos++];
+            delta |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        cycle += delta;
+
+        uint64_t keyStates;
+        if (!getValue(input, pos, keyStates, 2))
+            return fail();
+        events.push_back({cycle, (uint16_t)keyStates});
+    }
+
+    return true;
+}
+
+MovieRecorder::MovieRecorder(const Chip8Core& core)
+{
+    m_movie.startState.resize(Chip8Core::SAVE_STATE_SIZE);
+    core.saveState(m_movie.startState.data());
+    m_lastCycle = core.getCycleCount();
+}
+
+void MovieRecorder::recordKeyStates(const Chip8Core& core, uint16_t keyStates)
+{
+    seek(core);
+
+    // Setting the same states changes nothing
+    if (keyStates == core.getKeyStates())
+        return;
+
+    m_movie.events.push_back({core.getCycleCount(), keyStates});
+}
+
+void MovieRecorder::seek(const Chip8Core& core)
+{
+    const uint64_t cycle = core.getCycleCount();
+    if (cycle < m_lastCycle)
+    {
+        // The input after this point didn't happen
+        auto firstDropped = std::lower_bound(m_movie.events.begin(), m_movie.events.end(), cycle,
+                [](const MovieEvent& event, uint64_t cycle){ return event.cycle < cycle; });
+        m_movie.events.erase(firstDropped, m_movie.events.end());
+    }
+    m_lastCycle = cycle;
+}
+
+const Movie& MovieRecorder::finish(const Chip8Core& core)
+{
+    seek(core);
+    // The instruction that panicked didn't count as a cycle, the replay has to execute it, too
+    m_movie.endCycle = core.getCycleCount() + core.hasPanicked();
+    return m_movie;
+}
+
+MoviePlayer::MoviePlayer(Movie movie)
+    : m_movie{std::move(movie)}
+{
+}
+
+bool MoviePlayer::start(Chip8Core& core)
+{
+    if (!core.loadState(m_movie.startState.data(), m_movie.startState.size()))
+        return false;
+
+    seek(core);
+    return true;
+}
+
+void MoviePlayer::applyEvents(Chip8Core& core)
+{
+    // Set every key state recorded until this cycle, in order
+    while (m_nextEvent < m_movie.events.size() && m_movie.events[m_nextEvent].cycle <= core.getCycleCount())
+        core.setKeyStates(m_movie.events[m_nextEvent++].keyStates);
+}
+
+int MoviePlayer::run(Chip8Core& core, int cycles)
+{
+    int executed{};
+    while (executed < cycles && !core.hasPanicked())
+    {
+        const uint64_t now = core.getCycleCount();
+
+        applyEvents(core);
+        if (now >= m_movie.endCycle)
+            break;
+
+        // Run until the next event
+        uint64_t until = m_movie.endCycle;
+        if (m_nextEvent < m_movie.events.size())
+            until = std::min(until, m_movie.events[m_nextEvent].cycle);
+
+        const int ran = core.run(std::min<uint64_t>(cycles - executed, until - now));
+        if (!ran)
+            break;
+        executed += ran;
+    }
+    return executed;
+}
+
+void MoviePlayer::step(Chip8Core& core)
+{
+    if (isFinished(core))
+        return;
+
+    applyEvents(core);
+    core.emulateCycle();
+}
+
+void MoviePlayer::seek(const Chip8Core& core)
+{
+    // The events of the current cycle happened after the state was saved
+    m_nextEvent = std::lower_bound(m_movie.events.begin(), m_movie.events.end(), core.getCycleCount(),
+            [](const MovieEvent& event, uint64_t cycle){ return event.cycle < cycle; })
+        - m_movie.events.begin();
+}
+
+bool MoviePlayer::isFinished(const Chip8Core& core) const
+{
+    return core.getCycleCount() >= m_movie.endCycle || core.hasPanicked();
+}
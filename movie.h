@@ -0,0 +1,122 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class Chip8Core;
+
+/*
+ * A change of the key states at a cycle.
+ */
+struct MovieEvent
+{
+    // The value of `Chip8Core::getCycleCount()` when the keys changed
+    uint64_t cycle{};
+    // Bit N is set if key N is down
+    uint16_t keyStates{};
+};
+
+/*
+ * A recording of a run that can be replayed bit-exactly.
+ *
+ * It starts from a save state, so it includes the ROM, the state of the random
+ * number generator and the quirk options, and lists the changes of the keys
+ * with the cycles they happened at.
+ */
+struct Movie
+{
+    std::vector<uint8_t> startState;
+    // In the order of the cycles
+    std::vector<MovieEvent> events;
+    // The cycle count when the recording was stopped
+    uint64_t endCycle{};
+
+    /*
+     * Returns false on error.
+     */
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+/*
+ * Records the input of a machine into a `Movie`.
+ */
+class MovieRecorder final
+{
+private:
+    Movie m_movie;
+    // The cycle count at the last call, to notice when the machine was moved back in time
+    uint64_t m_lastCycle{};
+
+public:
+    /*
+     * Starts recording from the current state of `core`.
+     */
+    MovieRecorder(const Chip8Core& core);
+
+    /*
+     * Should be called right before `keyStates` is passed to `Chip8Core::setKeyStates()`.
+     */
+    void recordKeyStates(const Chip8Core& core, uint16_t keyStates);
+
+    /*
+     * Should be called when the machine may have been moved to another state (rewound or loaded).
+     * If it is earlier than the last recorded point, the input recorded after it is dropped.
+     */
+    void seek(const Chip8Core& core);
+
+    /*
+     * Ends the movie at the current cycle of `core`.
+     */
+    const Movie& finish(const Chip8Core& core);
+};
+
+/*
+ * Feeds the input of a `Movie` to a machine.
+ */
+class MoviePlayer final
+{
+private:
+    Movie m_movie;
+    // The first event that is not applied yet
+    size_t m_nextEvent{};
+
+    /*
+     * Sets the key states recorded until the current cycle of `core`.
+     */
+    void applyEvents(Chip8Core& core);
+
+public:
+    MoviePlayer(Movie movie);
+
+    /*
+     * Loads the start state of the movie to `core`.
+     * Returns false if the movie has an invalid state.
+     */
+    bool start(Chip8Core& core);
+
+    /*
+     * Works like `Chip8Core::run()`, but sets the recorded key states at their cycles.
+     * Stops at the end of the movie.
+     * Returns the number of elapsed cycles.
+     */
+    int run(Chip8Core& core, int cycles);
+    /*
+     * Works like `Chip8Core::emulateCycle()`, but sets the recorded key states first.
+     */
+    void step(Chip8Core& core);
+
+    /*
+     * Should be called when the machine may have been moved to another state (rewound or loaded).
+     * The events are continued from its cycle count.
+     */
+    void seek(const Chip8Core& core);
+
+    bool isFinished(const Chip8Core& core) const;
+    inline const Movie& getMovie() const { return m_movie; }
+};
+
+#endif // MOVIE_H
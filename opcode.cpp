@@ -0,0 +1,129 @@
+#include "opcode.h"
+
+static OpClass getOpClass(uint16_t opcode)
+{
+    switch (opcode & 0xf000)
+    {
+        case 0x0000:
+            switch (opcode & 0x0fff)
+            {
+                case 0x0000: return OpClass::NOP;
+                case 0x00e0: return OpClass::CLS;
+                case 0x00ee: return OpClass::RET;
+                default:     return OpClass::Invalid;
+            }
+
+        case 0x1000: return OpClass::JP;
+        case 0x2000: return OpClass::CALL;
+        case 0x3000: return OpClass::SE_Imm;
+        case 0x4000: return OpClass::SNE_Imm;
+        // Note: The lowest nibble is not checked, like in the original implementation
+        case 0x5000: return OpClass::SE_Reg;
+        case 0x6000: return OpClass::LD_Imm;
+        case 0x7000: return OpClass::ADD_Imm;
+
+        case 0x8000:
+            switch (opcode & 0x000f)
+            {
+                case 0x0: return OpClass::LD_Reg;
+                case 0x1: return OpClass::OR;
+                case 0x2: return OpClass::AND;
+                case 0x3: return OpClass::XOR;
+                case 0x4: return OpClass::ADD_Reg;
+                case 0x5: return OpClass::SUB;
+                case 0x6: return OpClass::SHR;
+                case 0x7: return OpClass::SUBN;
+                case 0xe: return OpClass::SHL;
+                default:  return OpClass::Invalid;
+            }
+
+        case 0x9000: return OpClass::SNE_Reg;
+        case 0xa000: return OpClass::LD_I;
+        case 0xb000: return OpClass::JP_V0;
+        case 0xc000: return OpClass::RND;
+        case 0xd000: return OpClass::DRW;
+
+        case 0xe000:
+            switch (opcode & 0x00ff)
+            {
+                case 0x9e: return OpClass::SKP;
+                case 0xa1: return OpClass::SKNP;
+                default:   return OpClass::Invalid;
+            }
+
+        case 0xf000:
+            switch (opcode & 0x00ff)
+            {
+                case 0x07: return OpClass::LD_Vx_DT;
+                case 0x0a: return OpClass::LD_Vx_K;
+                case 0x15: return OpClass::LD_DT_Vx;
+                case 0x18: return OpClass::LD_ST_Vx;
+                case 0x1e: return OpClass::ADD_I;
+                case 0x29: return OpClass::LD_F;
+                case 0x33: return OpClass::LD_B;
+                case 0x55: return OpClass::LD_Mem_Vx;
+                case 0x65: return OpClass::LD_Vx_Mem;
+                default:   return OpClass::Invalid;
+            }
+    }
+
+    return OpClass::Invalid;
+}
+
+DecodedOp decodeOpcode(uint16_t opcode)
+{
+    DecodedOp op;
+    op.opcode = opcode;
+    op.nnn = opcode & 0x0fff;
+    op.x = (opcode & 0x0f00) >> 8;
+    op.y = (opcode & 0x00f0) >> 4;
+    op.n = opcode & 0x000f;
+    op.nn = opcode & 0x00ff;
+    op.opClass = getOpClass(opcode);
+    return op;
+}
+
+const char* getOpClassName(OpClass opClass)
+{
+    switch (opClass)
+    {
+        case OpClass::Invalid:   return "Invalid";
+        case OpClass::NOP:       return "NOP";
+        case OpClass::CLS:       return "CLS";
+        case OpClass::RET:       return "RET";
+        case OpClass::JP:        return "JMP";
+        case OpClass::CALL:      return "CALL";
+        case OpClass::SE_Imm:    return "SE";
+        case OpClass::SNE_Imm:   return "SNE";
+        case OpClass::SE_Reg:    return "SE Vx, Vy";
+        case OpClass::LD_Imm:    return "LD Vx, byte";
+        case OpClass::ADD_Imm:   return "ADD Vx, byte";
+        case OpClass::LD_Reg:    return "LD Vx, Vy";
+        case OpClass::OR:        return "OR Vx, Vy";
+        case OpClass::AND:       return "AND Vx, Vy";
+        case OpClass::XOR:       return "XOR Vx, Vy";
+        case OpClass::ADD_Reg:   return "ADD Vx, Vy";
+        case OpClass::SUB:       return "SUB Vx, Vy";
+        case OpClass::SHR:       return "SHR Vx {, Vy}";
+        case OpClass::SUBN:      return "SUBN Vx, Vy";
+        case OpClass::SHL:       return "SHL Vx {, Vy}";
+        case OpClass::SNE_Reg:   return "SNE Vx, Vy";
+        case OpClass::LD_I:      return "LD I, addr";
+        case OpClass::JP_V0:     return "JP V0, addr";
+        case OpClass::RND:       return "RND Vx, byte";
+        case OpClass::DRW:       return "DRW Vx, Vy, nibble";
+        case OpClass::SKP:       return "SKP Vx";
+        case OpClass::SKNP:      return "SKNP Vx";
+        case OpClass::LD_Vx_DT:  return "LD Vx, DT";
+        case OpClass::LD_Vx_K:   return "LD Vx, K";
+        case OpClass::LD_DT_Vx:  return "LD DT, Vx";
+        case OpClass::LD_ST_Vx:  return "LD ST, Vx";
+        case OpClass::ADD_I:     return "ADD I, Vx";
+        case OpClass::LD_F:      return "LD F, Vx";
+        case OpClass::LD_B:      return "LD B, Vx";
+        case OpClass::LD_Mem_Vx: return "LD [I], Vx";
+        case OpClass::LD_Vx_Mem: return "LD Vx, [I]";
+        case OpClass::Count:     break;
+    }
+    return "???";
+}
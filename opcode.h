@@ -0,0 +1,84 @@
+#ifndef OPCODE_H
+#define OPCODE_H
+
+#include <stdint.h>
+
+class Chip8Core;
+
+/*
+ * The instructions of the CHIP-8.
+ * The names follow Cowgod's Chip-8 Technical Reference.
+ */
+enum class OpClass : uint8_t
+{
+    Invalid,
+    NOP,        // 0000
+    CLS,        // 00E0
+    RET,        // 00EE
+    JP,         // 1nnn
+    CALL,       // 2nnn
+    SE_Imm,     // 3xkk
+    SNE_Imm,    // 4xkk
+    SE_Reg,     // 5xy0
+    LD_Imm,     // 6xkk
+    ADD_Imm,    // 7xkk
+    LD_Reg,     // 8xy0
+    OR,         // 8xy1
+    AND,        // 8xy2
+    XOR,        // 8xy3
+    ADD_Reg,    // 8xy4
+    SUB,        // 8xy5
+    SHR,        // 8xy6
+    SUBN,       // 8xy7
+    SHL,        // 8xyE
+    SNE_Reg,    // 9xy0
+    LD_I,       // Annn
+    JP_V0,      // Bnnn
+    RND,        // Cxkk
+    DRW,        // Dxyn
+    SKP,        // Ex9E
+    SKNP,       // ExA1
+    LD_Vx_DT,   // Fx07
+    LD_Vx_K,    // Fx0A
+    LD_DT_Vx,   // Fx15
+    LD_ST_Vx,   // Fx18
+    ADD_I,      // Fx1E
+    LD_F,       // Fx29
+    LD_B,       // Fx33
+    LD_Mem_Vx,  // Fx55
+    LD_Vx_Mem,  // Fx65
+
+    Count,
+};
+
+struct DecodedOp;
+
+using OpHandler = void (*)(Chip8Core& core, const DecodedOp& op);
+
+/*
+ * An instruction with its operands already extracted.
+ */
+struct DecodedOp
+{
+    // nullptr if the entry is not decoded yet
+    OpHandler handler{};
+    uint16_t opcode{};
+    uint16_t nnn{};
+    uint8_t x{};
+    uint8_t y{};
+    uint8_t n{};
+    uint8_t nn{};
+    OpClass opClass{};
+};
+
+/*
+ * Fills everything except `handler`.
+ */
+DecodedOp decodeOpcode(uint16_t opcode);
+
+/*
+ * Returns the mnemonic of the instruction, like "ADD Vx, Vy".
+ */
+const char* getOpClassName(OpClass opClass);
+
+#endif // OPCODE_H
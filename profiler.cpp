@@ -0,0 +1,126 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+uint64_t measureClockOverheadNs()
+{
+    using Clock = std::chrono::steady_clock;
+
+    // The fastest of many tries, the others were interrupted
+    Clock::duration fastest = Clock::duration::max();
+    for (int i{}; i < 1000; ++i)
+    {
+        const auto startTime = Clock::now();
+        fastest = std::min(fastest, Clock::now() - startTime);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(fastest).count();
+}
+
+} // namespace
+
+Profiler::Profiler()
+{
+    static const uint64_t clockOverheadNs = measureClockOverheadNs();
+    m_clockOverheadNs = clockOverheadNs;
+}
+
+void Profiler::reset()
+{
+    *this = Profiler{};
+}
+
+double Profiler::getEstimatedHostMs(OpClass opClass) const
+{
+    const int index = (int)opClass;
+    if (!m_sampleCounts[index])
+        return 0;
+    return (double)m_sampledNs[index] / m_sampleCounts[index] * m_classCounts[index] / 1e6;
+}
+
+void Profiler::summarize(ProfileSummary& summary) const
+{
+    summary.instructionCount = m_instructionCount;
+    summary.hostMs = 0;
+
+    std::vector<ProfileSummary::ClassEntry> classes;
+    for (int i{}; i < (int)OpClass::Count; ++i)
+    {
+        if (!m_classCounts[i])
+            continue;
+        classes.push_back({(OpClass)i, m_classCounts[i], getEstimatedHostMs((OpClass)i)});
+        summary.hostMs += classes.back().hostMs;
+    }
+    summary.classCount = std::min<int>(classes.size(), ProfileSummary::ENTRY_COUNT);
+    std::partial_sort(classes.begin(), classes.begin() + summary.classCount, classes.end(),
+            [](const auto& a, const auto& b){ return a.count > b.count; });
+    std::copy(classes.begin(), classes.begin() + summary.classCount, summary.classes);
+
+    std::vector<ProfileSummary::LoopEntry> loops;
+    for (int address{}; address <= 0xfff; ++address)
+    {
+        if (m_loopIterations[address])
+            loops.push_back({(uint16_t)address, m_loopEnds[address], m_loopIterations[address]});
+    }
+    summary.loopCount = std::min<int>(loops.size(), ProfileSummary::ENTRY_COUNT);
+    std::partial_sort(loops.begin(), loops.begin() + summary.loopCount, loops.end(),
+            [](const auto& a, const auto& b){ return a.iterations > b.iterations; });
+    std::copy(loops.begin(), loops.begin() + summary.loopCount, summary.loops);
+}
+
+std::string Profiler::toJson() const
+{
+    std::stringstream output;
+    output << "{\n  \"instructions\": " << m_instructionCount << ",\n"
+           << "  \"samplePeriod\": " << SAMPLE_PERIOD << ",\n";
+
+    output << "  \"classes\": [";
+    bool isFirst = true;
+    for (int i{}; i < (int)OpClass::Count; ++i)
+    {
+        if (!m_classCounts[i])
+            continue;
+        output << (isFirst ? "\n" : ",\n")
+               << "    {\"name\": \"" << getOpClassName((OpClass)i) << "\", \"count\": " << m_classCounts[i]
+               << ", \"samples\": " << m_sampleCounts[i] << ", \"estimatedHostMs\": " << getEstimatedHostMs((OpClass)i) << '}';
+        isFirst = false;
+    }
+    output << "\n  ],\n";
+
+    // Only the executed addresses
+    output << "  \"addresses\": [";
+    isFirst = true;
+    for (int address{}; address <= 0xfff; ++address)
+    {
+        if (!m_addressCounts[address])
+            continue;
+        output << (isFirst ? "\n" : ",\n")
+               << "    {\"address\": " << address << ", \"count\": " << m_addressCounts[address] << '}';
+        isFirst = false;
+    }
+    output << "\n  ],\n";
+
+    // The cycles spent in a loop are the executions of the addresses it spans
+    output << "  \"loops\": [";
+    isFirst = true;
+    for (int address{}; address <= 0xfff; ++address)
+    {
+        if (!m_loopIterations[address])
+            continue;
+        uint64_t cycles{};
+        for (int i{address}; i <= m_loopEnds[address]; ++i)
+            cycles += m_addressCounts[i];
+        output << (isFirst ? "\n" : ",\n")
+               << "    {\"start\": " << address << ", \"end\": " << m_loopEnds[address]
+               << ", \"iterations\": " << m_loopIterations[address] << ", \"cycles\": " << cycles << '}';
+        isFirst = false;
+    }
+    output << "\n  ]\n}\n";
+
+    return output.str();
+}
@@ -0,0 +1,129 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <string>
+
+#include "opcode.h"
+
+/*
+ * The most executed instruction classes and the hottest loops, small enough
+ * to be copied to the window with every frame.
+ */
+struct ProfileSummary
+{
+    static constexpr int ENTRY_COUNT = 8;
+
+    struct ClassEntry
+    {
+        OpClass opClass{};
+        uint64_t count{};
+        // The estimated host time spent executing the class
+        double hostMs{};
+    };
+    struct LoopEntry
+    {
+        // The target of the backward jump
+        uint16_t start{};
+        // The address of the furthest jump back to `start`
+        uint16_t end{};
+        uint64_t iterations{};
+    };
+
+    uint64_t instructionCount{};
+    // The estimated host time of every class
+    double hostMs{};
+    ClassEntry classes[ENTRY_COUNT]{};
+    int classCount{};
+    LoopEntry loops[ENTRY_COUNT]{};
+    int loopCount{};
+};
+
+/*
+ * Counts the executed instructions per class and per address.
+ *
+ * The host time is only measured for every `SAMPLE_PERIOD`th instruction, the time of
+ * a class is estimated from its samples. The loops are found by the backward jumps,
+ * a jump to an earlier (or the same) address is counted as an iteration of the loop starting there.
+ *
+ * Attached to a machine with `Chip8Core::setProfiler()`.
+ */
+class Profiler final
+{
+public:
+    static constexpr int SAMPLE_PERIOD = 64;
+
+private:
+    uint64_t m_instructionCount{};
+    uint64_t m_classCounts[(int)OpClass::Count]{};
+    uint64_t m_addressCounts[0xfff+1]{};
+
+    // The sum of the measured times and the number of samples
+    uint64_t m_sampledNs[(int)OpClass::Count]{};
+    uint64_t m_sampleCounts[(int)OpClass::Count]{};
+    int m_instructionsUntilSample = SAMPLE_PERIOD;
+    // How long reading the clock twice takes, subtracted from the samples
+    uint64_t m_clockOverheadNs{};
+
+    // Indexed by the target of the jump
+    uint64_t m_loopIterations[0xfff+1]{};
+    uint16_t m_loopEnds[0xfff+1]{};
+
+public:
+    Profiler();
+
+    inline void recordInstruction(uint16_t address, OpClass opClass)
+    {
+        ++m_instructionCount;
+        ++m_classCounts[(int)opClass];
+        ++m_addressCounts[address & 0xfff];
+    }
+
+    /*
+     * Returns true if the host time of the next instruction should be measured.
+     */
+    inline bool shouldSample()
+    {
+        if (--m_instructionsUntilSample)
+            return false;
+        m_instructionsUntilSample = SAMPLE_PERIOD;
+        return true;
+    }
+
+    inline void recordSample(OpClass opClass, uint64_t hostNs)
+    {
+        m_sampledNs[(int)opClass] += hostNs > m_clockOverheadNs ? hostNs - m_clockOverheadNs : 0;
+        ++m_sampleCounts[(int)opClass];
+    }
+
+    inline void recordJump(uint16_t from, uint16_t to)
+    {
+        if (to > from)
+            return;
+        ++m_loopIterations[to & 0xfff];
+        if (from > m_loopEnds[to & 0xfff])
+            m_loopEnds[to & 0xfff] = from;
+    }
+
+    /*
+     * Forgets everything recorded.
+     */
+    void reset();
+
+    inline uint64_t getInstructionCount() const { return m_instructionCount; }
+    inline uint64_t getClassCount(OpClass opClass) const { return m_classCounts[(int)opClass]; }
+    inline uint64_t getAddressCount(int address) const { return m_addressCounts[address & 0xfff]; }
+    /*
+     * The average of the samples times the count, 0 if the class has no samples yet.
+     */
+    double getEstimatedHostMs(OpClass opClass) const;
+
+    void summarize(ProfileSummary& summary) const;
+
+    /*
+     * Every counter as a JSON object.
+     */
+    std::string toJson() const;
+};
+
+#endif // PROFILER_H
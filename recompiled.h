@@ -0,0 +1,75 @@
+#ifndef RECOMPILED_H
+#define RECOMPILED_H
+
+/*
+ * Runtime support for the C++ code generated by `chip8recomp`.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8core.h"
+
+/*
+ * Gives the generated code access to the state of the machine.
+ * The operations do the same as the matching instruction handlers of the interpreter.
+ */
+struct Chip8RecompilerAccess
+{
+    static inline uint8_t* getRegisters(Chip8Core& core) { return core.m_registers.getData(); }
+    static inline uint16_t& getIndexReg(Chip8Core& core) { return core.m_indexReg; }
+    static inline uint16_t getPC(const Chip8Core& core) { return core.m_pc; }
+    static inline bool getCompatShiftYRegInsteadOfX(const Chip8Core& core) { return core.m_compat_shiftYRegInsteadOfX; }
+
+    static inline bool canExecute(const Chip8Core& core)
+    {
+        return !core.m_hasPanicked && !core.isWaitingForKey();
+    }
+
+    static inline void call(Chip8Core& core, uint16_t returnAddress)
+    {
+        core.m_stack[core.m_sp] = returnAddress;
+        ++core.m_sp;
+    }
+
+    static inline uint16_t ret(Chip8Core& core)
+    {
+        // The stack pointer is 4 bits, it wraps around
+        const int top = (core.m_sp - 1) & 0xf;
+        const uint16_t address = core.m_stack[top];
+        core.m_stack[top] = 0;
+        --core.m_sp;
+        return address;
+    }
+
+    static inline void clearScreen(Chip8Core& core)
+    {
+        core.m_frameBuffer.clear();
+    }
+
+    /*
+     * Called after a block of `count` instructions, none of them touching the timers.
+     */
+    static inline void finishBlock(Chip8Core& core, uint16_t pc, int count, uint16_t lastOpcode)
+    {
+        core.m_pc = pc;
+        core.m_opcode = lastOpcode;
+        core.advanceTimers(count);
+    }
+};
+
+/*
+ * Defined by the generated code.
+ */
+
+// The ROM the code was generated from
+extern const uint8_t chip8RecompiledRom[];
+extern const size_t chip8RecompiledRomSize;
+
+/*
+ * Works like `Chip8Core::run()`.
+ * The machine needs to have `chip8RecompiledRom` loaded.
+ */
+int chip8RecompiledRun(Chip8Core& core, int cycles);
+
+#endif // RECOMPILED_H
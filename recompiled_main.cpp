@@ -0,0 +1,61 @@
+/*
+ * Headless runner for a recompiled ROM.
+ *
+ * Usage: <program> [cycle count] [--interpret]
+ *
+ * Runs the embedded ROM without input for the given number of cycles and prints
+ * the state of the machine. With `--interpret` the interpreter runs the same ROM,
+ * the two outputs have to be the same.
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <chrono>
+
+#include "recompiled.h"
+#include "to_hex.h"
+#include "submodules/chip8asm/src/Logger.h"
+
+int main(int argc, char** argv)
+{
+    Logger::setLoggerVerbosity(Logger::LoggerVerbosity::Quiet);
+
+    int cycles = 1000000;
+    bool useInterpreter{};
+    for (int i{1}; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--interpret") == 0)
+            useInterpreter = true;
+        else
+            cycles = std::stoi(argv[i]);
+    }
+
+    Chip8Core core;
+    core.setJitEnabled(false);
+    // The same random numbers in both modes
+    core.setRandomSeed(0);
+    if (!core.loadRom(chip8RecompiledRom, chip8RecompiledRomSize))
+        return 2;
+
+    const auto startTime = std::chrono::steady_clock::now();
+    int executed{};
+    while (executed < cycles && !core.hasPanicked())
+    {
+        const int ran = useInterpreter ? core.run(cycles - executed) : chip8RecompiledRun(core, cycles - executed);
+        if (ran == 0)
+            break;
+        executed += ran;
+    }
+    const auto elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "Executed cycles: " << std::dec << executed << '\n'
+              << "PC: " << to_hex(core.getPC(), 3) << '\n'
+              << "Framebuffer hash: " << to_hex(core.getFrameBuffer().getHash(), 8) << '\n';
+    if (core.hasPanicked())
+        std::cout << "Panic: " << core.getPanicMessage() << '\n';
+    std::cout << core.dumpStateToStr(false)
+              << "Time: " << elapsedMs << " ms" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "rewind_buffer.h"
+
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+// The size of the size fields around an entry
+#define ENTRY_OVERHEAD (2 * sizeof(uint32_t))
+// The longest run of unchanged or changed bytes in one block of a difference
+#define MAX_RUN 0xffff
+
+RewindBuffer::RewindBuffer(size_t capacity, size_t stateSize)
+    : m_ring(capacity), m_current(stateSize)
+{
+}
+
+void RewindBuffer::writeRing(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    const size_t firstPart = std::min(size, m_ring.size() - m_head);
+    std::memcpy(m_ring.data() + m_head, bytes, firstPart);
+    std::memcpy(m_ring.data(), bytes + firstPart, size - firstPart);
+    m_head = (m_head + size) % m_ring.size();
+    m_usedBytes += size;
+}
+
+void RewindBuffer::readRing(size_t pos, void* dest, size_t size) const
+{
+    uint8_t* bytes = (uint8_t*)dest;
+    const size_t firstPart = std::min(size, m_ring.size() - pos);
+    std::memcpy(bytes, m_ring.data() + pos, firstPart);
+    std::memcpy(bytes + firstPart, m_ring.data(), size - firstPart);
+}
+
+void RewindBuffer::dropOldest()
+{
+    assert(m_entryCount);
+
+    uint32_t size;
+    readRing(m_tail, &size, sizeof(size));
+    m_tail = (m_tail + size + ENTRY_OVERHEAD) % m_ring.size();
+    m_usedBytes -= size + ENTRY_OVERHEAD;
+    --m_entryCount;
+}
+
+void RewindBuffer::push(const uint8_t* state)
+{
+    const size_t stateSize = m_current.size();
+
+    if (!m_hasCurrent)
+    {
+        std::memcpy(m_current.data(), state, stateSize);
+        m_hasCurrent = true;
+        return;
+    }
+
+    // Encode the difference as blocks of: unchanged byte count, changed byte count, the changed bytes XOR-ed
+    m_delta.clear();
+    size_t i{};
+    while (i < stateSize)
+    {
+        const size_t unchangedStart = i;
+        while (i < stateSize && state[i] == m_current[i] && i - unchangedStart < MAX_RUN)
+            ++i;
+        const size_t changedStart = i;
+        while (i < stateSize && state[i] != m_current[i] && i - changedStart < MAX_RUN)
+            ++i;
+
+        // Nothing changed after the last block
+        if (i == changedStart && i == stateSize)
+            break;
+
+        const uint16_t unchangedCount = changedStart - unchangedStart;
+        const uint16_t changedCount = i - changedStart;
+        m_delta.push_back(unchangedCount);
+        m_delta.push_back(unchangedCount >> 8);
+        m_delta.push_back(changedCount);
+        m_delta.push_back(changedCount >> 8);
+        for (size_t j{changedStart}; j < i; ++j)
+            m_delta.push_back(state[j] ^ m_current[j]);
+    }
+    std::memcpy(m_current.data(), state, stateSize);
+
+    const uint32_t deltaSize = m_delta.size();
+    if (deltaSize + ENTRY_OVERHEAD > m_ring.size())
+    {
+        // Doesn't fit at all, the history before this state is lost
+        clear();
+        m_hasCurrent = true;
+        return;
+    }
+    while (m_ring.size() - m_usedBytes < deltaSize + ENTRY_OVERHEAD)
+        dropOldest();
+
+    writeRing(&deltaSize, sizeof(deltaSize));
+    writeRing(m_delta.data(), deltaSize);
+    writeRing(&deltaSize, sizeof(deltaSize));
+    ++m_entryCount;
+}
+
+const uint8_t* RewindBuffer::pop()
+{
+    if (!m_entryCount)
+        return nullptr;
+
+    // Remove the newest entry
+    uint32_t deltaSize;
+    readRing((m_head + m_ring.size() - sizeof(deltaSize)) % m_ring.size(), &deltaSize, sizeof(deltaSize));
+    m_head = (m_head + m_ring.size() - deltaSize - ENTRY_OVERHEAD) % m_ring.size();
+    m_usedBytes -= deltaSize + ENTRY_OVERHEAD;
+    --m_entryCount;
+
+    m_delta.resize(deltaSize);
+    readRing((m_head + sizeof(deltaSize)) % m_ring.size(), m_delta.data(), deltaSize);
+
+    // XOR-ing the difference again gives back the earlier state
+    size_t statePos{};
+    size_t deltaPos{};
+    while (deltaPos < deltaSize)
+    {
+        const uint16_t unchangedCount = m_delta[deltaPos] | (m_delta[deltaPos + 1] << 8);
+        const uint16_t changedCount = m_delta[deltaPos + 2] | (m_delta[deltaPos + 3] << 8);
+        deltaPos += 4;
+
+        statePos += unchangedCount;
+        for (int j{}; j < changedCount; ++j)
+            m_current[statePos++] ^= m_delta[deltaPos++];
+    }
+    assert(statePos <= m_current.size());
+
+    return m_current.data();
+}
+
+void RewindBuffer::clear()
+{
+    m_tail = 0;
+    m_head = 0;
+    m_usedBytes = 0;
+    m_entryCount = 0;
+    m_hasCurrent = false;
+}
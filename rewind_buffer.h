@@ -0,0 +1,69 @@
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Stores the history of the machine state in a fixed amount of memory.
+ *
+ * Only the latest state is kept as is, every older one is stored as the
+ * difference from the state after it: the two states XOR-ed together,
+ * with the runs of zero bytes (the unchanged bytes) run-length encoded.
+ * When the buffer is full, the oldest states are dropped.
+ */
+class RewindBuffer final
+{
+private:
+    // The encoded differences, each stored as: size, data, size.
+    // The size is repeated, so the ring can be walked from both ends.
+    std::vector<uint8_t> m_ring;
+    // Where the oldest entry starts
+    size_t m_tail{};
+    // Where the next entry will be written
+    size_t m_head{};
+    size_t m_usedBytes{};
+    int m_entryCount{};
+
+    // The latest state
+    std::vector<uint8_t> m_current;
+    bool m_hasCurrent{};
+
+    // Reused for encoding and decoding
+    std::vector<uint8_t> m_delta;
+
+    void writeRing(const void* data, size_t size);
+    void readRing(size_t pos, void* dest, size_t size) const;
+    void dropOldest();
+
+public:
+    /*
+     * `capacity` is the size of the ring in bytes, `stateSize` is the size of one state.
+     */
+    RewindBuffer(size_t capacity, size_t stateSize);
+
+    /*
+     * Records `state` as the latest state.
+     */
+    void push(const uint8_t* state);
+
+    /*
+     * Steps back to the state before the latest one and returns it.
+     * Returns nullptr if there is no earlier state.
+     */
+    const uint8_t* pop();
+
+    /*
+     * Forgets the whole history.
+     */
+    void clear();
+
+    /*
+     * How many times `pop()` can step back.
+     */
+    inline int getFrameCount() const { return m_entryCount; }
+    inline size_t getUsedBytes() const { return m_usedBytes; }
+};
+
+#endif // REWIND_BUFFER_H
@@ -0,0 +1,41 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * The xorshift64* generator used by `Cxkk`.
+ * Every interpreter of the machine has to use this, so the same seed gives the same run.
+ */
+namespace Rng
+{
+
+/*
+ * Returns the state of the generator for `seed`.
+ */
+inline uint64_t seedToState(uint64_t seed)
+{
+    // Scramble the seed with splitmix64, so similar seeds give different sequences
+    seed += 0x9e3779b97f4a7c15;
+    seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9;
+    seed = (seed ^ (seed >> 27)) * 0x94d049bb133111eb;
+    seed ^= seed >> 31;
+    // xorshift gets stuck at 0
+    return seed ? seed : 1;
+}
+
+/*
+ * Steps the generator and returns a byte.
+ */
+inline uint8_t nextByte(uint64_t& state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    // The high bits are the best quality
+    return (state * 0x2545f4914f6cdd1d) >> 56;
+}
+
+} // End of namespace
+
+#endif // RNG_H
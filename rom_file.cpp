@@ -0,0 +1,112 @@
+#include "rom_file.h"
+
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <algorithm>
+#endif
+
+#include "async_log.h"
+
+bool RomFile::open(const std::string& path, size_t maxSize)
+{
+    close();
+    m_error.clear();
+
+#ifdef __unix__
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        m_error = "Unable to open ROM: " + path;
+        AsyncLog::error(m_error);
+        return false;
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) || !S_ISREG(info.st_mode))
+    {
+        m_error = "Not a regular file: " + path;
+        AsyncLog::error(m_error);
+        ::close(fd);
+        return false;
+    }
+    const uint64_t size = info.st_size;
+#else
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (!file)
+    {
+        m_error = "Unable to open ROM: " + path;
+        AsyncLog::error(m_error);
+        return false;
+    }
+    const uint64_t size = std::max<std::streamoff>(file.tellg(), 0);
+#endif
+
+    AsyncLog::info("File size: ", size, " / 0x", std::hex, size, " bytes");
+    // Checked before anything is read, so a huge file is never copied
+    if (size == 0 || size > maxSize)
+    {
+        m_error = size ? "The ROM doesn't fit in the memory: " + std::to_string(size) + " bytes"
+                       : "The ROM is empty: " + path;
+        AsyncLog::error(m_error);
+#ifdef __unix__
+        ::close(fd);
+#endif
+        return false;
+    }
+
+#ifdef __unix__
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        m_error = "Unable to map ROM: " + path;
+        AsyncLog::error(m_error);
+        return false;
+    }
+    m_data = (const uint8_t*)data;
+    m_mappedSize = size;
+#else
+    m_buffer.resize(size);
+    file.seekg(0);
+    if (!file.read((char*)m_buffer.data(), size))
+    {
+        m_error = "Unable to read ROM: " + path;
+        AsyncLog::error(m_error);
+        m_buffer.clear();
+        return false;
+    }
+    m_data = m_buffer.data();
+#endif
+
+    m_path = path;
+    m_size = size;
+    return true;
+}
+
+void RomFile::close()
+{
+    if (!m_data)
+        return;
+
+#ifdef __unix__
+    munmap((void*)m_data, m_mappedSize);
+    m_mappedSize = 0;
+#else
+    m_buffer.clear();
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_path.clear();
+}
+
+RomFile::~RomFile()
+{
+    close();
+}
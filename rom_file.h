@@ -0,0 +1,54 @@
+#ifndef ROM_FILE_H
+#define ROM_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+ * A ROM file opened for reading.
+ *
+ * On Unix systems the file is mapped to the memory read-only, so it is not copied
+ * before it is loaded into the machine. Elsewhere it is read into a buffer.
+ */
+class RomFile final
+{
+private:
+    std::string m_path;
+    size_t m_size{};
+    const uint8_t* m_data{};
+    // Why `open()` failed, for the user
+    std::string m_error;
+#ifdef __unix__
+    // The size of the mapping, 0 if the file is not mapped
+    size_t m_mappedSize{};
+#else
+    std::vector<uint8_t> m_buffer;
+#endif
+
+public:
+    RomFile() = default;
+    RomFile(const RomFile&) = delete;
+    RomFile& operator=(const RomFile&) = delete;
+
+    /*
+     * Opens the file at `path`, it has to be at least 1 and at most `maxSize` bytes long.
+     * Returns false on error, `getError()` tells why.
+     */
+    bool open(const std::string& path, size_t maxSize);
+    void close();
+    inline bool isOpen() const { return m_data; }
+    inline const std::string& getPath() const { return m_path; }
+    inline const std::string& getError() const { return m_error; }
+
+    /*
+     * The content of the file, `getSize()` bytes. Valid until the file is closed.
+     */
+    inline const uint8_t* getData() const { return m_data; }
+    inline size_t getSize() const { return m_size; }
+
+    ~RomFile();
+};
+
+#endif // ROM_FILE_H
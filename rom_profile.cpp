@@ -0,0 +1,163 @@
+#include "rom_profile.h"
+#include "chip8core.h"
+#include "async_log.h"
+#include "hash.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+
+namespace
+{
+
+bool parseProfile(const std::string& line, uint64_t& hash, RomProfile& profile)
+{
+    std::istringstream input{line};
+    std::string hashStr, quirks, speed, display;
+    if (!(input >> hashStr >> quirks >> speed >> display))
+        return false;
+
+    if (hashStr.size() != 16 || hashStr.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        return false;
+    hash = std::stoull(hashStr, nullptr, 16);
+
+    if (quirks.size() != 2 || (quirks[0] != 's' && quirks[0] != '-') || (quirks[1] != 'i' && quirks[1] != '-'))
+        return false;
+    profile.isCompatShiftYRegInsteadOfX = quirks[0] == 's';
+    profile.isCompatIncIAfterRegFillLoad = quirks[1] == 'i';
+
+    if (speed == "-")
+    {
+        profile.instructionsPerFrame = 0;
+    }
+    else
+    {
+        if (speed.size() > 6 || speed.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        profile.instructionsPerFrame = std::stoi(speed);
+        if (profile.instructionsPerFrame <= 0)
+            return false;
+    }
+
+    if (display == "-")
+        profile.displayMode = RomProfile::DisplayMode::Any;
+    else if (display == "window")
+        profile.displayMode = RomProfile::DisplayMode::Window;
+    else if (display == "fullscreen")
+        profile.displayMode = RomProfile::DisplayMode::Fullscreen;
+    else
+        return false;
+
+    std::getline(input >> std::ws, profile.name);
+    return true;
+}
+
+const char* getDisplayModeName(RomProfile::DisplayMode mode)
+{
+    switch (mode)
+    {
+    case RomProfile::DisplayMode::Any:          return "-";
+    case RomProfile::DisplayMode::Window:       return "window";
+    case RomProfile::DisplayMode::Fullscreen:   return "fullscreen";
+    }
+    return "-";
+}
+
+} // namespace
+
+void RomProfile::applyTo(Chip8Core& core) const
+{
+    core.setCompatShiftYRegInsteadOfX(isCompatShiftYRegInsteadOfX);
+    core.setCompatIncIAfterRegFillLoad(isCompatIncIAfterRegFillLoad);
+    core.setInstructionsPerSecond(instructionsPerFrame
+            ? instructionsPerFrame * FRAMES_PER_SECOND : INSTRUCTIONS_PER_SECOND);
+}
+
+uint64_t hashRom(const uint8_t* data, size_t size)
+{
+    return hashBytes(data, size);
+}
+
+bool RomProfileDatabase::load(const std::string& path)
+{
+    m_path = path;
+    m_profiles.clear();
+
+    std::error_code error;
+    if (!std::filesystem::exists(path, error))
+    {
+        AsyncLog::info("No ROM profile database at ", path, ", starting an empty one");
+        return true;
+    }
+
+    std::ifstream file{path};
+    if (!file)
+    {
+        AsyncLog::error("Unable to open ROM profile database: ", path);
+        return false;
+    }
+
+    std::string line;
+    int lineNumber{};
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        const size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        uint64_t hash{};
+        RomProfile profile;
+        if (!parseProfile(line, hash, profile))
+        {
+            AsyncLog::error("Invalid ROM profile at ", path, ':', lineNumber);
+            continue;
+        }
+        m_profiles[hash] = profile;
+    }
+
+    AsyncLog::info("Loaded ", m_profiles.size(), " ROM profiles from ", path);
+    return true;
+}
+
+bool RomProfileDatabase::save() const
+{
+    std::ofstream file{m_path, std::ios::trunc};
+
+    file << "# <hash> <quirks> <instructions per frame> <display mode> <name>, see rom_profile.h\n";
+    for (const auto& [hash, profile] : m_profiles)
+    {
+        file << std::hex << std::setfill('0') << std::setw(16) << hash << std::dec << ' '
+             << (profile.isCompatShiftYRegInsteadOfX ? 's' : '-')
+             << (profile.isCompatIncIAfterRegFillLoad ? 'i' : '-') << ' ';
+        if (profile.instructionsPerFrame)
+            file << profile.instructionsPerFrame;
+        else
+            file << '-';
+        file << ' ' << getDisplayModeName(profile.displayMode);
+        if (!profile.name.empty())
+            file << ' ' << profile.name;
+        file << '\n';
+    }
+
+    if (!file)
+    {
+        AsyncLog::error("Unable to write ROM profile database: ", m_path);
+        return false;
+    }
+    return true;
+}
+
+const RomProfile* RomProfileDatabase::find(uint64_t hash) const
+{
+    const auto it = m_profiles.find(hash);
+    return it == m_profiles.end() ? nullptr : &it->second;
+}
+
+void RomProfileDatabase::set(uint64_t hash, const RomProfile& profile)
+{
+    m_profiles[hash] = profile;
+}
@@ -0,0 +1,88 @@
+#ifndef ROM_PROFILE_H
+#define ROM_PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <map>
+
+class Chip8Core;
+
+/*
+ * The settings a ROM needs to run correctly.
+ */
+struct RomProfile
+{
+    enum class DisplayMode
+    {
+        // Keep the window as it is
+        Any,
+        Window,
+        Fullscreen,
+    };
+
+    // See `Chip8Core::m_compat_shiftYRegInsteadOfX`
+    bool isCompatShiftYRegInsteadOfX = true;
+    // See `Chip8Core::m_compat_incIAfterRegFillLoad`
+    bool isCompatIncIAfterRegFillLoad = true;
+    // 0 to run `INSTRUCTIONS_PER_SECOND` instructions a second
+    int instructionsPerFrame{};
+    DisplayMode displayMode = DisplayMode::Any;
+    // Only to help people reading the database
+    std::string name;
+
+    /*
+     * Sets the quirks and the speed of `core`.
+     */
+    void applyTo(Chip8Core& core) const;
+};
+
+/*
+ * Hashes the content of a ROM (64-bit FNV-1a, see `hashBytes()`), the key of the profile database.
+ */
+uint64_t hashRom(const uint8_t* data, size_t size);
+
+/*
+ * The profiles of the known ROMs, stored in a text file with one ROM per line:
+ *
+ *      <hash> <quirks> <instructions per frame> <display mode> <name>
+ *
+ * - The hash is the result of `hashRom()` as 16 hexadecimal digits.
+ * - The quirks are two characters: `s` if the shift quirk is enabled and
+ *   `i` if the index increment quirk is enabled, `-` if not. For example `-i`.
+ * - The instructions per frame are a decimal number, `-` for the default speed.
+ * - The display mode is `window`, `fullscreen` or `-` to keep the window as it is.
+ * - The name is the rest of the line, it can be left out.
+ *
+ * The empty lines and the lines starting with `#` are ignored.
+ * For example: `8e6a4b2f0c1d3e5a -i 10 - Space Invaders`
+ */
+class RomProfileDatabase final
+{
+private:
+    std::string m_path;
+    // Ordered by the hash, so saving doesn't reorder the file
+    std::map<uint64_t, RomProfile> m_profiles;
+
+public:
+    /*
+     * Reads the database from `path`, where `save()` will write it.
+     * A missing file is an empty database. The invalid lines are skipped.
+     * Returns false if the file exists but can't be read.
+     */
+    bool load(const std::string& path);
+    /*
+     * Writes the profiles back to the file, the comments are not kept.
+     * Returns false on error.
+     */
+    bool save() const;
+
+    /*
+     * Returns nullptr if the ROM is unknown.
+     */
+    const RomProfile* find(uint64_t hash) const;
+    void set(uint64_t hash, const RomProfile& profile);
+    inline size_t getCount() const { return m_profiles.size(); }
+};
+
+#endif // ROM_PROFILE_H
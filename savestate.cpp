@@ -0,0 +1,219 @@
+/*
+ * Binary save states of `Chip8Core`.
+ *
+ * Every value is stored little-endian at a fixed offset:
+ *
+ *      Size  Content
+ *      4     Magic: "C8ST"
+ *      2     Version of the format, `SAVE_STATE_VERSION`
+ *      4096  Memory
+ *      16    Registers V0-VF
+ *      32    Stack
+ *      1     SP
+ *      2     PC
+ *      2     Current opcode
+ *      2     Index register
+ *      1     Delay timer
+ *      1     Sound timer
+ *      256   Framebuffer rows, 64 bits each
+ *      512   Bitmap of the memory written by the instructions
+ *      1     The register `Fx0A` waits for a key with, 0xff if not waiting
+ *      2     Key states, bit N is key N
+ *      2     ROM size
+ *      4     Instructions per second
+ *      8     Timer phase
+ *      8     Cycle count
+ *      8     Random number generator state
+ *      1     Flags: bit 0 is the shift quirk, bit 1 is the index increment quirk,
+ *            bit 2 is set if the machine has panicked
+ */
+
+#include <cstring>
+
+#include "chip8core.h"
+
+#define SAVE_STATE_MAGIC "C8ST"
+#define SAVE_STATE_VERSION 2
+// The size of the values after the written memory bitmap
+#define SAVE_STATE_TAIL_SIZE 34
+
+namespace
+{
+
+class StateWriter final
+{
+private:
+    uint8_t* m_dest;
+
+public:
+    StateWriter(uint8_t* dest)
+        : m_dest{dest}
+    {
+    }
+
+    void put(uint64_t value, int size)
+    {
+        for (int i{}; i < size; ++i)
+            *m_dest++ = value >> (i * 8);
+    }
+
+    void putBytes(const void* data, size_t size)
+    {
+        std::memcpy(m_dest, data, size);
+        m_dest += size;
+    }
+
+    inline const uint8_t* getPos() const { return m_dest; }
+};
+
+class StateReader final
+{
+private:
+    const uint8_t* m_data;
+
+public:
+    StateReader(const uint8_t* data)
+        : m_data{data}
+    {
+    }
+
+    uint64_t get(int size)
+    {
+        uint64_t value{};
+        for (int i{}; i < size; ++i)
+            value |= uint64_t(*m_data++) << (i * 8);
+        return value;
+    }
+
+    void getBytes(void* dest, size_t size)
+    {
+        std::memcpy(dest, m_data, size);
+        m_data += size;
+    }
+
+    inline const uint8_t* getPos() const { return m_data; }
+};
+
+} // End of namespace
+
+void Chip8Core::saveState(uint8_t* dest) const
+{
+    StateWriter writer{dest};
+
+    writer.putBytes(SAVE_STATE_MAGIC, 4);
+    writer.put(SAVE_STATE_VERSION, 2);
+
+    writer.putBytes(m_memory, sizeof(m_memory));
+    for (int i{}; i < 16; ++i)
+        writer.put(m_registers.peek(i), 1);
+    for (int i{}; i < 16; ++i)
+        writer.put(m_stack[i], 2);
+    writer.put(m_sp, 1);
+    writer.put(m_pc, 2);
+    writer.put(m_opcode, 2);
+    writer.put(m_indexReg, 2);
+    writer.put(m_delayTimer, 1);
+    writer.put(m_soundTimer, 1);
+
+    for (uint64_t row : m_frameBuffer.m_rows)
+        writer.put(row, 8);
+    for (uint64_t word : m_writtenMemory)
+        writer.put(word, 8);
+
+    writer.put(uint8_t(m_keyWaitRegister), 1);
+    writer.put(getKeyStates(), 2);
+    writer.put(m_romSize, 2);
+    writer.put(m_instructionsPerSecond, 4);
+    writer.put(m_timerPhase, 8);
+    writer.put(m_cycleCount, 8);
+    writer.put(m_randomState, 8);
+    writer.put(m_compat_shiftYRegInsteadOfX | (m_compat_incIAfterRegFillLoad << 1) | (m_hasPanicked << 2), 1);
+
+    assert(writer.getPos() == dest + SAVE_STATE_SIZE);
+}
+
+bool Chip8Core::loadState(const uint8_t* data, size_t size)
+{
+    if (size != SAVE_STATE_SIZE)
+    {
+        AsyncLog::error("Invalid save state size: ", std::dec, size, " bytes");
+        return false;
+    }
+    if (std::memcmp(data, SAVE_STATE_MAGIC, 4) != 0)
+    {
+        AsyncLog::error("Not a save state");
+        return false;
+    }
+
+    StateReader reader{data + 4};
+
+    const int version = reader.get(2);
+    if (version != SAVE_STATE_VERSION)
+    {
+        AsyncLog::error("Unsupported save state version: ", std::dec, version);
+        return false;
+    }
+
+    { // Check the values that could break the machine before anything is overwritten
+        StateReader tailReader{data + SAVE_STATE_SIZE - SAVE_STATE_TAIL_SIZE};
+        const uint8_t keyWaitRegister = tailReader.get(1);
+        tailReader.get(2);
+        const int romSize = tailReader.get(2);
+        const int32_t instructionsPerSecond = tailReader.get(4);
+        tailReader.get(8);
+        tailReader.get(8);
+        const uint64_t randomState = tailReader.get(8);
+        if ((keyWaitRegister >= 16 && keyWaitRegister != 0xff)
+                || romSize > 0x1000 - 0x200
+                || instructionsPerSecond <= 0
+                || randomState == 0)
+        {
+            AsyncLog::error("Corrupted save state");
+            return false;
+        }
+    }
+
+    reader.getBytes(m_memory, sizeof(m_memory));
+    for (int i{}; i < 16; ++i)
+        m_registers.set(i, reader.get(1), true);
+    m_registers.clearReadWrittenFlags();
+    for (int i{}; i < 16; ++i)
+        m_stack[i] = reader.get(2);
+    m_sp = reader.get(1);
+    m_pc = reader.get(2);
+    m_opcode = reader.get(2);
+    m_indexReg = reader.get(2);
+    m_delayTimer = reader.get(1);
+    m_soundTimer = reader.get(1);
+
+    for (uint64_t& row : m_frameBuffer.m_rows)
+        row = reader.get(8);
+    m_frameBuffer.markAllRowsDirty();
+    for (uint64_t& word : m_writtenMemory)
+        word = reader.get(8);
+
+    m_keyWaitRegister = int8_t(reader.get(1));
+    const uint16_t keyStates = reader.get(2);
+    for (int i{}; i < 16; ++i)
+        m_keyStates[i] = (keyStates >> i) & 1;
+    m_romSize = reader.get(2);
+    m_instructionsPerSecond = reader.get(4);
+    m_timerPhase = reader.get(8);
+    m_cycleCount = reader.get(8);
+    m_randomState = reader.get(8);
+    const uint8_t flags = reader.get(1);
+    m_compat_shiftYRegInsteadOfX = flags & 1;
+    m_compat_incIAfterRegFillLoad = flags & 2;
+
+    assert(reader.getPos() == data + SAVE_STATE_SIZE);
+
+    m_isReadingKey = false;
+    // The message is not saved
+    m_hasPanicked = flags & 4;
+    m_panicMessage = m_hasPanicked ? "The state was saved after a panic." : "";
+
+    // The decoded and translated instructions belong to the old memory
+    invalidateDecodeCache();
+
+    return true;
+}
@@ -1,5 +1,5 @@
 #include "sdl_file_chooser.h"
-#include "submodules/chip8asm/src/Logger.h"
+#include "async_log.h"
 #include <cmath>
 #include <stdint.h>
 #include <string>
@@ -25,7 +25,7 @@ static void getFileList(
         }
         catch (const std::exception& e)
         {
-            Logger::err << "Failed to list directory: " << dir << ": " << e.what() << Logger::End;
+            AsyncLog::error("Failed to list directory: ", dir, ": ", e.what());
             SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "File Chooser Error",
                     ("Failed to list directory: "+dir+": "+e.what()).c_str(), nullptr);
         }
@@ -122,21 +122,21 @@ FileChooser::FileChooser(const std::vector<std::string>& directories, const std:
     m_window = SDL_CreateWindow("", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 800, 1000, SDL_WINDOW_ALLOW_HIGHDPI);
     if (!m_window)
     {
-        Logger::err << "Unable to create window" << Logger::End;
+        AsyncLog::error("Unable to create window");
         std::exit(2);
     }
 
     m_renderer = SDL_CreateRenderer(m_window, -1, 0);
     if (!m_renderer)
     {
-        Logger::err << "Unable to create renderer" << Logger::End;
+        AsyncLog::error("Unable to create renderer");
         std::exit(2);
     }
 
     m_font = TTF_OpenFont("./Anonymous_Pro.ttf", 100);
     if (!m_font)
     {
-        Logger::err << "Unable to open font file." << Logger::End;
+        AsyncLog::error("Unable to open font file.");
         std::exit(2);
     }
 
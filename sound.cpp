@@ -1,6 +1,6 @@
 #include "sound.h"
 
-#include "./submodules/chip8asm/src/Logger.h"
+#include "async_log.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_audio.h>
 
@@ -37,16 +37,16 @@ Beeper::Beeper()
     SDL_AudioSpec have;
     if (SDL_OpenAudio(&want, &have))
     {
-        Logger::err << "Failed to open audio: " << SDL_GetError() << Logger::End;
+        AsyncLog::error("Failed to open audio: ", SDL_GetError());
         return;
     }
     if (want.format != have.format)
     {
-        Logger::err << "Failed to get desired AudioSpec: " << SDL_GetError() << Logger::End;
+        AsyncLog::error("Failed to get desired AudioSpec: ", SDL_GetError());
         return;
     }
 
-    Logger::log << "Opened and set up audio device" << Logger::End;
+    AsyncLog::info("Opened and set up audio device");
     m_couldInit = true;
 }
 
@@ -72,5 +72,5 @@ Beeper::~Beeper()
         return;
 
     SDL_CloseAudio();
-    Logger::log << "Closed audio device" << Logger::End;
+    AsyncLog::info("Closed audio device");
 }
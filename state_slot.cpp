@@ -0,0 +1,152 @@
+#include "state_slot.h"
+
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+#include "async_log.h"
+
+bool StateSlot::open(const std::string& path, size_t size)
+{
+    close();
+
+#ifdef __unix__
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd == -1)
+    {
+        AsyncLog::error("Unable to open state slot: ", path);
+        return false;
+    }
+    // A new file is filled with zeros, that is not a valid state
+    if (ftruncate(m_fd, size))
+    {
+        AsyncLog::error("Unable to resize state slot: ", path);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    if (!mapFile(path, size))
+        return false;
+#else
+    m_buffer.assign(size, 0);
+    std::ifstream file{path, std::ios::binary};
+    if (file)
+        file.read((char*)m_buffer.data(), size);
+    m_data = m_buffer.data();
+#endif
+
+    m_path = path;
+    m_size = size;
+    AsyncLog::info("Opened state slot: ", path);
+    return true;
+}
+
+bool StateSlot::openExisting(const std::string& path)
+{
+    close();
+
+#ifdef __unix__
+    m_fd = ::open(path.c_str(), O_RDWR);
+    if (m_fd == -1)
+    {
+        if (errno == ENOENT)
+            AsyncLog::info("No saved state: ", path);
+        else
+            AsyncLog::error("Unable to open state slot: ", path);
+        return false;
+    }
+    struct stat info{};
+    if (fstat(m_fd, &info) || info.st_size <= 0)
+    {
+        AsyncLog::error("Empty state slot: ", path);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    const size_t size = info.st_size;
+    if (!mapFile(path, size))
+        return false;
+#else
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+    {
+        AsyncLog::info("No saved state: ", path);
+        return false;
+    }
+    m_buffer.assign(std::istreambuf_iterator<char>{file}, {});
+    if (m_buffer.empty())
+    {
+        AsyncLog::error("Empty state slot: ", path);
+        return false;
+    }
+    m_data = m_buffer.data();
+    const size_t size = m_buffer.size();
+#endif
+
+    m_path = path;
+    m_size = size;
+    AsyncLog::info("Opened state slot: ", path);
+    return true;
+}
+
+#ifdef __unix__
+bool StateSlot::mapFile(const std::string& path, size_t size)
+{
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED)
+    {
+        AsyncLog::error("Unable to map state slot: ", path);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_data = (uint8_t*)data;
+    return true;
+}
+#endif
+
+void StateSlot::flush()
+{
+    if (!m_data)
+        return;
+
+#ifdef __unix__
+    // Don't wait for the disk, the mapping is written back by the system anyway
+    msync(m_data, m_size, MS_ASYNC);
+#else
+    std::ofstream file{m_path, std::ios::binary | std::ios::trunc};
+    if (!file.write((const char*)m_data, m_size))
+        AsyncLog::error("Unable to write state slot: ", m_path);
+#endif
+}
+
+void StateSlot::close()
+{
+    if (!m_data)
+        return;
+
+#ifdef __unix__
+    munmap(m_data, m_size);
+    ::close(m_fd);
+    m_fd = -1;
+#else
+    flush();
+    m_buffer.clear();
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_path.clear();
+}
+
+StateSlot::~StateSlot()
+{
+    close();
+}
@@ -0,0 +1,69 @@
+#ifndef STATE_SLOT_H
+#define STATE_SLOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+ * A file holding one save state.
+ *
+ * On Unix systems the file stays mapped to the memory, so saving is just a copy
+ * and the system writes it to the disk in the background.
+ * Elsewhere the file is read when opened and written by `flush()`.
+ */
+class StateSlot final
+{
+private:
+    std::string m_path;
+    size_t m_size{};
+    uint8_t* m_data{};
+#ifdef __unix__
+    int m_fd = -1;
+#else
+    std::vector<uint8_t> m_buffer;
+#endif
+
+#ifdef __unix__
+    /*
+     * Maps `size` bytes of `m_fd`, closes it on error.
+     */
+    bool mapFile(const std::string& path, size_t size);
+#endif
+
+public:
+    StateSlot() = default;
+    StateSlot(const StateSlot&) = delete;
+    StateSlot& operator=(const StateSlot&) = delete;
+
+    /*
+     * Opens or creates the slot file at `path` for saving, it is resized to `size` bytes.
+     * Returns false on error.
+     */
+    bool open(const std::string& path, size_t size);
+    /*
+     * Opens the slot file at `path` for loading, with the size it has.
+     * The file is not created or resized, so a state in an older format is kept.
+     * Returns false if there is no such file or on error.
+     */
+    bool openExisting(const std::string& path);
+    void close();
+    inline bool isOpen() const { return m_data; }
+    inline const std::string& getPath() const { return m_path; }
+
+    /*
+     * The content of the file, `getSize()` bytes.
+     */
+    inline uint8_t* getData() { return m_data; }
+    inline size_t getSize() const { return m_size; }
+
+    /*
+     * Makes sure that the changes of the data are written to the file.
+     */
+    void flush();
+
+    ~StateSlot();
+};
+
+#endif // STATE_SLOT_H
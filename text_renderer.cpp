@@ -0,0 +1,157 @@
+#include "text_renderer.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+#include "async_log.h"
+
+bool TextRenderer::init(SDL_Renderer* renderer, TTF_Font* font)
+{
+    constexpr int charCount = lastChar - firstChar + 1;
+    constexpr int atlasRows = (charCount + atlasColumns - 1) / atlasColumns;
+
+    // Render the characters first, so we know the size of the cells
+    SDL_Surface* charSurfaces[charCount]{};
+    int cellWidth{1};
+    int cellHeight{1};
+    for (int i{}; i < charCount; ++i)
+    {
+        char str[2]{(char)(firstChar + i)};
+
+        charSurfaces[i] = TTF_RenderText_Blended(font, str, {255, 255, 255, 255});
+        if (!charSurfaces[i])
+        {
+            AsyncLog::error("Failed to render font: ", TTF_GetError());
+            for (int j{}; j < i; ++j)
+                SDL_FreeSurface(charSurfaces[j]);
+            return false;
+        }
+        cellWidth = std::max(cellWidth, charSurfaces[i]->w);
+        cellHeight = std::max(cellHeight, charSurfaces[i]->h);
+    }
+
+    const int atlasWidth{cellWidth * atlasColumns};
+    const int atlasHeight{cellHeight * atlasRows};
+    SDL_Surface* atlasSurface{SDL_CreateRGBSurfaceWithFormat(
+            0, atlasWidth, atlasHeight, 32, SDL_PIXELFORMAT_ARGB8888)};
+    if (!atlasSurface)
+    {
+        AsyncLog::error("Failed to create font atlas surface: ", SDL_GetError());
+        for (SDL_Surface* surface : charSurfaces)
+            SDL_FreeSurface(surface);
+        return false;
+    }
+
+    for (int i{}; i < charCount; ++i)
+    {
+        SDL_Rect destRect{
+            i % atlasColumns * cellWidth, i / atlasColumns * cellHeight,
+            charSurfaces[i]->w, charSurfaces[i]->h};
+        // Copy the alpha channel as well instead of blending onto the transparent atlas
+        SDL_SetSurfaceBlendMode(charSurfaces[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(charSurfaces[i], nullptr, atlasSurface, &destRect);
+
+        m_glyphTexCoords[i] = {
+            (float)destRect.x / atlasWidth, (float)destRect.y / atlasHeight,
+            (float)destRect.w / atlasWidth, (float)destRect.h / atlasHeight};
+        SDL_FreeSurface(charSurfaces[i]);
+    }
+
+    m_atlas = SDL_CreateTextureFromSurface(renderer, atlasSurface);
+    SDL_FreeSurface(atlasSurface);
+    if (!m_atlas)
+    {
+        AsyncLog::error("Failed to convert font atlas to texture: ", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(m_atlas, SDL_BLENDMODE_BLEND);
+
+    return true;
+}
+
+void TextRenderer::deinit()
+{
+    SDL_DestroyTexture(m_atlas);
+    m_atlas = nullptr;
+    m_vertices.clear();
+    m_indices.clear();
+    m_batchWidth = 0;
+    m_batchHeight = 0;
+}
+
+void TextRenderer::addText(
+        int* cursorRow, int* cursorCol,
+        const std::string& text,
+        const SDL_Color& color/*={255, 255, 255, 255}*/)
+{
+    for (size_t i{}; i < text.length(); ++i)
+    {
+        const int character{text[i]};
+        switch (character)
+        {
+        case '\n':
+            ++*cursorRow;
+            *cursorCol = 0;
+            break;
+
+        case '\t':
+            *cursorCol += 4;
+            break;
+
+        case '\v':
+            *cursorRow += 4;
+            *cursorCol = 0;
+            break;
+
+        case '\r':
+            *cursorCol = 0;
+            break;
+
+        case ' ':
+            ++*cursorCol;
+            break;
+
+        default:
+            if (character >= firstChar && character <= lastChar) // If printable character
+            {
+                const float x{(float)(*cursorCol * charWidthPx + 5)};
+                const float y{(float)(*cursorRow * charHeightPx)};
+                const SDL_FRect& tex{m_glyphTexCoords[character - firstChar]};
+
+                const int firstVertex{(int)m_vertices.size()};
+                m_vertices.push_back({{x,               y},                color, {tex.x,         tex.y}});
+                m_vertices.push_back({{x + charWidthPx, y},                color, {tex.x + tex.w, tex.y}});
+                m_vertices.push_back({{x + charWidthPx, y + charHeightPx}, color, {tex.x + tex.w, tex.y + tex.h}});
+                m_vertices.push_back({{x,               y + charHeightPx}, color, {tex.x,         tex.y + tex.h}});
+
+                for (int index : {0, 1, 2, 0, 2, 3})
+                    m_indices.push_back(firstVertex + index);
+                m_batchWidth = std::max(m_batchWidth, (int)x + charWidthPx);
+                m_batchHeight = std::max(m_batchHeight, (int)y + charHeightPx);
+                ++*cursorCol;
+            }
+            else // If unknown nonprintable character
+            {
+                ++*cursorCol;
+            }
+            break;
+        }
+    }
+}
+
+void TextRenderer::flush(SDL_Renderer* renderer)
+{
+    if (m_indices.empty())
+        return;
+    m_batchWidth = 0;
+    m_batchHeight = 0;
+
+    if (SDL_RenderGeometry(renderer, m_atlas,
+                m_vertices.data(), m_vertices.size(), m_indices.data(), m_indices.size()))
+    {
+        AsyncLog::error("Failed to render text: ", SDL_GetError());
+    }
+    // Keep the capacity, the panels are redrawn with roughly the same amount of text
+    m_vertices.clear();
+    m_indices.clear();
+}
@@ -0,0 +1,67 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+#include <vector>
+
+/*
+ * Draws monospace text from a single glyph atlas texture.
+ *
+ * The characters are collected into a vertex batch with `addText()`,
+ * and the whole batch is drawn with one `SDL_RenderGeometry()` call by `flush()`.
+ */
+class TextRenderer final
+{
+public:
+    static constexpr int charWidthPx = 9;
+    static constexpr int charHeightPx = 16;
+
+private:
+    static constexpr char firstChar = '!';
+    static constexpr char lastChar = '~';
+    static constexpr int atlasColumns = 16;
+
+    // Every character from code 21 to code 126 prerendered
+    SDL_Texture* m_atlas{};
+    // The texture coordinates of the characters in the atlas
+    SDL_FRect m_glyphTexCoords[lastChar - firstChar + 1]{};
+
+    std::vector<SDL_Vertex> m_vertices;
+    std::vector<int> m_indices;
+    // The size of the area covered by the batch, starting from the origin
+    int m_batchWidth{};
+    int m_batchHeight{};
+
+public:
+    /*
+     * Renders the characters of `font` into the atlas.
+     * Returns false on error.
+     */
+    bool init(SDL_Renderer* renderer, TTF_Font* font);
+    /*
+     * Destroys the atlas, should be called before the renderer is destroyed.
+     */
+    void deinit();
+
+    /*
+     * Adds `text` to the batch at the cursor and moves the cursor.
+     */
+    void addText(
+            int* cursorRow, int* cursorCol,
+            const std::string& text,
+            const SDL_Color& color={255, 255, 255, 255});
+
+    /*
+     * Returns the size of the area the batch covers, starting from the origin.
+     */
+    inline void getBatchSize(int* width, int* height) const { *width = m_batchWidth; *height = m_batchHeight; }
+
+    /*
+     * Draws the batch to the current render target and empties it.
+     */
+    void flush(SDL_Renderer* renderer);
+};
+
+#endif // TEXT_RENDERER_H
@@ -0,0 +1,137 @@
+/*
+ * Trace files.
+ *
+ * Every value is stored little-endian:
+ *
+ *      Size  Content
+ *      4     Magic: "C8TR"
+ *      2     Version of the format, `TRACE_VERSION`
+ *      8     The number of traced instructions, including the ones not kept
+ *      4     Record count
+ *      ?     The records from the oldest, each is `TRACE_RECORD_SIZE` bytes:
+ *            8     Cycle
+ *            2     PC
+ *            2     Opcode
+ *            2     Index register
+ *            1     Changed register, see `TraceRecord::changedRegister`
+ *            1     The new value of the changed register
+ */
+
+#include "trace.h"
+
+#include <fstream>
+#include <iterator>
+#include <cstring>
+
+#include "async_log.h"
+
+#define TRACE_MAGIC "C8TR"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE (4 + 2 + 8 + 4)
+#define TRACE_RECORD_SIZE 16
+
+static void putValue(std::vector<uint8_t>& output, uint64_t value, int size)
+{
+    for (int i{}; i < size; ++i)
+        output.push_back(value >> (i * 8));
+}
+
+static uint64_t getValue(const uint8_t* input, int size)
+{
+    uint64_t value{};
+    for (int i{}; i < size; ++i)
+        value |= uint64_t(input[i]) << (i * 8);
+    return value;
+}
+
+TraceBuffer::TraceBuffer(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+    m_records.resize(size);
+    m_mask = size - 1;
+}
+
+bool TraceBuffer::save(const std::string& path) const
+{
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+
+    std::vector<uint8_t> output;
+    output.insert(output.end(), TRACE_MAGIC, TRACE_MAGIC + 4);
+    putValue(output, TRACE_VERSION, 2);
+    putValue(output, m_written, 8);
+    putValue(output, getCount(), 4);
+
+    // Written in chunks, a full buffer would need a copy of many megabytes
+    constexpr size_t recordsPerChunk = 4096;
+    for (size_t i{}; i < getCount(); ++i)
+    {
+        const TraceRecord& record = get(i);
+        putValue(output, record.cycle, 8);
+        putValue(output, record.pc, 2);
+        putValue(output, record.opcode, 2);
+        putValue(output, record.indexReg, 2);
+        putValue(output, record.changedRegister, 1);
+        putValue(output, record.value, 1);
+
+        if ((i + 1) % recordsPerChunk == 0)
+        {
+            file.write((const char*)output.data(), output.size());
+            output.clear();
+        }
+    }
+
+    if (!file.write((const char*)output.data(), output.size()))
+    {
+        AsyncLog::error("Unable to write trace: ", path);
+        return false;
+    }
+    return true;
+}
+
+bool loadTrace(const std::string& path, std::vector<TraceRecord>& records, uint64_t& writtenCount)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+    {
+        AsyncLog::error("Unable to open trace: ", path);
+        return false;
+    }
+    const std::vector<uint8_t> input{std::istreambuf_iterator<char>{file}, {}};
+
+    if (input.size() < TRACE_HEADER_SIZE || std::memcmp(input.data(), TRACE_MAGIC, 4) != 0)
+    {
+        AsyncLog::error("Invalid trace file: ", path);
+        return false;
+    }
+
+    const uint64_t version = getValue(input.data() + 4, 2);
+    if (version != TRACE_VERSION)
+    {
+        AsyncLog::error("Unsupported trace version: ", std::dec, version);
+        return false;
+    }
+
+    writtenCount = getValue(input.data() + 6, 8);
+    const uint64_t recordCount = getValue(input.data() + 14, 4);
+    if ((input.size() - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE < recordCount)
+    {
+        AsyncLog::error("Invalid trace file: ", path);
+        return false;
+    }
+
+    records.resize(recordCount);
+    const uint8_t* data = input.data() + TRACE_HEADER_SIZE;
+    for (TraceRecord& record : records)
+    {
+        record.cycle = getValue(data, 8);
+        record.pc = getValue(data + 8, 2);
+        record.opcode = getValue(data + 10, 2);
+        record.indexReg = getValue(data + 12, 2);
+        record.changedRegister = data[14];
+        record.value = data[15];
+        data += TRACE_RECORD_SIZE;
+    }
+    return true;
+}
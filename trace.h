@@ -0,0 +1,86 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+ * An executed instruction and its effect on the registers.
+ */
+struct TraceRecord
+{
+    // `changedRegister` when no register changed
+    static constexpr uint8_t NO_REGISTER = 0xff;
+    // Set in `changedRegister` if VF changed, too (like the flag of `8xy4`)
+    static constexpr uint8_t VF_CHANGED_TOO = 0x10;
+
+    // The value of `Chip8Core::getCycleCount()` when the instruction was executed
+    uint64_t cycle{};
+    uint16_t pc{};
+    uint16_t opcode{};
+    // The index register after the instruction
+    uint16_t indexReg{};
+    // The lowest register changed by the instruction (VF only if no other changed),
+    // `NO_REGISTER` if none, `VF_CHANGED_TOO` is added if VF changed besides it
+    uint8_t changedRegister = NO_REGISTER;
+    // The new value of the changed register
+    uint8_t value{};
+};
+
+/*
+ * Keeps the last `capacity` executed instructions of a machine.
+ *
+ * Attached to a machine with `Chip8Core::setTraceBuffer()`, which records every
+ * instruction executed by `emulateCycle()`. The records are only written to a file
+ * when asked, for example after a panic.
+ */
+class TraceBuffer final
+{
+private:
+    std::vector<TraceRecord> m_records;
+    // A power of two, so the position can be masked
+    size_t m_mask{};
+    // How many records were written in total, the next one goes to `m_written & m_mask`
+    uint64_t m_written{};
+
+public:
+    /*
+     * `capacity` is rounded up to a power of two.
+     */
+    TraceBuffer(size_t capacity);
+
+    inline void record(const TraceRecord& record)
+    {
+        m_records[m_written & m_mask] = record;
+        ++m_written;
+    }
+
+    inline void clear() { m_written = 0; }
+
+    inline size_t getCapacity() const { return m_records.size(); }
+    // The number of records kept, at most the capacity
+    inline size_t getCount() const { return m_written < m_records.size() ? m_written : m_records.size(); }
+    // The number of records written since the last `clear()`, including the overwritten ones
+    inline uint64_t getWrittenCount() const { return m_written; }
+    /*
+     * The kept records from the oldest, `index` is less than `getCount()`.
+     */
+    inline const TraceRecord& get(size_t index) const { return m_records[(m_written - getCount() + index) & m_mask]; }
+
+    /*
+     * Writes the kept records to a trace file, from the oldest.
+     * Returns false on error.
+     */
+    bool save(const std::string& path) const;
+};
+
+/*
+ * Reads a file written by `TraceBuffer::save()`.
+ * `writtenCount` is set to the number of instructions traced in total, including the ones not kept.
+ * Returns false on error.
+ */
+bool loadTrace(const std::string& path, std::vector<TraceRecord>& records, uint64_t& writtenCount);
+
+#endif // TRACE_H
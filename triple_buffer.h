@@ -0,0 +1,66 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Lock-free single producer, single consumer triple buffer.
+ *
+ * The producer fills the write buffer and publishes it, the consumer picks up
+ * the most recently published buffer. Neither side ever waits for the other,
+ * the values the consumer was too slow to pick up are dropped.
+ */
+template <typename T>
+class TripleBuffer final
+{
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    // Set in `m_shared` if the shared buffer was published but not yet picked up
+    static constexpr uint8_t NEW_FLAG = 0x4;
+
+    T m_buffers[3]{};
+
+    // The index of the buffer currently owned by neither side, and the new flag
+    std::atomic<uint8_t> m_shared{1};
+    // Only accessed by the producer
+    uint8_t m_writeIndex{0};
+    // Only accessed by the consumer
+    uint8_t m_readIndex{2};
+
+public:
+    /*
+     * Producer side: the buffer to fill before calling `publish()`.
+     */
+    inline T& getWriteBuffer() { return m_buffers[m_writeIndex]; }
+
+    /*
+     * Producer side: makes the write buffer the latest value.
+     */
+    inline void publish()
+    {
+        const uint8_t previous = m_shared.exchange(m_writeIndex | NEW_FLAG, std::memory_order_acq_rel);
+        m_writeIndex = previous & INDEX_MASK;
+    }
+
+    /*
+     * Consumer side: switches to the latest published value.
+     * Returns false if nothing was published since the last call.
+     */
+    inline bool update()
+    {
+        if (!(m_shared.load(std::memory_order_relaxed) & NEW_FLAG))
+            return false;
+
+        const uint8_t previous = m_shared.exchange(m_readIndex, std::memory_order_acq_rel);
+        m_readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    /*
+     * Consumer side: the value picked up by the last successful `update()`.
+     */
+    inline const T& getReadBuffer() const { return m_buffers[m_readIndex]; }
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,83 @@
+#include "ui_panel.h"
+
+#include <algorithm>
+
+#include "async_log.h"
+
+bool UiPanel::needsRender(uint64_t contentHash, uint32_t minIntervalMs/*=0*/) const
+{
+    if (!m_isValid)
+        return true;
+    if (hasContent(contentHash))
+        return false;
+    return SDL_GetTicks() - m_lastRenderTicks >= minIntervalMs;
+}
+
+bool UiPanel::beginRender(SDL_Renderer* renderer, int width, int height, const SDL_Color& clearColor/*={0, 0, 0, 0}*/)
+{
+    // A texture can't be empty
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    if (!m_texture || width != m_width || height != m_height)
+    {
+        SDL_DestroyTexture(m_texture);
+        m_texture = SDL_CreateTexture(
+                renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (!m_texture)
+        {
+            AsyncLog::error("Failed to create panel texture: ", SDL_GetError());
+            m_isValid = false;
+            return false;
+        }
+        // Blending into a transparent texture leaves the colors multiplied by the alpha,
+        // so they shouldn't be multiplied again when the texture is copied
+        static const SDL_BlendMode premultipliedBlendMode{SDL_ComposeCustomBlendMode(
+                SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD)};
+        SDL_SetTextureBlendMode(m_texture, premultipliedBlendMode);
+        m_width = width;
+        m_height = height;
+    }
+
+    if (SDL_SetRenderTarget(renderer, m_texture))
+    {
+        AsyncLog::error("Failed to set render target: ", SDL_GetError());
+        m_isValid = false;
+        return false;
+    }
+    SDL_SetRenderDrawColor(renderer, clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+    SDL_RenderClear(renderer);
+    return true;
+}
+
+void UiPanel::endRender(SDL_Renderer* renderer, uint64_t contentHash)
+{
+    if (SDL_SetRenderTarget(renderer, nullptr))
+    {
+        AsyncLog::error("Failed to reset render target: ", SDL_GetError());
+    }
+
+    m_contentHash = contentHash;
+    m_isValid = true;
+    m_lastRenderTicks = SDL_GetTicks();
+}
+
+void UiPanel::copyTo(SDL_Renderer* renderer, int x, int y, uint8_t alpha/*=255*/)
+{
+    if (!m_texture)
+        return;
+
+    SDL_Rect dstRect{x, y, m_width, m_height};
+    // The colors are premultiplied, so they have to be faded, too
+    SDL_SetTextureColorMod(m_texture, alpha, alpha, alpha);
+    SDL_SetTextureAlphaMod(m_texture, alpha);
+    SDL_RenderCopy(renderer, m_texture, nullptr, &dstRect);
+}
+
+void UiPanel::deinit()
+{
+    SDL_DestroyTexture(m_texture);
+    m_texture = nullptr;
+    m_isValid = false;
+}
@@ -0,0 +1,68 @@
+#ifndef UI_PANEL_H
+#define UI_PANEL_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hash.h"
+
+/*
+ * A part of the UI that is rendered into its own texture.
+ *
+ * The panel remembers the hash of the content it was rendered with,
+ * so it only has to be re-rendered when its content changes,
+ * otherwise the texture is copied to the screen as is.
+ */
+class UiPanel final
+{
+private:
+    SDL_Texture* m_texture{};
+    int m_width{};
+    int m_height{};
+
+    // The hash of the content in the texture
+    uint64_t m_contentHash{};
+    // False if the texture has no valid content
+    bool m_isValid{};
+    // When the panel was last rendered, in milliseconds
+    uint32_t m_lastRenderTicks{};
+
+public:
+    /*
+     * Returns true if the texture has the content hashed to `contentHash`.
+     */
+    inline bool hasContent(uint64_t contentHash) const { return m_isValid && m_contentHash == contentHash; }
+
+    /*
+     * Returns true if the content hashed to `contentHash` is not in the texture yet
+     * and at least `minIntervalMs` milliseconds passed since the last render.
+     */
+    bool needsRender(uint64_t contentHash, uint32_t minIntervalMs=0) const;
+
+    /*
+     * Makes the texture the render target and clears it to `clearColor`.
+     * The texture is recreated if its size differs.
+     * Returns false on error.
+     */
+    bool beginRender(SDL_Renderer* renderer, int width, int height, const SDL_Color& clearColor={0, 0, 0, 0});
+
+    /*
+     * Resets the render target and records that the texture has the content hashed to `contentHash`.
+     */
+    void endRender(SDL_Renderer* renderer, uint64_t contentHash);
+
+    /*
+     * Copies the texture to the current render target, faded by `alpha`.
+     */
+    void copyTo(SDL_Renderer* renderer, int x, int y, uint8_t alpha=255);
+
+    /*
+     * Forces a re-render, for example when the renderer lost the content of the render targets.
+     */
+    inline void invalidate() { m_isValid = false; }
+
+    void deinit();
+};
+
+#endif // UI_PANEL_H
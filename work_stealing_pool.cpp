@@ -0,0 +1,112 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(size_t threadCount/*=0*/)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i{}; i < threadCount; ++i)
+        m_queues.push_back(std::make_unique<Queue>());
+    // The queues have to exist before any worker tries to steal from them
+    for (size_t i{}; i < threadCount; ++i)
+        m_threads.emplace_back(&WorkStealingPool::workerMain, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_shouldStop = true;
+    }
+    m_wakeUp.notify_all();
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        index = m_nextQueue;
+        m_nextQueue = (m_nextQueue + 1) % m_queues.size();
+        // Counted before it is in the queue, so the count never goes below zero when it is taken
+        ++m_queuedCount;
+        ++m_unfinishedCount;
+    }
+
+    {
+        Queue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        queue.tasks.push_back(std::move(task));
+    }
+    m_wakeUp.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_idle.wait(lock, [this](){ return m_unfinishedCount == 0; });
+}
+
+bool WorkStealingPool::takeTask(size_t index, Task& task)
+{
+    // Own queue first, from the back: the newest task is the most likely to be in the cache
+    // Then the others, from the front: the oldest task is the least likely to be taken by its owner soon
+    for (size_t i{}; i < m_queues.size(); ++i)
+    {
+        Queue& queue = *m_queues[(index + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        if (queue.tasks.empty())
+            continue;
+
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::workerMain(size_t index)
+{
+    while (true)
+    {
+        Task task;
+        if (takeTask(index, task))
+        {
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                --m_queuedCount;
+            }
+
+            task();
+
+            bool isIdle;
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                isIdle = --m_unfinishedCount == 0;
+            }
+            if (isIdle)
+                m_idle.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        // A counted task may not be in its queue yet, the loop tries again then
+        m_wakeUp.wait(lock, [this](){ return m_shouldStop || m_queuedCount > 0; });
+        if (m_shouldStop && m_queuedCount == 0)
+            return;
+    }
+}
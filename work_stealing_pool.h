@@ -0,0 +1,82 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+ * A thread pool where every worker has its own queue of tasks.
+ *
+ * A worker takes the newest task of its own queue, and when that is empty,
+ * steals the oldest task of another worker's queue. The queues are rarely
+ * shared, so the workers seldom wait for each other even when the lengths
+ * of the tasks are very different.
+ */
+class WorkStealingPool final
+{
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // One for every worker
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    // Guards the counters below
+    std::mutex m_mutex;
+    // Notified when a task is submitted or the pool stops
+    std::condition_variable m_wakeUp;
+    // Notified when every task has finished
+    std::condition_variable m_idle;
+    // The tasks in the queues, not yet taken by a worker
+    size_t m_queuedCount{};
+    // The tasks submitted but not yet finished
+    size_t m_unfinishedCount{};
+    // The queue the next task is submitted to
+    size_t m_nextQueue{};
+    bool m_shouldStop{};
+
+    /*
+     * Takes a task from the queue of worker `index` or steals one from another worker.
+     * Returns false if every queue is empty.
+     */
+    bool takeTask(size_t index, Task& task);
+    void workerMain(size_t index);
+
+public:
+    /*
+     * Starts `threadCount` workers, one for every hardware thread if it is 0.
+     */
+    explicit WorkStealingPool(size_t threadCount=0);
+    /*
+     * Waits for the submitted tasks to finish.
+     */
+    ~WorkStealingPool();
+
+    /*
+     * Queues a task, the queues of the workers get the tasks in turns.
+     * Can be called from a task, too.
+     */
+    void submit(Task task);
+
+    /*
+     * Blocks until every submitted task has finished.
+     */
+    void wait();
+
+    inline size_t getThreadCount() const { return m_threads.size(); }
+};
+
+#endif // WORK_STEALING_POOL_H